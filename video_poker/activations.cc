@@ -1,45 +1,52 @@
 #include "activations.h"
+#include "kernels.h"
 
-#include <cmath>
 #include <vector>
 #include <numeric>
 #include <algorithm>
 
 void sigmoid(const std::vector<float>& logitsBuffer, int numNeurons, std::vector<float>& out) {
-    for (int i = 0; i < numNeurons; i++) {
-        out[i] = 1.0f / (1.0f + std::exp(-logitsBuffer[i]));
-    }
+    sigmoid(logitsBuffer.data(), numNeurons, out.data());
 }
 
 void sigmoid_derivative(const std::vector<float>& in, std::vector<float>& out) {
-    for (size_t i = 0; i < in.size(); i++) {
-        out[i] = in[i] * (1.0f - in[i]);
-    }
+    sigmoid_derivative(in.data(), in.size(), out.data());
 }
 
 void relu(const std::vector<float>& logitsBuffer, int numNeurons, std::vector<float>& out) {
-    for (int i = 0; i < numNeurons; i++) {
-        out[i] = std::max(0.0f, logitsBuffer[i]);
-    }
+    relu(logitsBuffer.data(), numNeurons, out.data());
 }
 
 void relu_derivative(const std::vector<float>& in, std::vector<float>& out) {
-    for (size_t i = 0; i < in.size(); i++) {
-        out[i] = (in[i] > 0) ? 1.0f : 0.0f;
-    }
+    relu_derivative(in.data(), in.size(), out.data());
 }
 
 void softmax(const std::vector<float>& logitsBuffer, int numNeurons, std::vector<float>& out) {
-    float sum_of_exponentials = 0.0f;
-    float max_logit = *std::max_element(logitsBuffer.begin(), logitsBuffer.begin()+numNeurons);
+    softmax(logitsBuffer.data(), numNeurons, out.data());
+}
+
+void sigmoid(const float* logits, int numNeurons, float* out) {
+    neuralKernels().sigmoid(logits, numNeurons, out);
+}
+
+void sigmoid_derivative(const float* in, int numNeurons, float* out) {
     for (int i = 0; i < numNeurons; i++) {
-        float exp_val = std::exp(logitsBuffer[i] - max_logit);
-        out[i] = exp_val;
-        sum_of_exponentials += exp_val;
+        out[i] = in[i] * (1.0f - in[i]);
     }
-    if (sum_of_exponentials > 0) {
-        for (int i = 0; i < numNeurons; i++) {
-            out[i] /= sum_of_exponentials;
-        }
+}
+
+void relu(const float* logits, int numNeurons, float* out) {
+    for (int i = 0; i < numNeurons; i++) {
+        out[i] = std::max(0.0f, logits[i]);
     }
 }
+
+void relu_derivative(const float* in, int numNeurons, float* out) {
+    for (int i = 0; i < numNeurons; i++) {
+        out[i] = (in[i] > 0) ? 1.0f : 0.0f;
+    }
+}
+
+void softmax(const float* logits, int numNeurons, float* out) {
+    neuralKernels().softmax(logits, 1, numNeurons, out, nullptr);
+}
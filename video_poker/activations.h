@@ -8,4 +8,13 @@ void sigmoid_derivative(const std::vector<float>& outputs, std::vector<float>& o
 void relu(const std::vector<float>& logits, int numNeurons, std::vector<float>& out);
 void relu_derivative(const std::vector<float>& outputs, std::vector<float>& out);
 
-void softmax(const std::vector<float>& logits, int numNeurons, std::vector<float>& out);
\ No newline at end of file
+void softmax(const std::vector<float>& logits, int numNeurons, std::vector<float>& out);
+
+// Single row versions for row-major minibatch buffers. sigmoid and softmax run neuralKernels().
+void sigmoid(const float* logits, int numNeurons, float* out);
+void sigmoid_derivative(const float* outputs, int numNeurons, float* out);
+
+void relu(const float* logits, int numNeurons, float* out);
+void relu_derivative(const float* outputs, int numNeurons, float* out);
+
+void softmax(const float* logits, int numNeurons, float* out);
@@ -14,18 +14,20 @@
 #include <barrier>
 #include <thread>
 #include <chrono>
+#include <iomanip>
 
 #define LOG_STEP 2000
+#define EXACT_EVAL_BATCH 256
 
-void BaseAgent::randomEval(int iterations, std::mt19937& rng) const {
-    VideoPoker vp {rng};
+void BaseAgent::randomEval(int iterations, Rng& rng) const {
+    VideoPoker vp {rng, ShuffleMode::PARTIAL, mVariant};
     std::cout << "---Starting Eval, " <<  iterations << " iterations.---" << std::endl;
     int total_score = 0;
     for (int i = 0; i < iterations; i++) {
         Hand h = vp.deal();
         std::vector<float> input = translateHand(h);
         const std::vector<float>& output = predict(input);
-        std::vector<bool> exchanges = mDiscardStrategy->selectAction(output, rng, false);
+        ExchangeMask exchanges = mDiscardStrategy->selectAction(output, rng, false);
         h = vp.exchange(exchanges);
         if ((i+1) % 10000 == 0) {
             std::cout << "Games Played: " << (i+1) << ", Total Score: " << total_score << std::endl;
@@ -36,8 +38,167 @@ void BaseAgent::randomEval(int iterations, std::mt19937& rng) const {
     std::cout << "---Average Score: " << float(total_score) / iterations << "---" << std::endl << std::endl;
 }
 
+void BaseAgent::regretEval(int iterations, Rng& rng, const HoldValueSource& holdValues) const {
+    VideoPoker vp {rng, ShuffleMode::PARTIAL, mVariant};
+    std::cout << "---Starting Regret Eval, " <<  iterations << " iterations.---" << std::endl;
+    double policyTotal = 0.0;
+    double optimalTotal = 0.0;
+    int optimalDecisions = 0;
+    for (int i = 0; i < iterations; i++) {
+        Hand h = vp.deal();
+        vp.exchange(ExchangeMask {0});
+        const std::vector<float>& output = predict(translateHand(h));
+        ExchangeMask decision = mDiscardStrategy->selectAction(output, rng, false);
+        HoldValues values = holdValues.holdValues(h);
+        ExchangeMask best = EvSolver::bestExchange(values);
+        policyTotal += values[decision];
+        optimalTotal += values[best];
+        optimalDecisions += (values[decision] == values[best]);
+    }
+    std::cout << "Policy EV: " << policyTotal / iterations << ", Optimal EV: " << optimalTotal / iterations << std::endl;
+    std::cout << "---Average Regret: " << (optimalTotal - policyTotal) / iterations
+              << ", Optimal Decisions: " << float(optimalDecisions) / iterations << "---" << std::endl << std::endl;
+}
+
+void BaseAgent::exactEval(const HoldValueSource& holdValues, int numThreads) const {
+    std::cout << "---Starting Exact Eval, " << NUM_HANDS << " deals.---" << std::endl;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<CanonicalClass> classes = canonicalClasses();
+    numThreads = std::max(1, numThreads);
+
+    // Isomorphic deals share their hold values up to the order of the cards, so they are looked up
+    // once per class, over the cards of its representative.
+    std::vector<HoldValues> classValues(classes.size());
+    std::vector<std::thread> threads;
+    size_t classChunk = (classes.size() + numThreads - 1) / numThreads;
+    for (int t = 0; t < numThreads; t++) {
+        threads.emplace_back([&, t]() {
+            size_t end = std::min(classes.size(), (t + 1) * classChunk);
+            for (size_t c = t * classChunk; c < end; c++) {
+                classValues[c] = holdValues.holdValues(classes[c].hand);
+            }
+        });
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    threads.clear();
 
-void BaseAgent::targetedEval(std::mt19937& rng) const {
+    // The net is neither suit nor order invariant, so every deal gets its own decision.
+    struct Totals {
+        double policy = 0.0;
+        double optimal = 0.0;
+        uint64_t optimalDecisions = 0;
+    };
+    std::vector<Totals> totals(numThreads);
+    uint32_t chunk = (uint32_t(NUM_HANDS) + numThreads - 1) / numThreads;
+    for (int t = 0; t < numThreads; t++) {
+        threads.emplace_back([&, t]() {
+            Rng unused; // Greedy selection draws nothing.
+            std::vector<int> activeInputs;
+            std::vector<float> outputs;
+            std::vector<Hand> hands(EXACT_EVAL_BATCH);
+            uint32_t end = std::min(uint32_t(NUM_HANDS), (t + 1) * chunk);
+            for (uint32_t first = t * chunk; first < end; first += EXACT_EVAL_BATCH) {
+                int count = std::min<uint32_t>(EXACT_EVAL_BATCH, end - first);
+                activeInputs.resize(size_t(count) * ENCODED_ACTIVE_INPUTS);
+                for (int i = 0; i < count; i++) {
+                    hands[i] = unrankHand(first + i);
+                    encodeHandIndices(hands[i], &activeInputs[size_t(i) * ENCODED_ACTIVE_INPUTS]);
+                }
+                predictBatch(activeInputs, count, outputs);
+                size_t outputSize = outputs.size() / count;
+                for (int i = 0; i < count; i++) {
+                    std::vector<float> output(outputs.begin() + i * outputSize, outputs.begin() + (i + 1) * outputSize);
+                    ExchangeMask decision = mDiscardStrategy->selectAction(output, unused, false);
+                    CanonicalHand canonical = canonicalize(hands[i]);
+                    auto c = std::lower_bound(classes.begin(), classes.end(), canonical.rank,
+                                              [](const CanonicalClass& entry, uint32_t rank) { return entry.rank < rank; });
+                    const HoldValues& values = classValues[c - classes.begin()];
+                    double policy = values[canonical.toCanonical(decision)];
+                    double optimal = values[EvSolver::bestExchange(values)];
+                    totals[t].policy += policy;
+                    totals[t].optimal += optimal;
+                    totals[t].optimalDecisions += (policy == optimal);
+                }
+            }
+        });
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+
+    Totals sum;
+    for (const Totals& t : totals) {
+        sum.policy += t.policy;
+        sum.optimal += t.optimal;
+        sum.optimalDecisions += t.optimalDecisions;
+    }
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+    std::cout << std::fixed << std::setprecision(6);
+    std::cout << "Policy Return: " << sum.policy / NUM_HANDS << ", Optimal Return: " << sum.optimal / NUM_HANDS << std::endl;
+    std::cout << "---Exact Regret: " << (sum.optimal - sum.policy) / NUM_HANDS
+              << ", Optimal Decisions: " << double(sum.optimalDecisions) / NUM_HANDS
+              << ", " << seconds.count() << " s---" << std::endl << std::endl;
+    std::cout << std::defaultfloat;
+}
+
+std::vector<int> BaseAgent::corpusEval(const DealCorpus& corpus, int numThreads) const {
+    std::cout << "---Starting Corpus Eval, " << corpus.getNumDeals() << " deals.---" << std::endl;
+    auto start = std::chrono::steady_clock::now();
+    const GameTables& tables = getGameTables(mVariant);
+    std::vector<int> scores(corpus.getNumDeals());
+
+    numThreads = std::max(1, numThreads);
+    std::vector<std::thread> threads;
+    uint64_t chunk = (corpus.getNumDeals() + numThreads - 1) / numThreads;
+    for (int t = 0; t < numThreads; t++) {
+        threads.emplace_back([&, t]() {
+            Rng unused; // Greedy selection draws nothing.
+            std::vector<int> activeInputs;
+            std::vector<float> outputs;
+            uint64_t end = std::min(corpus.getNumDeals(), (t + 1) * chunk);
+            for (uint64_t first = t * chunk; first < end; first += EXACT_EVAL_BATCH) {
+                int count = std::min<uint64_t>(EXACT_EVAL_BATCH, end - first);
+                activeInputs.resize(size_t(count) * ENCODED_ACTIVE_INPUTS);
+                for (int i = 0; i < count; i++) {
+                    encodeHandIndices(corpus.getDeal(first + i), &activeInputs[size_t(i) * ENCODED_ACTIVE_INPUTS]);
+                }
+                predictBatch(activeInputs, count, outputs);
+                size_t outputSize = outputs.size() / count;
+                for (int i = 0; i < count; i++) {
+                    std::vector<float> output(outputs.begin() + i * outputSize, outputs.begin() + (i + 1) * outputSize);
+                    ExchangeMask decision = mDiscardStrategy->selectAction(output, unused, false);
+                    Hand final = corpus.getFinalHand(first + i, decision);
+                    scores[first + i] = tables.paytable[evaluateHand(final.mask(), tables)];
+                }
+            }
+        });
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+
+    ScoreSummary summary = summarizeScores(scores);
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+    std::cout << "---Average Score: " << summary.mean << " +/- " << summary.standardError
+              << ", " << seconds.count() << " s---" << std::endl << std::endl;
+    return scores;
+}
+
+void BaseAgent::predictBatch(const std::vector<int>& activeInputs, int count, std::vector<float>& outputs) const {
+    outputs.clear();
+    for (int i = 0; i < count; i++) {
+        std::vector<float> input(ENCODED_HAND_SIZE, 0.0f);
+        for (int k = 0; k < ENCODED_ACTIVE_INPUTS; k++) {
+            input[activeInputs[i * ENCODED_ACTIVE_INPUTS + k]] = 1.0f;
+        }
+        const std::vector<float>& output = predict(input);
+        outputs.insert(outputs.end(), output.begin(), output.end());
+    }
+}
+
+void BaseAgent::targetedEval(Rng& rng, const HoldValueSource* holdValues) const {
     std::vector<std::pair<std::string, Hand>> hands {
         {"Junk", {{{{CLUB, 2}, {SPADE, 7}, {HEART, 10}, {CLUB, 4}, {DIAMOND, 8}}}}},
         {"Pair", {{{{CLUB, 2}, {SPADE, 2}, {HEART, 10}, {CLUB, 4}, {DIAMOND, 8}}}}},
@@ -51,7 +212,13 @@ void BaseAgent::targetedEval(std::mt19937& rng) const {
         std::vector<float> output = predict(translateHand(h.second));
         std::cout << h.first << ": " << h.second << std::endl;
         std::cout << "Outputs: " << output << std::endl;
-        std::vector<bool> exchanges = mDiscardStrategy->selectAction(output, rng, false);
-        std::cout << "Decision: " << exchanges << std::endl;
+        ExchangeMask exchanges = mDiscardStrategy->selectAction(output, rng, false);
+        std::cout << "Decision: " << toExchangeVector(exchanges) << std::endl;
+        if (holdValues != nullptr) {
+            HoldValues values = holdValues->holdValues(h.second);
+            ExchangeMask best = EvSolver::bestExchange(values);
+            std::cout << "Decision EV: " << values[exchanges] << ", Optimal: " << toExchangeVector(best)
+                      << ", Optimal EV: " << values[best] << std::endl;
+        }
     }
 }
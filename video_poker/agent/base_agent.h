@@ -5,6 +5,10 @@
 #include "decision.h"
 #include "baseline.h"
 #include "hyperparams.h"
+#include "rng.h"
+#include "ev_solver.h"
+#include "canonical.h"
+#include "deal_corpus.h"
 
 #include <random>
 #include <vector>
@@ -19,9 +23,22 @@ public:
     virtual ~BaseAgent() = default;
     virtual void train(const std::atomic<bool>& stopSignal) = 0;
     virtual std::vector<float> predict(const std::vector<float>& input) const = 0;
-    void randomEval(int iterations, std::mt19937& rng) const;
-    void targetedEval(std::mt19937& rng) const;
+    void randomEval(int iterations, Rng& rng) const;
+    // Prints the optimal hold and its EV next to each decision when holdValues is set.
+    void targetedEval(Rng& rng, const HoldValueSource* holdValues = nullptr) const;
+    // Scores the greedy policy against the exact EV of every hold instead of sampled draws.
+    void regretEval(int iterations, Rng& rng, const HoldValueSource& holdValues) const;
+    // Exact return of the greedy policy over all deals, each with its cards in ascending order. The net
+    // decides every deal, and the hold values are taken once per suit-isomorphism class.
+    void exactEval(const HoldValueSource& holdValues, int numThreads) const;
+    // Plays the greedy policy on every deal of corpus and returns the per-deal scores, so evals of
+    // different agents or checkpoints can be compared deal by deal.
+    std::vector<int> corpusEval(const DealCorpus& corpus, int numThreads) const;
 protected:
     std::vector<float> translateHand(const Hand& hand) const;
+    // Runs count hands, given as ENCODED_ACTIVE_INPUTS active input indices each, and writes the
+    // row-major outputs. Defaults to one dense predict per hand.
+    virtual void predictBatch(const std::vector<int>& activeInputs, int count, std::vector<float>& outputs) const;
     std::unique_ptr<DecisionStrategy> mDiscardStrategy;
+    GameVariant mVariant = DEFAULT_VARIANT;
 };
@@ -2,8 +2,12 @@
 
 #include "neural.h"
 #include "poker.h"
+#include "poker_batch.h"
 #include "workspace.h"
+#include "kernels.h"
 #include "hyperparams.h"
+#include "net_compiler.h"
+#include "optimizer.h"
 
 #include <random>
 #include <vector>
@@ -17,18 +21,49 @@
 #include <chrono>
 
 #define LOG_STEP 2000
+// Stream budget for one worker batch, far more than numInBatch hands ever draw.
+constexpr uint64_t RNG_OUTPUTS_PER_BATCH = 1 << 24;
+constexpr int QUANTIZE_CHECK_BATCH = 256;
+
+namespace {
+
+// FNV-1a over the topologies of the nets a checkpoint holds and the sizes of its arenas.
+uint32_t checkpointLayoutHash(const CheckpointContents& contents,
+                              const std::vector<std::vector<LayerSpecification>>& topologies) {
+    uint32_t hash = 2166136261u;
+    auto mix = [&](uint64_t value) {
+        for (int byte = 0; byte < 8; byte++) {
+            hash = (hash ^ uint32_t((value >> (8 * byte)) & 0xFF)) * 16777619u;
+        }
+    };
+    for (const std::vector<LayerSpecification>& topology : topologies) {
+        mix(topology.size());
+        for (const LayerSpecification& layer : topology) {
+            mix(uint64_t(layer.numNeurons));
+            mix(uint64_t(layer.activationType));
+        }
+    }
+    for (const ParameterArena* arena : contents.arenas) {
+        mix(arena != nullptr ? arena->size() : 0);
+    }
+    mix(contents.rngs.size());
+    return hash;
+}
+
+} // namespace
 
 PolicyGradientAgent::PolicyGradientAgent(const HyperParameters& config,
              std::string fileName, 
-             unsigned int seed, 
+             uint64_t seed, 
              std::function<std::unique_ptr<BaselineCalculator>()> baselineFactory)
         : mConfig(config),
-          mNet(std::make_unique<NeuralNet>(config.actorTopology)),
+          mNet(makeNetwork(config.actorTopology, Rng(seed).split(ACTOR_INIT_STREAM))),
           mBaselineFactory(baselineFactory),
           mLogFile(fileName),
-          mRng(seed),
-          mVideoPoker(mRng)
+          mRng(Rng(seed).split(AGENT_STREAM)),
+          mVideoPoker(mRng, ShuffleMode::PARTIAL, config.variant)
 {
+    mVariant = config.variant;
     assert(config.actorTopology[0].numNeurons == 85); // Hard dependency by hand translation layer.
     int outputSize = config.actorTopology.back().numNeurons;
     switch (outputSize) {
@@ -56,57 +91,67 @@ PolicyGradientAgent::PolicyGradientAgent(const HyperParameters& config,
         std::cerr << "Could not open Log file!" << std::endl;
     } else {
         mLogFile << config << std::endl;
+        mLogFile << "Seed:," << seed << std::endl;
         mLogFile << std::endl;
         // mLogFile << "Baseline Calculator, " << mBaselineCalculator->getName() << std::endl;
-        mLogFile << "Batches,Hands,TotalAvgScore,RecentAvgScore,RecentAvgEntropy,GlobalWeightNorm,GlobalGradientNorm,";
+        mLogFile << "Batches,Hands,TotalAvgScore,RecentAvgScore,RecentAvgEntropy,RecentEffectiveSampleFraction,GlobalWeightNorm,GlobalGradientNorm,";
         for (size_t i = 1; i < config.actorTopology.size(); i++) {
             mLogFile << "Layer" << i << "WeightNorm,";
         }
         for (size_t i = 1; i < config.actorTopology.size(); i++) {
             mLogFile << "Layer" << i << "GradientNorm,";
         }
+        for (size_t i = 1; i < config.actorTopology.size(); i++) {
+            if (config.actorTopology[i].activationType == Activation::RELU) {
+                mLogFile << "Layer" << i << "Sparsity,Layer" << i << "DeadFraction,";
+            }
+        }
         mLogFile << std::endl;
     }
 
-    // RNG engines for the worker threads (so they aren't dealt the same hands)
-    std::seed_seq seq {seed};
-    std::vector<uint32_t> seeds(mConfig.numWorkers);
-    seq.generate(seeds.begin(), seeds.end());
+    if (!config.dealBoosts.empty()) {
+        mDealer = std::make_unique<StratifiedDealer>(config.dealBoosts);
+    }
+
+    // RNG streams for the worker threads (so they aren't dealt the same hands)
     for (int i = 0; i < mConfig.numWorkers; i++) {
-        mRngs.push_back(std::mt19937(seeds[i]));
+        mRngs.push_back(Rng(seed).split(WORKER_STREAM_BASE + i));
     }
 }
 
 std::vector<float> BaseAgent::translateHand(const Hand& hand) const {
-    std::vector<float> ret(85, 0.0f);
-    for (int i=0; i < 5; i++) {
-        Card c = hand[i];
-        ret[(i*17)+c.suit] = 1.0f;
-        ret[(i*17)+4+(c.rank-2)] = 1.0f;
-    }
+    std::vector<float> ret(ENCODED_HAND_SIZE, 0.0f);
+    encodeHand(hand, ret.data());
     return ret;
 }
 
-float PolicyGradientAgent::calculateEntropy(const std::vector<float>& policy) {
+float PolicyGradientAgent::calculateEntropy(const std::vector<float>& policy, const std::vector<float>& logPolicy) {
     float entropy = 0.0f;
-    for (float p : policy) {
-        if (p > 0) {
-            entropy -= p * std::log(p);
+    for (size_t i = 0; i < policy.size(); i++) {
+        if (policy[i] > 0) {
+            entropy -= policy[i] * logPolicy[i];
         }
-    }    
+    }
     return entropy;
 }
 
 // TODO: These params should be made const, either by directly referencing the underlying NeuralNet or
 // adding const equivalent functions (default feedforward saves activations for backprop).
 void PolicyGradientAgent::logProgress(TrainingWorkspace& workspace, BaselineCalculator* baselineCalc) {
-    float averageTotalScore = float(mTotalScore) / mIterations;
+    float averageTotalScore = mTotalScore / (mTotalWeight * mConfig.numPlays);
     std::cout << "Thread: " << std::this_thread::get_id() << "--- ";
     std::cout << "Batches: " << mNumBatches << ", Hands: " << mIterations << ", Average Score: " << averageTotalScore << std::endl;
-    float averageRecentScore = float(mRecentTotal) / (LOG_STEP * mConfig.getBatchSize());
+    float averageRecentScore = mRecentTotal / (mRecentWeight * mConfig.numPlays);
     float averageRecentEntropy = mRecentEntropy.exchange(0.0f) / (LOG_STEP * mConfig.getBatchSize());
-    std::cout << "Average over last " << LOG_STEP << " batches: " << averageRecentScore << ", Entropy: " << averageRecentEntropy << std::endl;
-    mRecentTotal = 0; // Reset for next N batches.
+    // Kish effective sample size of the weighted deals, as a fraction of the deals played.
+    double recentWeight = mRecentWeight;
+    float effectiveSampleFraction = recentWeight * recentWeight / mRecentWeightSquared / (LOG_STEP * mConfig.getBatchSize());
+    std::cout << "Average over last " << LOG_STEP << " batches: " << averageRecentScore << ", Entropy: " << averageRecentEntropy
+              << ", Effective Sample Size: " << effectiveSampleFraction << std::endl;
+    // Reset for next N batches.
+    mRecentTotal = 0.0;
+    mRecentWeight = 0.0;
+    mRecentWeightSquared = 0.0;
 
     // Run and log an example hand without making any updates
     Hand h = mVideoPoker.deal();
@@ -117,9 +162,11 @@ void PolicyGradientAgent::logProgress(TrainingWorkspace& workspace, BaselineCalc
     mNet->feedforward(input, workspace.mInferenceWorkspace);
     const std::vector<float>& output = workspace.getOutputs();
     std::cout << "Outputs: " << output << std::endl;
-    std::cout << "Entropy: " << calculateEntropy(output) << std::endl;
-    std::vector<bool> exchanges = mDiscardStrategy->selectAction(output, mRng, true);
-    std::cout << "Prediction: " << exchanges << std::endl;
+    std::vector<float> logOutput(output.size());
+    neuralKernels().log(output.data(), output.size(), logOutput.data());
+    std::cout << "Entropy: " << calculateEntropy(output, logOutput) << std::endl;
+    ExchangeMask exchanges = mDiscardStrategy->selectAction(output, mRng, true);
+    std::cout << "Prediction: " << toExchangeVector(exchanges) << std::endl;
     Hand e = mVideoPoker.exchange(exchanges);
     std::cout << "Ending Hand: " << e << std::endl;
     int score = mVideoPoker.score(mVideoPoker.getHandType(e));
@@ -131,26 +178,140 @@ void PolicyGradientAgent::logProgress(TrainingWorkspace& workspace, BaselineCalc
     mLogFile << averageTotalScore << ",";
     mLogFile << averageRecentScore << ",";
     mLogFile << averageRecentEntropy << ",";
+    mLogFile << effectiveSampleFraction << ",";
     logAndPrintNorms(workspace);
+    logAndPrintSparsity(workspace);
     mLogFile << std::endl;
     std::cout << std::endl;
 }
 
 std::vector<float> PolicyGradientAgent::predict(const std::vector<float>& input) const {
+    if (mQuantizedNet) {
+        std::vector<float> outputs;
+        mQuantizedNet->feedforward(input, outputs);
+        return outputs;
+    }
     InferenceWorkspace workspace(mConfig.actorTopology); // TODO: Reuse
+    workspace.mTeam = mTeam.get();
     mNet->feedforward(input, workspace);
     return workspace.getOutputs();
 }
 
+void PolicyGradientAgent::setLayerThreads(int threads) {
+    mTeam = threads > 1 ? std::make_unique<ThreadTeam>(threads) : nullptr;
+}
+
+void PolicyGradientAgent::compile(const std::string& directory, const std::string& name) const {
+    compileNetwork(*mNet, directory, name);
+}
+
+void PolicyGradientAgent::setCritic(Network* critic, Optimizer* criticOptimizer) {
+    mCritic = critic;
+    mCriticOptimizer = criticOptimizer;
+}
+
+CheckpointContents PolicyGradientAgent::getCheckpointContents(double trainingSeconds) {
+    CheckpointContents contents;
+    contents.arenas = {
+        &mNet->getParameters(),
+        mOptimizer->getState(),
+        mCritic != nullptr ? &mCritic->getParameters() : nullptr,
+        mCriticOptimizer != nullptr ? mCriticOptimizer->getState() : nullptr,
+    };
+    contents.rngs.push_back(&mRng);
+    for (Rng& rng : mRngs) {
+        contents.rngs.push_back(&rng);
+    }
+    std::vector<std::vector<LayerSpecification>> topologies {mNet->getTopology()};
+    if (mCritic != nullptr) {
+        topologies.push_back(mCritic->getTopology());
+    }
+    contents.layoutHash = checkpointLayoutHash(contents, topologies);
+    contents.counters = {mNumBatches, mIterations, mTotalScore, mTotalWeight, trainingSeconds};
+    return contents;
+}
+
+void PolicyGradientAgent::save(const std::string& path) {
+    mCheckpointWriter.wait();
+    saveCheckpoint(path, getCheckpointContents(mTotalTrainingTime.count()));
+    mCheckpointPath = path;
+}
+
+void PolicyGradientAgent::load(const std::string& path) {
+    mCheckpointWriter.wait();
+    CheckpointCounters counters = loadCheckpoint(path, getCheckpointContents(0.0));
+    mNumBatches = counters.numBatches;
+    mIterations = counters.iterations;
+    mTotalScore = counters.totalScore;
+    mTotalWeight = counters.totalWeight;
+    mTotalTrainingTime = std::chrono::duration<double>(counters.trainingSeconds);
+    mQuantizedNet.reset();
+    mCheckpointPath = path;
+}
+
+void PolicyGradientAgent::predictBatch(const std::vector<int>& activeInputs, int count, std::vector<float>& outputs) const {
+    if (mQuantizedNet) {
+        mQuantizedNet->feedforward(activeInputs, ENCODED_ACTIVE_INPUTS, count, outputs);
+        return;
+    }
+    BatchInferenceWorkspace workspace(mConfig.actorTopology);
+    mNet->feedforward(activeInputs, ENCODED_ACTIVE_INPUTS, count, workspace);
+    const std::vector<float>& batchOutputs = workspace.getOutputs();
+    outputs.assign(batchOutputs.begin(), batchOutputs.begin() + count * mConfig.actorTopology.back().numNeurons);
+}
+
+void PolicyGradientAgent::quantize(int iterations, Rng& rng) {
+    mQuantizedNet = std::make_unique<QuantizedNet>(*mNet);
+    size_t fp32Bytes = 0;
+    for (size_t l = 1; l < mConfig.actorTopology.size(); l++) {
+        fp32Bytes += size_t(mConfig.actorTopology[l - 1].numNeurons + 1) * mConfig.actorTopology[l].numNeurons * sizeof(float);
+    }
+    std::cout << "---Quantized actor with " << quantizedKernels().name << " kernels, "
+              << mQuantizedNet->getParameterBytes() << " bytes against " << fp32Bytes << " in fp32.---" << std::endl;
+
+    VideoPoker vp {rng, ShuffleMode::PARTIAL, mVariant};
+    BatchInferenceWorkspace workspace(mConfig.actorTopology);
+    int outputSize = mConfig.actorTopology.back().numNeurons;
+    std::vector<int> activeInputs(size_t(QUANTIZE_CHECK_BATCH) * ENCODED_ACTIVE_INPUTS);
+    std::vector<float> quantizedOutputs;
+    int disagreements = 0;
+    for (int first = 0; first < iterations; first += QUANTIZE_CHECK_BATCH) {
+        int count = std::min(QUANTIZE_CHECK_BATCH, iterations - first);
+        for (int i = 0; i < count; i++) {
+            encodeHandIndices(vp.deal(), &activeInputs[size_t(i) * ENCODED_ACTIVE_INPUTS]);
+            vp.exchange(ExchangeMask(0));
+        }
+        mNet->feedforward(activeInputs, ENCODED_ACTIVE_INPUTS, count, workspace);
+        mQuantizedNet->feedforward(activeInputs, ENCODED_ACTIVE_INPUTS, count, quantizedOutputs);
+        const std::vector<float>& outputs = workspace.getOutputs();
+        for (int i = 0; i < count; i++) {
+            std::vector<float> fp32(outputs.begin() + i * outputSize, outputs.begin() + (i + 1) * outputSize);
+            std::vector<float> int8(quantizedOutputs.begin() + i * outputSize, quantizedOutputs.begin() + (i + 1) * outputSize);
+            disagreements += mDiscardStrategy->selectAction(fp32, rng, false) != mDiscardStrategy->selectAction(int8, rng, false);
+        }
+    }
+    std::cout << "---Greedy decisions changed on " << 100.0f * disagreements / iterations << "% of "
+              << iterations << " deals.---" << std::endl;
+}
+
+void PolicyGradientAgent::useFp32() {
+    mQuantizedNet.reset();
+}
+
 void PolicyGradientAgent::train(const std::atomic<bool>& stopSignal) {
     auto trainingStartTime = std::chrono::steady_clock::now();
+    mQuantizedNet.reset();
 
     std::vector<TrainingWorkspace> trainingWorkspaces(mConfig.numWorkers, TrainingWorkspace(mConfig.actorTopology));
     std::vector<std::unique_ptr<BaselineCalculator>> baselineCalcs;
     baselineCalcs.reserve(mConfig.numWorkers);
     std::generate_n(std::back_inserter(baselineCalcs), mConfig.numWorkers, mBaselineFactory);
 
+    // Sampled once per batch in the completion step so every worker sees the same value after the
+    // barrier (a worker reading the atomic directly could miss the stop and wait alone forever).
+    bool stopping = false;
     auto completionStep = [&]() {
+        stopping = stopSignal;
         mNumBatches += 1;
         for (size_t i = 1; i < trainingWorkspaces.size(); i++) {
             trainingWorkspaces[0].aggregate(trainingWorkspaces[i]);
@@ -162,6 +323,12 @@ void PolicyGradientAgent::train(const std::atomic<bool>& stopSignal) {
         if (mNumBatches % LOG_STEP == 0) {
             logProgress(trainingWorkspaces[0], baselineCalcs[0].get());
         }
+        if (!mCheckpointPath.empty() && mNumBatches % CHECKPOINT_STEP == 0) {
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - trainingStartTime;
+            if (!mCheckpointWriter.saveAsync(mCheckpointPath, getCheckpointContents((mTotalTrainingTime + elapsed).count()))) {
+                std::cout << "Skipped the checkpoint at batch " << mNumBatches << ", the last is still being written." << std::endl;
+            }
+        }
     };
 
 
@@ -169,42 +336,83 @@ void PolicyGradientAgent::train(const std::atomic<bool>& stopSignal) {
 
 
     auto trainingLoop = [&](int workerId) {
-        VideoPoker vp {mRngs[workerId]};
+        VideoPokerBatch games {mConfig.numInBatch, mRngs[workerId], mConfig.variant};
+        games.setDealer(mDealer.get());
         TrainingWorkspace& t = trainingWorkspaces[workerId];
+        BaselineCalculator* baselineCalc = baselineCalcs[workerId].get();
+        int outputSize = mConfig.actorTopology.back().numNeurons;
+        std::vector<float> baselines;
+        std::vector<float> output(outputSize);
+        std::vector<float> logOutput(outputSize);
+        std::vector<ExchangeMask> exchanges(mConfig.numInBatch);
+        std::vector<float> rewards(mConfig.numInBatch);
+        std::vector<float> errors(mConfig.numInBatch * outputSize);
 
         while (true) { // Break when stopSignal is set.
             t.reset(); // Clear accumulated gradients
+            // Each batch starts at a fixed offset of the worker's stream, so a run can be replayed from any batch.
+            mRngs[workerId].seek(uint64_t(mNumBatches) * RNG_OUTPUTS_PER_BATCH);
 
+            // The whole minibatch goes through the nets at once: one batched forward pass, all the
+            // decisions and plays, then one batched backward pass.
+            games.deal();
+            const std::vector<int>& activeInputs = games.getActiveInputs();
+            baselineCalc->predictBatch(activeInputs, ENCODED_ACTIVE_INPUTS, mConfig.numInBatch, baselines);
+            mNet->feedforward(activeInputs, ENCODED_ACTIVE_INPUTS, mConfig.numInBatch, t.mBatchInferenceWorkspace);
+            const std::vector<float>& outputs = t.mBatchInferenceWorkspace.getOutputs();
             for (int i = 0; i < mConfig.numInBatch; i++) {
-                Hand h = vp.deal();
-                std::vector<float> input = translateHand(h);
-                float baseline = baselineCalcs[workerId]->predict(input);
-                mNet->feedforward(input, t.mInferenceWorkspace);
-                const std::vector<float>& output = t.getOutputs();
-                std::vector<bool> exchanges = mDiscardStrategy->selectAction(output, mRngs[workerId], true);
-                Hand e = vp.exchange(exchanges);
-
-                int score = vp.score(vp.getHandType(e));
-                baselineCalcs[workerId]->train(score);
-                mTotalScore += score;
-                mRecentTotal += score;
-                mIterations += 1;
-
-                float advantage = (score - baseline);
-                std::vector<float> policyError = mDiscardStrategy->calculateError(output, exchanges, advantage);
-                float entropy = calculateEntropy(output);
-                mRecentEntropy += entropy;
+                std::copy_n(outputs.begin() + i * outputSize, outputSize, output.begin());
+                exchanges[i] = mDiscardStrategy->selectAction(output, mRngs[workerId], true);
+            }
+            const std::vector<int>& scores = games.exchange(exchanges, mConfig.numPlays);
+            const std::vector<float>& weights = games.getWeights();
+            // A softmax policy comes with its log-probabilities, anything else takes a log pass.
+            const std::vector<float>& logOutputs = t.mBatchInferenceWorkspace.getLogOutputs();
+
+            double totalScore = 0.0;
+            double totalWeight = 0.0;
+            double totalWeightSquared = 0.0;
+            float totalEntropy = 0.0f;
+            for (int i = 0; i < mConfig.numInBatch; i++) {
+                std::copy_n(outputs.begin() + i * outputSize, outputSize, output.begin());
+                float reward = float(scores[i]) / mConfig.numPlays;
+                float weight = weights[i];
+                rewards[i] = reward;
+                totalScore += weight * scores[i];
+                totalWeight += weight;
+                totalWeightSquared += weight * weight;
+
+                // Scaling by the importance weight keeps the gradient unbiased under boosted dealing.
+                float advantage = (reward - baselines[i]) * weight;
+                std::vector<float> policyError = mDiscardStrategy->calculateError(output, exchanges[i], advantage);
+                if (logOutputs.empty()) {
+                    neuralKernels().log(output.data(), outputSize, logOutput.data());
+                } else {
+                    std::copy_n(logOutputs.begin() + i * outputSize, outputSize, logOutput.begin());
+                }
+                float entropy = calculateEntropy(output, logOutput);
+                totalEntropy += entropy;
                 if (mConfig.entropyCoeff != 0.0f) {
-                    std::vector<float> entropyError = mDiscardStrategy->calculateEntropyError(output, entropy, mConfig.entropyCoeff);
-                    for (size_t i = 0; i < policyError.size(); i++) {
-                        policyError[i] += entropyError[i];
+                    std::vector<float> entropyError = mDiscardStrategy->calculateEntropyError(output, logOutput, entropy, mConfig.entropyCoeff * weight);
+                    for (size_t j = 0; j < policyError.size(); j++) {
+                        policyError[j] += entropyError[j];
                     }
                 }
-                mNet->backpropagate(policyError, t);
+                std::copy(policyError.begin(), policyError.end(), errors.begin() + i * outputSize);
             }
+            baselineCalc->trainBatch(rewards);
+            mNet->backpropagate(errors, mConfig.numInBatch, t);
+
+            mTotalScore += totalScore;
+            mTotalWeight += totalWeight;
+            mRecentTotal += totalScore;
+            mRecentWeight += totalWeight;
+            mRecentWeightSquared += totalWeightSquared;
+            mRecentEntropy += totalEntropy;
+            mIterations += mConfig.numInBatch * mConfig.numPlays;
 
             barrier.arrive_and_wait(); // Runs completionStep once all threads arrive.
-            if (stopSignal) {
+            if (stopping) {
                 break;
             }
         }
@@ -228,7 +436,11 @@ int PolicyGradientAgent::getNumTrainingIterations() const {
     return mIterations;
 }
 
-void PolicyGradientAgent::logAndPrintNorms(const TrainingWorkspace& workspace) {
+int PolicyGradientAgent::getNumBatches() const {
+    return mNumBatches;
+}
+
+void PolicyGradientAgent::logAndPrintNorms(TrainingWorkspace& workspace) {
     std::vector<double> weightNormsSquared = mNet->getLayerWeightNormsSquared();
     std::cout << "Weight Norms:" << std::endl;
     double totalWeightNormSquared = 0.0;
@@ -258,3 +470,16 @@ void PolicyGradientAgent::logAndPrintNorms(const TrainingWorkspace& workspace) {
         mLogFile << std::sqrt(gradientNormsSquared[i]) << ",";
     }
 }
+
+void PolicyGradientAgent::logAndPrintSparsity(const TrainingWorkspace& workspace) {
+    std::vector<double> sparsity = workspace.mBatchInferenceWorkspace.getLayerActivationSparsity();
+    std::vector<double> dead = workspace.mBatchInferenceWorkspace.getLayerDeadFraction();
+    std::cout << "Activation Sparsity:" << std::endl;
+    for (size_t i = 0; i < sparsity.size(); i++) {
+        if (mConfig.actorTopology[i + 1].activationType != Activation::RELU) {
+            continue;
+        }
+        std::cout << "Layer " << i + 1 << ": " << sparsity[i] << " zero, " << dead[i] << " of neurons dead in the batch" << std::endl;
+        mLogFile << sparsity[i] << "," << dead[i] << ",";
+    }
+}
@@ -2,11 +2,16 @@
 
 #include "agent/base_agent.h"
 #include "neural.h"
+#include "quantized_net.h"
 #include "poker.h"
 #include "decision.h"
 #include "baseline.h"
 #include "workspace.h"
 #include "hyperparams.h"
+#include "rng.h"
+#include "stratified_dealer.h"
+#include "thread_team.h"
+#include "checkpoint.h"
 
 #include <random>
 #include <vector>
@@ -16,35 +21,73 @@
 #include <fstream>
 #include <chrono>
 
+// Batches between the checkpoints training writes once the agent has been saved or loaded.
+constexpr int CHECKPOINT_STEP = 10000;
+
 class PolicyGradientAgent : public BaseAgent {
 public:
     PolicyGradientAgent(const HyperParameters& config,
           std::string fileName, 
-          unsigned int seed, 
+          uint64_t seed, 
           std::function<std::unique_ptr<BaselineCalculator>()> baselineFactory);
     void train(const std::atomic<bool>& stopSignal) override;
     std::vector<float> predict(const std::vector<float>& input) const override;
     int getNumTrainingIterations() const;
+    int getNumBatches() const;
+    // Evaluates with an int8 copy of the current weights until the next train or useFp32, and reports
+    // the memory saved and how often the greedy decision changes over iterations random deals.
+    void quantize(int iterations, Rng& rng);
+    void useFp32();
+    // Splits each wide layer of per-sample predictions across a team of threads, counting the caller.
+    // 1 goes back to a single thread.
+    void setLayerThreads(int threads);
+    // Writes the actor as directory/name.h and .cc, see compileNetwork.
+    void compile(const std::string& directory, const std::string& name) const;
+    // The critic net and optimizer the baseline trains, neither owned, for checkpoints to cover.
+    void setCritic(Network* critic, Optimizer* criticOptimizer);
+    // Checkpoints hold the actor, the critic, the state of both optimizers, the agent's RNG positions and
+    // its training counters, see checkpoint.h. Once saved to or loaded from a path, training saves there
+    // every CHECKPOINT_STEP batches on a background thread. Both throw std::runtime_error.
+    void save(const std::string& path);
+    void load(const std::string& path);
+protected:
+    void predictBatch(const std::vector<int>& activeInputs, int count, std::vector<float>& outputs) const override;
 private:
     HyperParameters mConfig;
-    std::unique_ptr<NeuralNet> mNet;
+    std::unique_ptr<Network> mNet;
+    std::unique_ptr<QuantizedNet> mQuantizedNet; // Stale once mNet trains, so train() drops it.
     std::unique_ptr<Optimizer> mOptimizer;
-    std::vector<std::mt19937> mRngs; // Per worker RNG engine
+    std::unique_ptr<ThreadTeam> mTeam; // Null when single-threaded.
+    std::vector<Rng> mRngs; // Per worker RNG stream
     std::function<std::unique_ptr<BaselineCalculator>()> mBaselineFactory;
     std::ofstream mLogFile;
     // Agent-level RNG and Poker client for sample hands and Evals. Worker threads have separate copies.
-    std::mt19937 mRng;
+    Rng mRng;
     VideoPoker mVideoPoker;
+    std::unique_ptr<StratifiedDealer> mDealer; // Only set when the config boosts deal strata.
     // Progress indicators
-    std::atomic<int> mTotalScore = 0;
-    std::atomic<int> mRecentTotal = 0;
+    // Scores and deal counts are importance weighted, all weights are 1 without a StratifiedDealer.
+    std::atomic<double> mTotalScore = 0.0;
+    std::atomic<double> mTotalWeight = 0.0;
+    std::atomic<double> mRecentTotal = 0.0;
+    std::atomic<double> mRecentWeight = 0.0;
+    std::atomic<double> mRecentWeightSquared = 0.0;
     std::atomic<float> mRecentEntropy = 0.0f;
     std::atomic<int> mIterations = 0;
     int mNumBatches = 0; // Only called from single-threaded completion step.
     std::chrono::duration<double> mTotalTrainingTime {};
+    Network* mCritic = nullptr;
+    Optimizer* mCriticOptimizer = nullptr;
+    std::string mCheckpointPath; // Empty until the first save or load.
+    CheckpointWriter mCheckpointWriter;
 
-    float calculateEntropy(const std::vector<float>& policy);
+    // -sum p log p, given the log of each probability.
+    float calculateEntropy(const std::vector<float>& policy, const std::vector<float>& logPolicy);
     // Should be called after gradient aggregation but before reset! (Else gradient norm == 0)
     void logProgress(TrainingWorkspace& workspace, BaselineCalculator* baselineCalc);
-    void logAndPrintNorms(const TrainingWorkspace& workspace);
+    void logAndPrintNorms(TrainingWorkspace& workspace);
+    // Zero activations of the ReLU layers over the workspace's last batch, and their neurons dead in every row.
+    void logAndPrintSparsity(const TrainingWorkspace& workspace);
+    // Views of everything a checkpoint holds, with trainingSeconds as the time trained so far.
+    CheckpointContents getCheckpointContents(double trainingSeconds);
 };
\ No newline at end of file
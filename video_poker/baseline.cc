@@ -4,10 +4,20 @@
 
 #include <vector>
 
+void BaselineCalculator::trainBatch(const std::vector<float>& rewards) {
+    for (float reward : rewards) {
+        train(reward);
+    }
+}
+
 float FlatBaseline::predict(const std::vector<float>& inputs) {
     return 0.1f;
 }
 
+void FlatBaseline::predictBatch(const std::vector<int>& activeInputs, int activePerSample, int count, std::vector<float>& predictions) {
+    predictions.assign(count, predict({})); // Independent of the hand.
+}
+
 float RunningAverageBaseline::predict(const std::vector<float>& inputs) {
     if (mCount == 0) {
         return 0.33f; // EV of random action
@@ -15,16 +25,20 @@ float RunningAverageBaseline::predict(const std::vector<float>& inputs) {
     return mTotalScore / mCount;
 }
 
-void RunningAverageBaseline::train(int score) {
-    mTotalScore += score;
+void RunningAverageBaseline::predictBatch(const std::vector<int>& activeInputs, int activePerSample, int count, std::vector<float>& predictions) {
+    predictions.assign(count, predict({})); // Independent of the hand.
+}
+
+void RunningAverageBaseline::train(float reward) {
+    mTotalScore += reward;
     mCount += 1;
 }
 
-CriticNetworkBaseline::CriticNetworkBaseline(NeuralNet* net, const std::vector<LayerSpecification>& criticTopology, float learningRate, std::unique_ptr<Optimizer> optimizer)
+CriticNetworkBaseline::CriticNetworkBaseline(Network* net, const std::vector<LayerSpecification>& criticTopology, float learningRate, Optimizer* optimizer)
         : mNet(net), 
           mTrainingWorkspace(criticTopology),
           mLearningRate(learningRate),
-          mOptimizer(std::move(optimizer)) {}
+          mOptimizer(optimizer) {}
 
 float CriticNetworkBaseline::predict(const std::vector<float>& inputs) {
     mNet->feedforward(inputs, mTrainingWorkspace.mInferenceWorkspace);
@@ -32,11 +46,26 @@ float CriticNetworkBaseline::predict(const std::vector<float>& inputs) {
     return mPrediction;
 }
 
-void CriticNetworkBaseline::train(int score) {
-    float error = mPrediction - score;
+void CriticNetworkBaseline::train(float reward) {
+    float error = mPrediction - reward;
     mNet->backpropagate({error}, mTrainingWorkspace);
 }
 
+void CriticNetworkBaseline::predictBatch(const std::vector<int>& activeInputs, int activePerSample, int count, std::vector<float>& predictions) {
+    mNet->feedforward(activeInputs, activePerSample, count, mTrainingWorkspace.mBatchInferenceWorkspace);
+    const std::vector<float>& outputs = mTrainingWorkspace.mBatchInferenceWorkspace.getOutputs();
+    mPredictions.assign(outputs.begin(), outputs.begin() + count);
+    predictions = mPredictions;
+}
+
+void CriticNetworkBaseline::trainBatch(const std::vector<float>& rewards) {
+    mErrors.resize(rewards.size());
+    for (size_t i = 0; i < rewards.size(); i++) {
+        mErrors[i] = mPredictions[i] - rewards[i];
+    }
+    mNet->backpropagate(mErrors, rewards.size(), mTrainingWorkspace);
+}
+
 void CriticNetworkBaseline::update(std::vector<std::unique_ptr<BaselineCalculator>>& otherCalcs, int batchSize) {
     for (size_t i = 1; i < otherCalcs.size(); i++) {
         // Icky encasulation breaking :( -- Crash if wrong type (bad_cast exception)
@@ -18,7 +18,11 @@ class BaselineCalculator {
 public:
     virtual ~BaselineCalculator() = default;
     virtual float predict(const std::vector<float>& inputs) = 0;
-    virtual void train(int score) = 0;
+    virtual void train(float reward) = 0;
+    // Minibatch versions: predicts count hands given as sparse one-hot inputs (activePerSample
+    // indices each), then trains on one reward per hand. trainBatch defaults to train per sample.
+    virtual void predictBatch(const std::vector<int>& activeInputs, int activePerSample, int count, std::vector<float>& predictions) = 0;
+    virtual void trainBatch(const std::vector<float>& rewards);
     virtual void update(std::vector<std::unique_ptr<BaselineCalculator>>& otherCalcs, int batchSize) = 0;
     virtual std::string getName() = 0;
 };
@@ -26,7 +30,8 @@ public:
 class FlatBaseline : public BaselineCalculator {
 public:
     virtual float predict(const std::vector<float>& inputs) override;
-    virtual void train(int score) override { /*No-Op*/ };
+    virtual void predictBatch(const std::vector<int>& activeInputs, int activePerSample, int count, std::vector<float>& predictions) override;
+    virtual void train(float reward) override { /*No-Op*/ };
     virtual void update(std::vector<std::unique_ptr<BaselineCalculator>>& otherCalcs, int batchSize) override { /*No-Op*/ }
     virtual std::string getName() { return "Flat"; }
 };
@@ -34,7 +39,8 @@ public:
 class RunningAverageBaseline : public BaselineCalculator {
 public:
     virtual float predict(const std::vector<float>& inputs) override;
-    virtual void train(int score) override;
+    virtual void predictBatch(const std::vector<int>& activeInputs, int activePerSample, int count, std::vector<float>& predictions) override;
+    virtual void train(float reward) override;
     // For simplicity, let each worker thread keep it's own running average. 
     virtual void update(std::vector<std::unique_ptr<BaselineCalculator>>& otherCalcs, int batchSize) override { /* No-Op */ };
     virtual std::string getName() { return "Running Average"; }
@@ -46,16 +52,21 @@ private:
 
 class CriticNetworkBaseline : public BaselineCalculator {
 public:
-    CriticNetworkBaseline(NeuralNet* net, const std::vector<LayerSpecification>& criticTopology, float learningRate, std::unique_ptr<Optimizer> optimizer);
+    // optimizer is not owned, so its state outlives the calculators of one training session.
+    CriticNetworkBaseline(Network* net, const std::vector<LayerSpecification>& criticTopology, float learningRate, Optimizer* optimizer);
     virtual float predict(const std::vector<float>& inputs) override;
-    virtual void train(int score) override;
+    virtual void train(float reward) override;
+    virtual void predictBatch(const std::vector<int>& activeInputs, int activePerSample, int count, std::vector<float>& predictions) override;
+    virtual void trainBatch(const std::vector<float>& rewards) override;
     // Aggregates gradients and updates underlying net. Must only be called from *one* calculator.
     virtual void update(std::vector<std::unique_ptr<BaselineCalculator>>& otherCalcs, int batchSize) override;
     virtual std::string getName() { return "Critic Network"; }
 private:
-    NeuralNet* mNet;
+    Network* mNet;
     TrainingWorkspace mTrainingWorkspace;
     float mPrediction;
+    std::vector<float> mPredictions; // Of the last predictBatch, kept for trainBatch.
+    std::vector<float> mErrors;
     float mLearningRate;
-    std::unique_ptr<Optimizer> mOptimizer;
+    Optimizer* mOptimizer;
 };
\ No newline at end of file
@@ -0,0 +1,92 @@
+#include "canonical.h"
+
+#include "poker.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+uint32_t handRank(uint64_t mask) {
+    uint32_t rank = 0;
+    for (int k = 1; k <= 5; k++) {
+        int index = std::countr_zero(mask);
+        rank += BINOMIAL[index][k];
+        mask &= mask - 1;
+    }
+    return rank;
+}
+
+Hand unrankHand(uint32_t rank) {
+    // Greedily take the largest card whose binomial still fits.
+    Hand hand;
+    int card = 51;
+    for (int k = 5; k >= 1; k--) {
+        while (BINOMIAL[card][k] > rank) card--;
+        rank -= BINOMIAL[card][k];
+        hand[k-1] = Card::fromIndex(card);
+        card--;
+    }
+    return hand;
+}
+
+CanonicalHand canonicalize(const Hand& hand) {
+    std::array<uint32_t, 4> suitRanks {};
+    for (int i = 0; i < 5; i++) {
+        suitRanks[hand[i].suit()] |= 1u << (hand[i].rank() - 2);
+    }
+    std::array<int, 4> suits {0, 1, 2, 3};
+    auto key = [&](int s) { return (uint32_t(std::popcount(suitRanks[s])) << 13) | suitRanks[s]; };
+    std::sort(suits.begin(), suits.end(), [&](int a, int b) { return key(a) > key(b); });
+    std::array<int, 4> relabel;
+    for (int i = 0; i < 4; i++) {
+        relabel[suits[i]] = i;
+    }
+
+    std::array<uint8_t, 5> renamed;
+    for (int i = 0; i < 5; i++) {
+        renamed[i] = (hand[i].rank() - 2) * 4 + relabel[hand[i].suit()];
+    }
+    CanonicalHand canonical;
+    for (int i = 0; i < 5; i++) {
+        canonical.order[i] = i;
+    }
+    std::sort(canonical.order.begin(), canonical.order.end(), [&](int a, int b) { return renamed[a] < renamed[b]; });
+    for (int j = 0; j < 5; j++) {
+        canonical.hand[j] = Card::fromIndex(renamed[canonical.order[j]]);
+    }
+    canonical.rank = handRank(canonical.hand.mask());
+    return canonical;
+}
+
+ExchangeMask CanonicalHand::toCanonical(ExchangeMask original) const {
+    ExchangeMask canonical = 0;
+    for (int j = 0; j < 5; j++) {
+        canonical |= ((original >> order[j]) & 1) << j;
+    }
+    return canonical;
+}
+
+ExchangeMask CanonicalHand::fromCanonical(ExchangeMask canonical) const {
+    ExchangeMask original = 0;
+    for (int j = 0; j < 5; j++) {
+        original |= ((canonical >> j) & 1) << order[j];
+    }
+    return original;
+}
+
+std::vector<CanonicalClass> canonicalClasses() {
+    std::vector<uint32_t> multiplicity(NUM_HANDS, 0);
+    for (uint32_t rank = 0; rank < uint32_t(NUM_HANDS); rank++) {
+        multiplicity[canonicalize(unrankHand(rank)).rank]++;
+    }
+    std::vector<CanonicalClass> classes;
+    classes.reserve(NUM_CANONICAL_HANDS);
+    for (uint32_t rank = 0; rank < uint32_t(NUM_HANDS); rank++) {
+        if (multiplicity[rank] != 0) {
+            classes.push_back({unrankHand(rank), rank, multiplicity[rank]});
+        }
+    }
+    return classes;
+}
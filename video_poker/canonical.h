@@ -0,0 +1,54 @@
+#pragma once
+
+#include "poker.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+constexpr int NUM_HANDS = 2598960;
+constexpr int NUM_CANONICAL_HANDS = 134459;
+
+// Binomial coefficients C(n, k) for n <= 52, k <= 5.
+inline constexpr auto BINOMIAL = [] {
+    std::array<std::array<int64_t, 6>, 53> table {};
+    for (int n = 0; n <= 52; n++) {
+        table[n][0] = 1;
+        for (int k = 1; k <= 5 && k <= n; k++) {
+            table[n][k] = table[n-1][k-1] + (k <= n-1 ? table[n-1][k] : 0);
+        }
+    }
+    return table;
+}();
+
+// Colex rank of a five-card mask in [0, NUM_HANDS).
+uint32_t handRank(uint64_t mask);
+// Inverse of handRank, cards in ascending index order.
+Hand unrankHand(uint32_t rank);
+
+// A hand relabelled into the representative of its suit-isomorphism class.
+//
+// Suits are renamed by sorting them on (cards held, rank mask), largest first, and the renamed cards
+// are sorted by index. Isomorphic hands share the same suit rank masks up to order, so they land on
+// the same representative. Suits that tie are identical, so the choice between them does not matter.
+struct CanonicalHand {
+    Hand hand;                     // Cards in ascending index order.
+    uint32_t rank;                 // handRank of the representative.
+    std::array<uint8_t, 5> order;  // order[j] is the position in the original hand of card j.
+
+    // Maps an exchange over the original hand onto the representative and back.
+    ExchangeMask toCanonical(ExchangeMask original) const;
+    ExchangeMask fromCanonical(ExchangeMask canonical) const;
+};
+
+CanonicalHand canonicalize(const Hand& hand);
+
+// A suit-isomorphism class: its representative and how many of the NUM_HANDS deals it stands for.
+struct CanonicalClass {
+    Hand hand;
+    uint32_t rank;
+    uint32_t multiplicity;
+};
+
+// Every class in ascending order of representative rank, NUM_CANONICAL_HANDS in total.
+std::vector<CanonicalClass> canonicalClasses();
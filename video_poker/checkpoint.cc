@@ -0,0 +1,177 @@
+#include "checkpoint.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char CHECKPOINT_MAGIC[8] = {'V', 'P', 'C', 'K', 'P', 'T', '0', '0'};
+constexpr uint32_t CHECKPOINT_VERSION = 1;
+
+size_t roundUp(size_t value, size_t multiple) {
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+// Unmaps on every way out of loadCheckpoint.
+struct Mapping {
+    void* data = MAP_FAILED;
+    size_t size = 0;
+
+    ~Mapping() {
+        if (data != MAP_FAILED) {
+            munmap(data, size);
+        }
+    }
+};
+
+} // namespace
+
+CheckpointImage::CheckpointImage(const CheckpointContents& contents) {
+    CheckpointHeader header {};
+    std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.layoutHash = contents.layoutHash;
+    header.numArenas = contents.arenas.size();
+    header.numRngs = contents.rngs.size();
+    header.arenasOffset = sizeof(CheckpointHeader);
+    header.rngsOffset = header.arenasOffset + header.numArenas * sizeof(CheckpointArena);
+    header.counters = contents.counters;
+
+    std::vector<CheckpointArena> arenas;
+    size_t offset = roundUp(header.rngsOffset + header.numRngs * sizeof(CheckpointRng), ARENA_ALIGNMENT);
+    for (const ParameterArena* arena : contents.arenas) {
+        size_t size = arena != nullptr ? arena->size() : 0;
+        arenas.push_back({offset, size});
+        offset = roundUp(offset + size * sizeof(float), ARENA_ALIGNMENT);
+    }
+    std::vector<CheckpointRng> rngs;
+    for (const Rng* rng : contents.rngs) {
+        rngs.push_back({rng->getSeed(), rng->getStream(), rng->tell()});
+    }
+
+    mBytes.assign(offset, 0);
+    std::memcpy(mBytes.data(), &header, sizeof(header));
+    std::memcpy(mBytes.data() + header.arenasOffset, arenas.data(), arenas.size() * sizeof(CheckpointArena));
+    std::memcpy(mBytes.data() + header.rngsOffset, rngs.data(), rngs.size() * sizeof(CheckpointRng));
+    for (size_t a = 0; a < arenas.size(); a++) {
+        if (arenas[a].size != 0) {
+            std::memcpy(mBytes.data() + arenas[a].offset, contents.arenas[a]->data(), arenas[a].size * sizeof(float));
+        }
+    }
+}
+
+void CheckpointImage::write(const std::string& path) const {
+    std::string temporaryPath = path + ".tmp";
+    int fd = open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) throw std::runtime_error("Could not open checkpoint for writing: " + temporaryPath);
+    size_t written = 0;
+    while (written < mBytes.size()) {
+        ssize_t n = ::write(fd, mBytes.data() + written, mBytes.size() - written);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            close(fd);
+            throw std::runtime_error("Failed writing checkpoint: " + temporaryPath);
+        }
+        written += n;
+    }
+    if (fsync(fd) != 0) {
+        close(fd);
+        throw std::runtime_error("Failed syncing checkpoint: " + temporaryPath);
+    }
+    if (close(fd) != 0) throw std::runtime_error("Failed writing checkpoint: " + temporaryPath);
+    if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("Could not replace checkpoint: " + path);
+    }
+    std::string directory = std::filesystem::path(path).parent_path().string();
+    int directoryFd = open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (directoryFd < 0) throw std::runtime_error("Could not open checkpoint directory: " + directory);
+    int synced = fsync(directoryFd);
+    close(directoryFd);
+    if (synced != 0) throw std::runtime_error("Failed syncing checkpoint directory: " + directory);
+}
+
+void saveCheckpoint(const std::string& path, const CheckpointContents& contents) {
+    CheckpointImage(contents).write(path);
+}
+
+CheckpointCounters loadCheckpoint(const std::string& path, const CheckpointContents& contents) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Could not open checkpoint: " + path);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(CheckpointHeader)) {
+        close(fd);
+        throw std::runtime_error("Truncated checkpoint: " + path);
+    }
+    Mapping mapping;
+    mapping.size = st.st_size;
+    mapping.data = mmap(nullptr, mapping.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping.data == MAP_FAILED) throw std::runtime_error("Could not map checkpoint: " + path);
+
+    const char* base = static_cast<const char*>(mapping.data);
+    const CheckpointHeader* header = reinterpret_cast<const CheckpointHeader*>(base);
+    bool valid = std::memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) == 0
+              && header->version == CHECKPOINT_VERSION
+              && header->arenasOffset + header->numArenas * sizeof(CheckpointArena) <= mapping.size
+              && header->rngsOffset + header->numRngs * sizeof(CheckpointRng) <= mapping.size;
+    if (!valid) throw std::runtime_error("Invalid checkpoint: " + path);
+    if (header->layoutHash != contents.layoutHash || header->numArenas != contents.arenas.size()
+            || header->numRngs != contents.rngs.size()) {
+        throw std::runtime_error("Checkpoint is of a different model: " + path);
+    }
+    const CheckpointArena* arenas = reinterpret_cast<const CheckpointArena*>(base + header->arenasOffset);
+    for (size_t a = 0; a < contents.arenas.size(); a++) {
+        size_t size = contents.arenas[a] != nullptr ? contents.arenas[a]->size() : 0;
+        if (arenas[a].size != size || arenas[a].offset + size * sizeof(float) > mapping.size) {
+            throw std::runtime_error("Checkpoint is of a different model: " + path);
+        }
+    }
+
+    for (size_t a = 0; a < contents.arenas.size(); a++) {
+        if (arenas[a].size != 0) {
+            std::memcpy(contents.arenas[a]->data(), base + arenas[a].offset, arenas[a].size * sizeof(float));
+        }
+    }
+    const CheckpointRng* rngs = reinterpret_cast<const CheckpointRng*>(base + header->rngsOffset);
+    for (size_t r = 0; r < contents.rngs.size(); r++) {
+        *contents.rngs[r] = Rng(rngs[r].seed, rngs[r].stream);
+        contents.rngs[r]->seek(rngs[r].position);
+    }
+    return header->counters;
+}
+
+CheckpointWriter::~CheckpointWriter() {
+    wait();
+}
+
+bool CheckpointWriter::saveAsync(const std::string& path, const CheckpointContents& contents) {
+    if (mBusy) {
+        return false;
+    }
+    wait(); // Joins the finished thread of the last save.
+    mBusy = true;
+    mThread = std::thread([this, path, image = CheckpointImage(contents)] {
+        try {
+            image.write(path);
+        } catch (const std::runtime_error& e) {
+            std::cerr << e.what() << std::endl;
+        }
+        mBusy = false;
+    });
+    return true;
+}
+
+void CheckpointWriter::wait() {
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "parameter_arena.h"
+#include "rng.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct CheckpointCounters {
+    int64_t numBatches;
+    int64_t iterations;
+    double totalScore;
+    double totalWeight;
+    double trainingSeconds;
+};
+
+struct CheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t layoutHash;      // Rejects checkpoints of other topologies, see CheckpointContents.
+    uint32_t numArenas;
+    uint32_t numRngs;
+    uint64_t arenasOffset;    // numArenas CheckpointArena records.
+    uint64_t rngsOffset;      // numRngs CheckpointRng records.
+    CheckpointCounters counters;
+};
+
+struct CheckpointArena {
+    uint64_t offset;          // Of the floats, a multiple of ARENA_ALIGNMENT.
+    uint64_t size;            // In floats, padding included.
+};
+
+struct CheckpointRng {
+    uint64_t seed;
+    uint64_t stream;
+    uint64_t position;
+};
+
+// The state a checkpoint covers, as pointers into the live objects. The order of arenas and rngs is
+// part of the format, and layoutHash should change with anything that changes their layout.
+struct CheckpointContents {
+    uint32_t layoutHash = 0;
+    // Null entries are saved empty and must be null on load, like the state of an optimizer without any.
+    std::vector<ParameterArena*> arenas;
+    std::vector<Rng*> rngs;
+    CheckpointCounters counters {};
+};
+
+// A checkpoint file in memory, ready to be written.
+//
+// The file is a CheckpointHeader, the arena and RNG records, then each arena's data() verbatim at an
+// ARENA_ALIGNMENT offset. Loading maps the file and copies every arena in one memcpy, as a checkpoint
+// of the same layout holds the same bytes, padding included.
+class CheckpointImage {
+public:
+    // Copies the state out of contents, which must stay quiet for the copy only.
+    explicit CheckpointImage(const CheckpointContents& contents);
+    // Writes to a temporary file next to path, fsyncs it, renames it over path and fsyncs the directory,
+    // so a crash or power loss keeps either the previous checkpoint or the whole new one. Throws
+    // std::runtime_error.
+    void write(const std::string& path) const;
+
+private:
+    std::vector<char> mBytes;
+};
+
+void saveCheckpoint(const std::string& path, const CheckpointContents& contents);
+// Copies the arenas and RNG positions of the checkpoint at path into contents and returns its counters.
+// Throws std::runtime_error, before changing anything, if the file is missing, invalid or of another
+// layout.
+CheckpointCounters loadCheckpoint(const std::string& path, const CheckpointContents& contents);
+
+// Saves from a training loop without waiting on the disk: saveAsync takes the image on the caller's
+// thread and writes it on a background one.
+class CheckpointWriter {
+public:
+    CheckpointWriter() = default;
+    ~CheckpointWriter();
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+    // Returns false, without a copy, while the last checkpoint is still being written.
+    bool saveAsync(const std::string& path, const CheckpointContents& contents);
+    // Blocks until the last checkpoint is written.
+    void wait();
+
+private:
+    std::thread mThread;
+    std::atomic<bool> mBusy {false};
+};
@@ -0,0 +1,98 @@
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <memory>
+
+#include "poker.h"
+#include "rng.h"
+#include "hyperparams.h"
+#include "optimizer.h"
+#include "agent/policy_gradient_agent.h"
+#include "policy_net.h" // Written by the compile command, see make bench_compiled.
+
+// The agent that compiled policy_net: the same config and seed give it the same initial weights.
+PolicyGradientAgent makeAgent(int selection, uint64_t seed) {
+    return PolicyGradientAgent {
+        AvailableConfigs.at(selection),
+        "/dev/null",
+        seed,
+        [] { return std::make_unique<FlatBaseline>(); },
+    };
+}
+
+// The greedy decision on predict's outputs, as DecisionStrategy::selectAction makes it.
+int greedyHold(const std::vector<float>& outputs) {
+    if (outputs.size() == 32) {
+        return std::max_element(outputs.begin(), outputs.end()) - outputs.begin();
+    }
+    int exchanges = 0;
+    for (int i = 0; i < 5; i++) {
+        exchanges |= (outputs[i] > 0.5f) << i;
+    }
+    return exchanges;
+}
+
+template <typename F>
+void report(const std::string& name, size_t numHands, F&& body) {
+    auto start = std::chrono::steady_clock::now();
+    long checksum = body();
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+    std::cout << name << ": " << numHands / seconds.count() / 1e6 << " M hands/sec, "
+              << seconds.count() / numHands * 1e9 << " ns/hand (checksum " << checksum << ")" << std::endl;
+}
+
+// Usage: compiled_bench_runner <seed> [config] [checkpoint], matching the run that compiled policy_net.
+int main(int argc, char* argv[]) {
+    uint64_t seed = argc > 1 ? std::stoull(argv[1]) : 1;
+    int selection = argc > 2 ? std::stoi(argv[2]) : 0;
+    PolicyGradientAgent agent = makeAgent(selection, seed);
+    // The app's checkpoints also hold its critic, so load the trained actor next to one of the same
+    // layout, built as main builds it.
+    const HyperParameters& config = AvailableConfigs.at(selection);
+    std::unique_ptr<Network> critic = makeNetwork(config.criticTopology, Rng(seed).split(CRITIC_INIT_STREAM));
+    std::unique_ptr<Optimizer> criticOptimizer;
+    if (config.criticOptimizerType == MOMENTUM) {
+        criticOptimizer = std::make_unique<MomentumOptimizer>(critic.get(), config.criticMomentumCoeff);
+    } else {
+        criticOptimizer = std::make_unique<SDGOptimizer>();
+    }
+    if (argc > 3) {
+        agent.setCritic(critic.get(), criticOptimizer.get());
+        agent.load(argv[3]);
+    }
+
+    constexpr int NUM_HANDS = 200000;
+    Rng rng {5};
+    Deck deck {rng};
+    std::vector<Hand> hands;
+    for (int h = 0; h < NUM_HANDS; h++) {
+        deck.shuffle();
+        hands.push_back(Hand {{deck.draw(), deck.draw(), deck.draw(), deck.draw(), deck.draw()}});
+    }
+    std::vector<float> input(ENCODED_HAND_SIZE);
+    auto predictHold = [&](const Hand& hand) {
+        std::fill(input.begin(), input.end(), 0.0f);
+        encodeHand(hand, input.data());
+        return greedyHold(agent.predict(input));
+    };
+
+    int agreements = 0;
+    for (const Hand& hand : hands) {
+        agreements += policy_net::bestHold(hand) == predictHold(hand);
+    }
+    std::cout << "Compiled net agrees with predict on " << agreements << " of " << NUM_HANDS << " hands" << std::endl;
+
+    report("PolicyGradientAgent::predict", NUM_HANDS, [&] {
+        long sum = 0;
+        for (const Hand& hand : hands) sum += predictHold(hand);
+        return sum;
+    });
+    report("Compiled bestHold", NUM_HANDS, [&] {
+        long sum = 0;
+        for (const Hand& hand : hands) sum += policy_net::bestHold(hand);
+        return sum;
+    });
+    return 0;
+}
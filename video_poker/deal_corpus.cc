@@ -0,0 +1,147 @@
+#include "deal_corpus.h"
+
+#include "poker.h"
+#include "rng.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char CORPUS_MAGIC[8] = {'V', 'P', 'D', 'E', 'A', 'L', 'S', '1'};
+constexpr uint32_t CORPUS_VERSION = 1;
+// Deals written per buffered block.
+constexpr uint64_t WRITE_BLOCK = 1 << 16;
+
+ScoreSummary summarize(const std::vector<double>& values) {
+    if (values.empty()) throw std::invalid_argument("Cannot summarize an empty set of scores");
+    double mean = 0.0;
+    for (double v : values) {
+        mean += v;
+    }
+    mean /= values.size();
+    double variance = 0.0;
+    for (double v : values) {
+        variance += (v - mean) * (v - mean);
+    }
+    variance /= std::max<size_t>(1, values.size() - 1);
+    return {mean, std::sqrt(variance / values.size())};
+}
+
+} // namespace
+
+void DealCorpus::write(const std::string& path, uint64_t numDeals, Rng& rng) {
+    if (numDeals == 0) throw std::invalid_argument("A deal corpus needs at least one deal");
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) throw std::runtime_error("Could not open deal corpus for writing: " + path);
+    DealCorpusHeader header {};
+    std::memcpy(header.magic, CORPUS_MAGIC, sizeof(header.magic));
+    header.version = CORPUS_VERSION;
+    header.dealSize = CORPUS_DEAL_SIZE;
+    header.numDeals = numDeals;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    Deck deck {rng, ShuffleMode::PARTIAL};
+    std::vector<uint8_t> block;
+    block.reserve(WRITE_BLOCK * CORPUS_DEAL_SIZE);
+    for (uint64_t deal = 0; deal < numDeals; deal++) {
+        deck.shuffle();
+        for (int i = 0; i < CORPUS_DEAL_SIZE; i++) {
+            block.push_back(deck.draw().index);
+        }
+        if (block.size() >= WRITE_BLOCK * CORPUS_DEAL_SIZE || deal + 1 == numDeals) {
+            out.write(reinterpret_cast<const char*>(block.data()), block.size());
+            block.clear();
+        }
+    }
+    if (!out) throw std::runtime_error("Failed writing deal corpus: " + path);
+}
+
+DealCorpus::DealCorpus(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Could not open deal corpus: " + path);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(DealCorpusHeader)) {
+        close(fd);
+        throw std::runtime_error("Truncated deal corpus: " + path);
+    }
+    mMappingSize = st.st_size;
+    mMapping = mmap(nullptr, mMappingSize, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mMapping == MAP_FAILED) {
+        mMapping = nullptr;
+        throw std::runtime_error("Could not map deal corpus: " + path);
+    }
+
+    const uint8_t* base = static_cast<const uint8_t*>(mMapping);
+    mHeader = reinterpret_cast<const DealCorpusHeader*>(base);
+    bool valid = std::memcmp(mHeader->magic, CORPUS_MAGIC, sizeof(CORPUS_MAGIC)) == 0
+              && mHeader->version == CORPUS_VERSION
+              && mHeader->dealSize == CORPUS_DEAL_SIZE
+              && mHeader->numDeals > 0
+              && mHeader->numDeals <= (mMappingSize - sizeof(DealCorpusHeader)) / CORPUS_DEAL_SIZE;
+    if (valid) {
+        // Checked once here so getDeal can hand bytes straight to Card::fromIndex.
+        const uint8_t* cards = base + sizeof(DealCorpusHeader);
+        valid = std::all_of(cards, cards + mHeader->numDeals * CORPUS_DEAL_SIZE,
+                            [](uint8_t card) { return card < 52; });
+    }
+    if (!valid) {
+        munmap(mMapping, mMappingSize);
+        mMapping = nullptr;
+        throw std::runtime_error("Invalid deal corpus: " + path);
+    }
+    mDeals = base + sizeof(DealCorpusHeader);
+}
+
+DealCorpus::~DealCorpus() {
+    if (mMapping != nullptr) {
+        munmap(mMapping, mMappingSize);
+    }
+}
+
+uint64_t DealCorpus::getNumDeals() const {
+    return mHeader->numDeals;
+}
+
+Hand DealCorpus::getDeal(uint64_t deal) const {
+    const uint8_t* cards = mDeals + deal * CORPUS_DEAL_SIZE;
+    Hand hand;
+    for (int i = 0; i < 5; i++) {
+        hand[i] = Card::fromIndex(cards[i]);
+    }
+    return hand;
+}
+
+Hand DealCorpus::getFinalHand(uint64_t deal, ExchangeMask exchange) const {
+    const uint8_t* cards = mDeals + deal * CORPUS_DEAL_SIZE;
+    Hand hand = getDeal(deal);
+    int next = 5;
+    for (int i = 0; i < 5; i++) {
+        if ((exchange >> i) & 1) hand[i] = Card::fromIndex(cards[next++]);
+    }
+    return hand;
+}
+
+ScoreSummary summarizeScores(const std::vector<int>& scores) {
+    return summarize(std::vector<double>(scores.begin(), scores.end()));
+}
+
+ScoreSummary summarizePairedDifference(const std::vector<int>& scores, const std::vector<int>& baseline) {
+    if (scores.size() != baseline.size()) throw std::invalid_argument("Paired scores must cover the same deals");
+    std::vector<double> differences(scores.size());
+    for (size_t i = 0; i < scores.size(); i++) {
+        differences[i] = scores[i] - baseline[i];
+    }
+    return summarize(differences);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "poker.h"
+#include "rng.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Bytes per deal: the 5 dealt card indices, then the next 5 cards of the shuffled remainder in draw
+// order. Five draws are all a single play can use.
+constexpr int CORPUS_DEAL_SIZE = 10;
+
+struct DealCorpusHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t dealSize;
+    uint64_t numDeals;
+};
+
+// A fixed, read-only set of deals for evaluation with common random numbers.
+//
+// Every agent evaluated on the same corpus sees the same hands and, for the same hold, draws the same
+// cards, so the per-deal difference between two agents only reflects their decisions. The file is
+// memory mapped and deals are read in place.
+class DealCorpus {
+public:
+    static void write(const std::string& path, uint64_t numDeals, Rng& rng);
+
+    explicit DealCorpus(const std::string& path);
+    ~DealCorpus();
+    DealCorpus(const DealCorpus&) = delete;
+    DealCorpus& operator=(const DealCorpus&) = delete;
+
+    uint64_t getNumDeals() const;
+    Hand getDeal(uint64_t deal) const;
+    // The deal after replacing the cards in exchange, in position order, from its draw order.
+    Hand getFinalHand(uint64_t deal, ExchangeMask exchange) const;
+
+private:
+    void* mMapping = nullptr;
+    size_t mMappingSize = 0;
+    const DealCorpusHeader* mHeader = nullptr;
+    const uint8_t* mDeals = nullptr;
+};
+
+struct ScoreSummary {
+    double mean;
+    double standardError;
+};
+
+ScoreSummary summarizeScores(const std::vector<int>& scores);
+// Mean and standard error of scores[i] - baseline[i], the paired comparison on common deals.
+ScoreSummary summarizePairedDifference(const std::vector<int>& scores, const std::vector<int>& baseline);
@@ -1,30 +1,33 @@
 #pragma once
 
+#include "poker.h"
+#include "rng.h"
+
 #include <vector>
 #include <random>
 
 class DecisionStrategy {
 public:
     virtual ~DecisionStrategy() = default;
-    virtual std::vector<bool> selectAction(const std::vector<float>& netOutputs, std::mt19937& rng, bool random) = 0;
-    virtual std::vector<float> calculateError(const std::vector<float>& netOutputs, const std::vector<bool>& actionTaken, float advantage) = 0;
-    virtual std::vector<float> calculateEntropyError(const std::vector<float>& netOutputs, float entropy, float beta) = 0;
+    virtual ExchangeMask selectAction(const std::vector<float>& netOutputs, Rng& rng, bool random) = 0;
+    virtual std::vector<float> calculateError(const std::vector<float>& netOutputs, ExchangeMask actionTaken, float advantage) = 0;
+    // logOutputs holds the log of each output, which the gradient of the entropy needs.
+    virtual std::vector<float> calculateEntropyError(const std::vector<float>& netOutputs, const std::vector<float>& logOutputs, float entropy, float beta) = 0;
 };
 
 class FiveNeuronStrategy : public DecisionStrategy {
 public:
-    std::vector<bool> selectAction(const std::vector<float>& netOutputs, std::mt19937& rng, bool random) override;
-    std::vector<float> calculateError(const std::vector<float>& netOutputs, const std::vector<bool>& actionTaken, float advantage) override;
-    std::vector<float> calculateEntropyError(const std::vector<float>& netOutputs, float entropy, float beta) override { return std::vector<float>(); };
+    ExchangeMask selectAction(const std::vector<float>& netOutputs, Rng& rng, bool random) override;
+    std::vector<float> calculateError(const std::vector<float>& netOutputs, ExchangeMask actionTaken, float advantage) override;
+    std::vector<float> calculateEntropyError(const std::vector<float>& netOutputs, const std::vector<float>& logOutputs, float entropy, float beta) override { return std::vector<float>(); };
 };
 
+// Output i is the probability of ExchangeMask i, so actions need no conversion.
 class ThirtyTwoNeuronStrategy : public DecisionStrategy {
 public:
-    std::vector<bool> selectAction(const std::vector<float>& netOutputs, std::mt19937& rng, bool random) override;
-    std::vector<float> calculateError(const std::vector<float>& netOutputs, const std::vector<bool>& actionTaken, float advantage) override;
-    std::vector<float> calculateEntropyError(const std::vector<float>& netOutputs, float entropy, float beta) override;
+    ExchangeMask selectAction(const std::vector<float>& netOutputs, Rng& rng, bool random) override;
+    std::vector<float> calculateError(const std::vector<float>& netOutputs, ExchangeMask actionTaken, float advantage) override;
+    std::vector<float> calculateEntropyError(const std::vector<float>& netOutputs, const std::vector<float>& logOutputs, float entropy, float beta) override;
 private:
-    int selectDiscardCombination(const std::vector<float>& output, std::mt19937& rng, bool random);
-    std::vector<bool> calcExchangeVector(int val);
-    int calcIndexFromAction(const std::vector<bool>& actionTaken);
+    int selectDiscardCombination(const std::vector<float>& output, Rng& rng, bool random);
 };
\ No newline at end of file
@@ -0,0 +1,153 @@
+#include "ev_cache.h"
+
+#include "poker.h"
+#include "canonical.h"
+#include "ev_solver.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char EV_CACHE_MAGIC[8] = {'V', 'P', 'E', 'V', 'C', 'A', 'C', 'H'};
+constexpr uint32_t EV_CACHE_VERSION = 2;
+
+} // namespace
+
+uint32_t rulesHash(const GameTables& tables) {
+    // FNV-1a over the payouts and the wild and high pair ranks.
+    uint32_t hash = 2166136261u;
+    auto mix = [&](uint64_t value) {
+        for (int byte = 0; byte < 8; byte++) {
+            hash = (hash ^ uint32_t((value >> (8 * byte)) & 0xFF)) * 16777619u;
+        }
+    };
+    for (int payout : tables.paytable) {
+        mix(uint64_t(payout));
+    }
+    mix(tables.wildBits);
+    mix(tables.highPairBits);
+    return hash;
+}
+
+void EvCache::build(const std::string& path, const EvSolver& solver) {
+    std::vector<CanonicalClass> classes = canonicalClasses();
+    std::vector<uint32_t> classOfRank(NUM_HANDS);
+    std::vector<EvCacheEntry> entries(classes.size());
+    std::vector<Hand> representatives;
+    representatives.reserve(classes.size());
+    for (size_t c = 0; c < classes.size(); c++) {
+        entries[c].canonicalRank = classes[c].rank;
+        entries[c].multiplicity = classes[c].multiplicity;
+        representatives.push_back(classes[c].hand);
+    }
+    for (uint32_t rank = 0; rank < uint32_t(NUM_HANDS); rank++) {
+        uint32_t canonicalRank = canonicalize(unrankHand(rank)).rank;
+        // Classes are sorted by representative rank.
+        auto it = std::lower_bound(classes.begin(), classes.end(), canonicalRank,
+            [](const CanonicalClass& c, uint32_t r) { return c.rank < r; });
+        classOfRank[rank] = std::distance(classes.begin(), it);
+    }
+
+    std::vector<HoldValues> values;
+    solver.solve(representatives, values, std::max(1u, std::thread::hardware_concurrency()));
+    for (size_t c = 0; c < entries.size(); c++) {
+        std::copy(values[c].begin(), values[c].end(), entries[c].ev);
+        entries[c].bestExchange = EvSolver::bestExchange(values[c]);
+    }
+
+    EvCacheHeader header {};
+    std::memcpy(header.magic, EV_CACHE_MAGIC, sizeof(header.magic));
+    header.version = EV_CACHE_VERSION;
+    header.numClasses = entries.size();
+    header.numHands = NUM_HANDS;
+    header.rulesHash = rulesHash(solver.getTables());
+    header.classOfRankOffset = sizeof(EvCacheHeader);
+    header.entriesOffset = header.classOfRankOffset + NUM_HANDS * sizeof(uint32_t);
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) throw std::runtime_error("Could not open EV cache for writing: " + path);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(classOfRank.data()), classOfRank.size() * sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(EvCacheEntry));
+    if (!out) throw std::runtime_error("Failed writing EV cache: " + path);
+}
+
+EvCache::EvCache(const std::string& path, const GameTables& tables) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Could not open EV cache: " + path);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(EvCacheHeader)) {
+        close(fd);
+        throw std::runtime_error("Truncated EV cache: " + path);
+    }
+    mMappingSize = st.st_size;
+    mMapping = mmap(nullptr, mMappingSize, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mMapping == MAP_FAILED) {
+        mMapping = nullptr;
+        throw std::runtime_error("Could not map EV cache: " + path);
+    }
+
+    const char* base = static_cast<const char*>(mMapping);
+    mHeader = reinterpret_cast<const EvCacheHeader*>(base);
+    bool valid = std::memcmp(mHeader->magic, EV_CACHE_MAGIC, sizeof(EV_CACHE_MAGIC)) == 0
+              && mHeader->version == EV_CACHE_VERSION
+              && mHeader->numHands == uint32_t(NUM_HANDS)
+              && mHeader->entriesOffset + mHeader->numClasses * sizeof(EvCacheEntry) <= mMappingSize;
+    if (!valid) {
+        munmap(mMapping, mMappingSize);
+        mMapping = nullptr;
+        throw std::runtime_error("Invalid EV cache: " + path);
+    }
+    if (mHeader->rulesHash != rulesHash(tables)) {
+        munmap(mMapping, mMappingSize);
+        mMapping = nullptr;
+        throw std::runtime_error("EV cache was built for different game rules: " + path);
+    }
+    mClassOfRank = reinterpret_cast<const uint32_t*>(base + mHeader->classOfRankOffset);
+    mEntries = reinterpret_cast<const EvCacheEntry*>(base + mHeader->entriesOffset);
+}
+
+EvCache::~EvCache() {
+    if (mMapping != nullptr) {
+        munmap(mMapping, mMappingSize);
+    }
+}
+
+uint32_t EvCache::getNumClasses() const {
+    return mHeader->numClasses;
+}
+
+uint32_t EvCache::classOf(const CanonicalHand& canonical) const {
+    return mClassOfRank[canonical.rank];
+}
+
+const EvCacheEntry& EvCache::getEntry(uint32_t classIndex) const {
+    return mEntries[classIndex];
+}
+
+HoldValues EvCache::holdValues(const Hand& hand) const {
+    CanonicalHand canonical = canonicalize(hand);
+    const EvCacheEntry& entry = mEntries[classOf(canonical)];
+    HoldValues values;
+    for (int exchange = 0; exchange < 32; exchange++) {
+        values[exchange] = entry.ev[canonical.toCanonical(exchange)];
+    }
+    return values;
+}
+
+ExchangeMask EvCache::bestExchange(const Hand& hand) const {
+    CanonicalHand canonical = canonicalize(hand);
+    return canonical.fromCanonical(mEntries[classOf(canonical)].bestExchange);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "poker.h"
+#include "canonical.h"
+#include "ev_solver.h"
+#include "evaluator.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Per suit-isomorphism class record, EVs indexed by exchanges over the canonical card order.
+struct EvCacheEntry {
+    double ev[32];
+    uint32_t canonicalRank;
+    uint32_t multiplicity;    // Number of the 2,598,960 deals in the class.
+    uint8_t bestExchange;
+    uint8_t padding[7];
+};
+static_assert(sizeof(EvCacheEntry) == 272);
+
+struct EvCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t numClasses;
+    uint32_t numHands;
+    uint32_t rulesHash;       // Rejects caches built for different game rules.
+    uint64_t classOfRankOffset;
+    uint64_t entriesOffset;
+};
+
+// Read-only, memory-mapped table of exact hold values for every suit-isomorphism class.
+//
+// The file holds a header, a NUM_HANDS table from handRank to class index, and one EvCacheEntry per
+// class. Opening it only maps the file, so every lookup is a canonicalize() plus two array reads.
+class EvCache : public HoldValueSource {
+public:
+    static void build(const std::string& path, const EvSolver& solver);
+
+    EvCache(const std::string& path, const GameTables& tables);
+    ~EvCache();
+    EvCache(const EvCache&) = delete;
+    EvCache& operator=(const EvCache&) = delete;
+
+    uint32_t getNumClasses() const;
+    uint32_t classOf(const CanonicalHand& canonical) const;
+    const EvCacheEntry& getEntry(uint32_t classIndex) const;
+    // Hold values mapped back onto the positions of hand.
+    HoldValues holdValues(const Hand& hand) const override;
+    ExchangeMask bestExchange(const Hand& hand) const;
+
+private:
+    void* mMapping = nullptr;
+    size_t mMappingSize = 0;
+    const EvCacheHeader* mHeader = nullptr;
+    const uint32_t* mClassOfRank = nullptr;
+    const EvCacheEntry* mEntries = nullptr;
+};
+
+// Hash of everything in tables that changes a hold's value.
+uint32_t rulesHash(const GameTables& tables);
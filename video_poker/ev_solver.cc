@@ -0,0 +1,137 @@
+#include "ev_solver.h"
+
+#include "poker.h"
+#include "evaluator.h"
+#include "canonical.h"
+
+#include <array>
+#include <algorithm>
+#include <bit>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Colex rank of the cards selected by subset from the ascending indices in sorted.
+inline int64_t subsetRank(const std::array<int, 5>& sorted, uint32_t subset) {
+    int64_t rank = 0;
+    int position = 1;
+    for (int i = 0; i < 5; i++) {
+        if ((subset >> i) & 1) {
+            rank += BINOMIAL[sorted[i]][position++];
+        }
+    }
+    return rank;
+}
+
+} // namespace
+
+EvSolver::EvSolver(const GameTables& tables) : mTables(tables) {
+    for (int k = 0; k <= 5; k++) {
+        mPayoutContaining[k].assign(BINOMIAL[52][k], 0);
+    }
+    std::array<int, 5> c;
+    for (c[0] = 0; c[0] < 52; c[0]++)
+    for (c[1] = c[0]+1; c[1] < 52; c[1]++)
+    for (c[2] = c[1]+1; c[2] < 52; c[2]++)
+    for (c[3] = c[2]+1; c[3] < 52; c[3]++)
+    for (c[4] = c[3]+1; c[4] < 52; c[4]++) {
+        uint64_t mask = (1ULL << c[0]) | (1ULL << c[1]) | (1ULL << c[2]) | (1ULL << c[3]) | (1ULL << c[4]);
+        int payout = mTables.paytable[evaluateHand(mask, mTables)];
+        if (payout == 0) continue;
+        for (uint32_t subset = 0; subset < 32; subset++) {
+            mPayoutContaining[std::popcount(subset)][subsetRank(c, subset)] += payout;
+        }
+    }
+}
+
+const GameTables& EvSolver::getTables() const {
+    return mTables;
+}
+
+HoldValues EvSolver::solve(const Hand& hand) const {
+    // Work on the cards in ascending index order, then map the masks back to hand positions.
+    std::array<int, 5> positions {0, 1, 2, 3, 4};
+    std::sort(positions.begin(), positions.end(), [&](int a, int b) { return hand[a].index < hand[b].index; });
+    std::array<int, 5> sorted;
+    for (int i = 0; i < 5; i++) {
+        sorted[i] = hand[positions[i]].index;
+    }
+
+    HoldValues values;
+    for (uint32_t discard = 0; discard < 32; discard++) {
+        uint32_t held = ~discard & 31;
+        int64_t total = 0;
+        // Walk every subset of the discarded cards.
+        uint32_t extra = 0;
+        do {
+            int64_t term = mPayoutContaining[std::popcount(held | extra)][subsetRank(sorted, held | extra)];
+            total += (std::popcount(extra) & 1) ? -term : term;
+            extra = (extra - discard) & discard;
+        } while (extra != 0);
+
+        ExchangeMask exchange = 0;
+        for (int i = 0; i < 5; i++) {
+            exchange |= ((discard >> i) & 1) << positions[i];
+        }
+        values[exchange] = double(total) / BINOMIAL[47][std::popcount(discard)];
+    }
+    return values;
+}
+
+void EvSolver::solve(const std::vector<Hand>& hands, std::vector<HoldValues>& out, int numThreads) const {
+    out.resize(hands.size());
+    numThreads = std::max(1, std::min<int>(numThreads, hands.size()));
+    std::vector<std::thread> threads;
+    size_t chunk = (hands.size() + numThreads - 1) / numThreads;
+    for (int t = 0; t < numThreads; t++) {
+        threads.emplace_back([&, t]() {
+            size_t end = std::min(hands.size(), (t + 1) * chunk);
+            for (size_t i = t * chunk; i < end; i++) {
+                out[i] = solve(hands[i]);
+            }
+        });
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+}
+
+HoldValues EvSolver::solveByEnumeration(const Hand& hand) const {
+    uint64_t dealt = hand.mask();
+    std::vector<int> unseen;
+    for (int c = 0; c < 52; c++) {
+        if (!((dealt >> c) & 1)) unseen.push_back(c);
+    }
+
+    HoldValues values;
+    for (int exchange = 0; exchange < 32; exchange++) {
+        uint64_t held = 0;
+        for (int i = 0; i < 5; i++) {
+            if (!((exchange >> i) & 1)) held |= hand[i].mask();
+        }
+        int draws = std::popcount(uint32_t(exchange));
+        // Odometer over ascending combinations of `draws` unseen cards.
+        std::vector<int> pick(draws);
+        for (int i = 0; i < draws; i++) pick[i] = i;
+        int64_t total = 0;
+        int64_t count = 0;
+        while (true) {
+            uint64_t mask = held;
+            for (int p : pick) mask |= 1ULL << unseen[p];
+            total += mTables.paytable[evaluateHand(mask, mTables)];
+            count++;
+            int i = draws - 1;
+            while (i >= 0 && pick[i] == int(unseen.size()) - draws + i) i--;
+            if (i < 0) break;
+            pick[i]++;
+            for (int j = i + 1; j < draws; j++) pick[j] = pick[j-1] + 1;
+        }
+        values[exchange] = double(total) / count;
+    }
+    return values;
+}
+
+ExchangeMask EvSolver::bestExchange(const HoldValues& values) {
+    return std::distance(values.begin(), std::max_element(values.begin(), values.end()));
+}
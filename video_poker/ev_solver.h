@@ -0,0 +1,44 @@
+#pragma once
+
+#include "poker.h"
+#include "evaluator.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Expected payout of every ExchangeMask, indexed by the mask.
+using HoldValues = std::array<double, 32>;
+
+// Anything that can produce the exact hold values of a hand.
+class HoldValueSource {
+public:
+    virtual ~HoldValueSource() = default;
+    virtual HoldValues holdValues(const Hand& hand) const = 0;
+};
+
+// Exact expected values for all 32 exchange decisions of a dealt hand under a variant's paytable.
+//
+// Construction walks all 2,598,960 hands once and, for every card subset S of up to five cards,
+// accumulates the total payout of the hands that contain S. Keeping the cards H and replacing the
+// cards D then sums over every draw from the 47 unseen cards by inclusion-exclusion over the subsets
+// T of D:
+//     total(H, D) = sum over T of (-1)^|T| * payoutContaining(H + T)
+// and dividing by C(47, |D|) gives the EV. A full solve is 3^5 = 243 table lookups.
+class EvSolver : public HoldValueSource {
+public:
+    explicit EvSolver(const GameTables& tables = getGameTables(DEFAULT_VARIANT));
+    const GameTables& getTables() const;
+    HoldValues solve(const Hand& hand) const;
+    HoldValues holdValues(const Hand& hand) const override { return solve(hand); }
+    // Solves hands[i] into out[i], split across numThreads threads.
+    void solve(const std::vector<Hand>& hands, std::vector<HoldValues>& out, int numThreads) const;
+    // Brute-force enumeration of every draw, the ground truth for tests.
+    HoldValues solveByEnumeration(const Hand& hand) const;
+    static ExchangeMask bestExchange(const HoldValues& values);
+
+private:
+    const GameTables& mTables;
+    // mPayoutContaining[k][rank] for subsets of k cards, ranked in the combinatorial number system.
+    std::array<std::vector<int64_t>, 6> mPayoutContaining;
+};
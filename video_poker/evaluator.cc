@@ -0,0 +1,222 @@
+#include "evaluator.h"
+
+#include "poker.h"
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+constexpr int NUM_RANKS = 13;
+// Lowest bit of every rank nibble.
+constexpr uint64_t RANK_BITS = 0x1111111111111ULL;
+constexpr uint32_t ROYAL_RANKS = 0x1F00;
+constexpr uint32_t WHEEL_RANKS = 0x100F;
+
+// True if the natural ranks can be completed into a straight by the wild cards.
+constexpr bool fitsStraight(uint32_t ranks) {
+    if ((ranks & ~WHEEL_RANKS) == 0) return true;
+    for (int low = 0; low + 5 <= NUM_RANKS; low++) {
+        if ((ranks & ~(0x1Fu << low)) == 0) return true;
+    }
+    return false;
+}
+
+// Lowest bit of every rank nibble from rank up.
+constexpr uint64_t ranksFrom(int rank) {
+    return rank == NO_RANK ? 0 : RANK_BITS & ~((1ULL << (4 * (rank - 2))) - 1);
+}
+
+template <typename Rules>
+constexpr GameTables makeGameTables(GameVariant variant) {
+    GameTables tables {};
+    tables.variant = variant;
+    tables.name = Rules::NAME;
+    tables.wildBits = Rules::WILD_RANK == NO_RANK ? 0 : 0xFULL << (4 * (Rules::WILD_RANK - 2));
+    tables.highPairBits = ranksFrom(Rules::MIN_PAIR_RANK);
+    tables.paytable = Rules::PAYTABLE;
+
+    // Only natural rank masks with five distinct cards between them and the wilds classify as
+    // anything but HIGH_CARD, everything else is left to the multiples table.
+    for (uint32_t wild = 0; wild <= 4; wild++) {
+        for (uint32_t ranks = 0; ranks < (1u << NUM_RANKS); ranks++) {
+            if (uint32_t(std::popcount(ranks)) != 5 - wild) continue;
+            bool straight = fitsStraight(ranks);
+            bool royal = (ranks & ~ROYAL_RANKS) == 0;
+            uint32_t key = (wild << 14) | ranks;
+            tables.fiveRankTable[key] = straight ? STRAIGHT : HIGH_CARD;
+            if (royal) {
+                tables.fiveRankTable[key | (1u << NUM_RANKS)] = wild == 0 ? ROYAL_FLUSH : WILD_ROYAL_FLUSH;
+            } else {
+                tables.fiveRankTable[key | (1u << NUM_RANKS)] = straight ? STRAIGHT_FLUSH : FLUSH;
+            }
+        }
+    }
+
+    for (int wild = 0; wild <= 4; wild++)
+    for (int distinct = 0; distinct <= 5; distinct++)
+    for (int largest = 0; largest <= 4; largest++)
+    for (int highPair = 0; highPair <= 1; highPair++) {
+        int matched = largest + wild;
+        PokerHand hand = HIGH_CARD;
+        if (wild == 4) hand = FOUR_DEUCES;
+        else if (matched >= 5) hand = FIVE_OF_A_KIND;
+        else if (matched == 4) hand = FOUR_OF_A_KIND;
+        else if (matched == 3) hand = distinct == 2 ? FULL_HOUSE : THREE_OF_A_KIND;
+        else if (matched == 2 && wild == 0 && distinct == 3) hand = TWO_PAIR;
+        else if (matched == 2) hand = highPair ? HIGH_PAIR : PAIR;
+        tables.multiplesTable[((wild * 6 + distinct) * 5 + largest) * 2 + highPair] = hand;
+    }
+    return tables;
+}
+
+constexpr GameTables NO_ROYAL_TABLES = makeGameTables<NoRoyalRules>(GameVariant::NO_ROYAL);
+constexpr GameTables JACKS_OR_BETTER_TABLES = makeGameTables<JacksOrBetterRules>(GameVariant::JACKS_OR_BETTER);
+constexpr GameTables DEUCES_WILD_TABLES = makeGameTables<DeucesWildRules>(GameVariant::DEUCES_WILD);
+
+static_assert(DEFAULT_VARIANT == GameVariant::NO_ROYAL);
+constexpr const GameTables& DEFAULT_TABLES = NO_ROYAL_TABLES;
+
+// Collapses the lowest bit of each rank nibble into a contiguous 13-bit rank mask.
+inline uint32_t compressRanks(uint64_t nibbleBits) {
+    uint64_t x = nibbleBits;
+    x = (x | (x >> 3)) & 0x0303030303030303ULL;
+    x = (x | (x >> 6)) & 0x000F000F000F000FULL;
+    x = (x | (x >> 12)) & 0x000000FF000000FFULL;
+    x = (x | (x >> 24)) & 0xFFFFULL;
+    return static_cast<uint32_t>(x);
+}
+
+} // namespace
+
+const GameTables& getGameTables(GameVariant variant) {
+    switch (variant) {
+        case GameVariant::NO_ROYAL: return NO_ROYAL_TABLES;
+        case GameVariant::JACKS_OR_BETTER: return JACKS_OR_BETTER_TABLES;
+        case GameVariant::DEUCES_WILD: return DEUCES_WILD_TABLES;
+    }
+    throw std::invalid_argument("Unknown game variant");
+}
+
+PokerHand evaluateHand(uint64_t mask, const GameTables& tables) {
+    uint32_t wild = std::popcount(mask & tables.wildBits);
+    mask &= ~tables.wildBits;
+
+    // Per-rank card counts, one per nibble.
+    uint64_t counts = mask - ((mask >> 1) & 0x5555555555555555ULL);
+    counts = (counts & 0x3333333333333333ULL) + ((counts >> 2) & 0x3333333333333333ULL);
+    uint64_t present = (counts | (counts >> 1) | (counts >> 2)) & RANK_BITS;
+    uint64_t pairs = ((counts >> 1) | (counts >> 2)) & RANK_BITS;
+    uint64_t trips = ((counts & (counts >> 1)) | (counts >> 2)) & RANK_BITS;
+    uint64_t quads = (counts >> 2) & RANK_BITS;
+    // Any wild card pairs up with any natural rank.
+    uint64_t pairable = pairs | (present & (0 - uint64_t(wild != 0)));
+
+    // Fold every nibble onto the lowest one, a flush leaves a single suit bit set.
+    uint64_t suits = mask | (mask >> 32);
+    suits |= suits >> 16;
+    suits |= suits >> 8;
+    suits |= suits >> 4;
+    suits &= 0xF;
+    uint32_t flush = (suits & (suits - 1)) == 0;
+
+    uint32_t ranks = compressRanks(present);
+    uint32_t distinct = std::popcount(ranks);
+    uint32_t largest = uint32_t(present != 0) + uint32_t(pairs != 0) + uint32_t(trips != 0) + uint32_t(quads != 0);
+    uint32_t multiplesKey = ((wild * 6 + distinct) * 5 + largest) * 2 + uint32_t((pairable & tables.highPairBits) != 0);
+    uint8_t fiveRank = tables.fiveRankTable[(wild << 14) | (flush << NUM_RANKS) | ranks];
+    uint8_t multiples = tables.multiplesTable[multiplesKey];
+    return static_cast<PokerHand>(std::max(fiveRank, multiples));
+}
+
+PokerHand evaluateHand(uint64_t mask) {
+    return evaluateHand(mask, DEFAULT_TABLES);
+}
+
+PokerHand evaluateHand(const Hand& hand) {
+    return evaluateHand(hand.mask(), DEFAULT_TABLES);
+}
+
+void evaluateHands(const std::vector<uint64_t>& masks, std::vector<PokerHand>& out, const GameTables& tables) {
+    out.resize(masks.size());
+    for (size_t i = 0; i < masks.size(); i++) {
+        out[i] = evaluateHand(masks[i], tables);
+    }
+}
+
+void evaluateHands(const std::vector<Hand>& hands, std::vector<PokerHand>& out, const GameTables& tables) {
+    out.resize(hands.size());
+    for (size_t i = 0; i < hands.size(); i++) {
+        out[i] = evaluateHand(hands[i].mask(), tables);
+    }
+}
+
+void evaluateHands(const std::vector<uint64_t>& masks, std::vector<PokerHand>& out) {
+    evaluateHands(masks, out, DEFAULT_TABLES);
+}
+
+void evaluateHands(const std::vector<Hand>& hands, std::vector<PokerHand>& out) {
+    evaluateHands(hands, out, DEFAULT_TABLES);
+}
+
+PokerHand evaluateHandReference(const Hand& hand) {
+
+    bool hasFlush = true;
+    Suit firstSuit = hand[0].suit();
+    std::array<int, 13> counts{};
+    for (int i=0; i < 5; i++) {
+        if (hand[i].suit() != firstSuit) hasFlush = false;
+        counts[hand[i].rank()-2]++;
+    }
+
+    bool hasPair = false;
+    bool hasTwoPair = false;
+    bool hasThree = false;
+    bool hasStraight = false;
+    bool hasFour = false;
+    bool hasHighPair = false;
+    int cardsToStraight = 0;
+    int cardsSeen = 0;
+    for (int i=0; i<13; i++) {
+        int n = counts[i];
+        if (n == 1) {
+            cardsToStraight += 1;
+        } else {
+            cardsToStraight = 0;
+        }
+        if (cardsToStraight == 5) hasStraight = true;
+        if (n == 4) hasFour = true;
+        if (n == 3) hasThree = true;
+        if (n == 2) {
+            if (hasPair) hasTwoPair = true;
+            hasPair = true;
+            if (i >= 9) hasHighPair = true;
+        }
+        cardsSeen += n;
+        if (cardsToStraight == 4 && i == 3 && counts[12] == 1) {
+            // Special case, ace low straight.
+            hasStraight = true;
+            break;
+        }
+    }
+
+    if (hasFlush && hasStraight) {
+        if (counts[8] == 1 && counts[12] == 1) return PokerHand::ROYAL_FLUSH;
+        else return PokerHand::STRAIGHT_FLUSH;
+    }
+    if (hasFlush) return PokerHand::FLUSH;
+    if (hasStraight) return PokerHand::STRAIGHT;
+    if (hasFour) return PokerHand::FOUR_OF_A_KIND;
+    if (hasThree) {
+        if (hasPair) return PokerHand::FULL_HOUSE;
+        else return PokerHand::THREE_OF_A_KIND;
+    }
+    if (hasTwoPair) return PokerHand::TWO_PAIR;
+    if (hasHighPair) return PokerHand::HIGH_PAIR;
+    if (hasPair) return PokerHand::PAIR;
+    return PokerHand::HIGH_CARD;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "poker.h"
+#include "variants.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Table-driven hand classification.
+//
+// A hand is reduced to its 52-bit mask (Hand::mask), which has one nibble per rank. The rank
+// set, the per-rank counts and the flush flag are all derived from the mask with shifts and
+// popcounts, and the PokerHand comes out of two small lookup tables: one for hands of five distinct
+// ranks (straights/flushes) and one for hands with repeated ranks (pairs and up). No branch depends
+// on the cards.
+//
+// Wild cards are split off the mask first and their count w becomes part of both table keys, so a
+// variant's rules live entirely in its tables. Tables are indexed by PokerHand strength, and a hand
+// that matches in both tables scores the larger of the two.
+
+struct GameTables {
+    GameVariant variant;
+    const char* name;
+    uint64_t wildBits;      // The wild rank's nibble, 0 without wild cards.
+    uint64_t highPairBits;  // Lowest bit of the nibble of every rank that makes a HIGH_PAIR.
+    Paytable paytable;
+    // Indexed by (wildCount << 14) | (flush << 13) | rankMask of the natural cards.
+    std::array<uint8_t, 5 << 14> fiveRankTable;
+    // Indexed by ((wildCount * 6 + distinctRanks) * 5 + largestCount) * 2 + hasHighPair.
+    std::array<uint8_t, 5 * 6 * 5 * 2> multiplesTable;
+};
+
+// Tables for each variant are built at compile time, this only picks one.
+const GameTables& getGameTables(GameVariant variant);
+
+PokerHand evaluateHand(uint64_t mask, const GameTables& tables);
+// Under DEFAULT_VARIANT.
+PokerHand evaluateHand(uint64_t mask);
+PokerHand evaluateHand(const Hand& hand);
+
+// Batch overloads, out is resized to match the input.
+void evaluateHands(const std::vector<uint64_t>& masks, std::vector<PokerHand>& out, const GameTables& tables);
+void evaluateHands(const std::vector<Hand>& hands, std::vector<PokerHand>& out, const GameTables& tables);
+void evaluateHands(const std::vector<uint64_t>& masks, std::vector<PokerHand>& out);
+void evaluateHands(const std::vector<Hand>& hands, std::vector<PokerHand>& out);
+
+// The original counting-loop evaluator, without wild cards. Kept as the ground truth for tests and
+// benchmarks.
+PokerHand evaluateHandReference(const Hand& hand);
@@ -1,8 +1,11 @@
 #pragma once
 
 #include "neural.h"
+#include "static_net.h"
 #include "baseline.h"
 #include "optimizer.h"
+#include "poker.h"
+#include "evaluator.h"
 
 #include <string>
 #include <vector>
@@ -12,6 +15,7 @@ constexpr int INPUT_SIZE = 85;
 
 struct HyperParameters {
     std::string name;
+    GameVariant variant = DEFAULT_VARIANT;
 
     std::vector<LayerSpecification> actorTopology;
     float actorLearningRate;
@@ -29,6 +33,10 @@ struct HyperParameters {
 
     int numWorkers;
     int numInBatch;
+    // Independent draws per dealt hand and decision. The averaged payout is the reward.
+    int numPlays = 1;
+    // Per-stratum oversampling factors for StratifiedDealer, empty for ordinary dealing.
+    std::vector<double> dealBoosts;
     int getBatchSize() const {
         return numWorkers * numInBatch;
     }
@@ -40,6 +48,7 @@ inline std::vector<LayerSpecification> SOFTMAX_TOPOLOGY {
     {170, Activation::RELU},
     {32, Activation::SOFTMAX},
 };
+using SoftmaxNet = StaticNet<Input<INPUT_SIZE>, Dense<170, Relu>, Dense<170, Relu>, Dense<32, Softmax>>;
 
 inline std::vector<LayerSpecification> SIGMOID_TOPOLOGY {
     {INPUT_SIZE, Activation::LINEAR},
@@ -47,12 +56,14 @@ inline std::vector<LayerSpecification> SIGMOID_TOPOLOGY {
     {170, Activation::RELU},
     {5, Activation::SIGMOID},
 };
+using SigmoidNet = StaticNet<Input<INPUT_SIZE>, Dense<170, Relu>, Dense<170, Relu>, Dense<5, Sigmoid>>;
 
 inline std::vector<LayerSpecification> CRITIC_NETWORK_TOPOLOGY {
     {INPUT_SIZE, Activation::LINEAR},
     {85, Activation::RELU},
     {1, Activation::LINEAR},
 };
+using CriticNet = StaticNet<Input<INPUT_SIZE>, Dense<85, Relu>, Dense<1, Linear>>;
 
 
 const HyperParameters NoEntropy {
@@ -125,18 +136,84 @@ const HyperParameters VeryHighEntropy {
     .numInBatch = 4,
 };
 
+const HyperParameters JacksOrBetter {
+    .name = "JacksOrBetter",
+    .variant = GameVariant::JACKS_OR_BETTER,
+    .actorTopology = SOFTMAX_TOPOLOGY,
+    .actorLearningRate = 0.0005f,
+    .baselineCalculatorType = CRITIC_NETWORK,
+    .criticTopology = CRITIC_NETWORK_TOPOLOGY,
+    .criticLearningRate = 0.015f,
+    .optimizerType = MOMENTUM,
+    .momentumCoeff = 0.95f,
+    .entropyCoeff = 0.004f,
+    .numWorkers = 8,
+    .numInBatch = 4,
+};
+
+const HyperParameters DeucesWild {
+    .name = "DeucesWild",
+    .variant = GameVariant::DEUCES_WILD,
+    .actorTopology = SOFTMAX_TOPOLOGY,
+    .actorLearningRate = 0.0005f,
+    .baselineCalculatorType = CRITIC_NETWORK,
+    .criticTopology = CRITIC_NETWORK_TOPOLOGY,
+    .criticLearningRate = 0.015f,
+    .optimizerType = MOMENTUM,
+    .momentumCoeff = 0.95f,
+    .entropyCoeff = 0.004f,
+    .numWorkers = 8,
+    .numInBatch = 4,
+};
+
+const HyperParameters TenPlay {
+    .name = "TenPlay",
+    .actorTopology = SOFTMAX_TOPOLOGY,
+    .actorLearningRate = 0.0005f,
+    .baselineCalculatorType = CRITIC_NETWORK,
+    .criticTopology = CRITIC_NETWORK_TOPOLOGY,
+    .criticLearningRate = 0.015f,
+    .optimizerType = MOMENTUM,
+    .momentumCoeff = 0.95f,
+    .entropyCoeff = 0.0f,
+    .numWorkers = 8,
+    .numInBatch = 4,
+    .numPlays = 10,
+};
+
+const HyperParameters RoyalBoost {
+    .name = "RoyalBoost",
+    .actorTopology = SOFTMAX_TOPOLOGY,
+    .actorLearningRate = 0.0005f,
+    .baselineCalculatorType = CRITIC_NETWORK,
+    .criticTopology = CRITIC_NETWORK_TOPOLOGY,
+    .criticLearningRate = 0.015f,
+    .optimizerType = MOMENTUM,
+    .momentumCoeff = 0.95f,
+    .entropyCoeff = 0.0f,
+    .numWorkers = 8,
+    .numInBatch = 4,
+    .dealBoosts = {1.0, 1.0, 1.0, 4.0, 50.0, 1000.0},
+};
+
 inline std::vector<HyperParameters> AvailableConfigs {
     NoEntropy,
     LowEntropy,
     MedEntropy,
     HighEntropy,
     VeryHighEntropy,
+    JacksOrBetter,
+    DeucesWild,
+    TenPlay,
+    RoyalBoost,
 };
 
 
 inline std::ostream& operator<<(std::ostream& os, const HyperParameters& h) {
     os << h.name << std::endl;
 
+    os << "Variant:," << getGameTables(h.variant).name << std::endl;
+
     os << "Actor Topology:," << h.actorTopology << std::endl;
     os << "Actor Learning Rate:," << h.actorLearningRate << std::endl;
     os << "Optimizer Type:,";
@@ -177,5 +254,13 @@ inline std::ostream& operator<<(std::ostream& os, const HyperParameters& h) {
     }
     os << std::endl;
     os << "Workers:," << h.numWorkers << ", Batch Size:," << h.getBatchSize() << std::endl;
+    os << "Plays per Deal:," << h.numPlays << std::endl;
+    if (!h.dealBoosts.empty()) {
+        os << "Deal Boosts:,";
+        for (double boost : h.dealBoosts) {
+            os << boost << ",";
+        }
+        os << std::endl;
+    }
     return os;
 }
\ No newline at end of file
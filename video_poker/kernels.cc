@@ -0,0 +1,655 @@
+#include "kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+// Portable loops, the reference for the vector sets.
+
+void scalarForward(const float* inputs, int count, const float* weights, const float* biases,
+                   int numInputs, int numNeurons, Epilogue epilogue, float* outputs) {
+    for (int r = 0; r < count; r++) {
+        for (int n = 0; n < numNeurons; n++) {
+            float sum = biases[n];
+            for (int i = 0; i < numInputs; i++) {
+                sum += inputs[r * numInputs + i] * weights[n * numInputs + i];
+            }
+            outputs[r * numNeurons + n] = epilogue == Epilogue::RELU && sum < 0.0f ? 0.0f : sum;
+        }
+    }
+}
+
+void scalarWeightGradient(const float* deltas, const float* inputs, int count,
+                          int numInputs, int numNeurons, float* weightGradient) {
+    for (int r = 0; r < count; r++) {
+        for (int n = 0; n < numNeurons; n++) {
+            for (int i = 0; i < numInputs; i++) {
+                weightGradient[n * numInputs + i] += deltas[r * numNeurons + n] * inputs[r * numInputs + i];
+            }
+        }
+    }
+}
+
+void scalarWeightGradientLive(const float* deltas, const float* inputs, int count, int numInputs, int numNeurons,
+                              const int* live, int numLive, float* weightGradient) {
+    for (int r = 0; r < count; r++) {
+        for (int k = 0; k < numLive; k++) {
+            int n = live[k];
+            for (int i = 0; i < numInputs; i++) {
+                weightGradient[n * numInputs + i] += deltas[r * numNeurons + n] * inputs[r * numInputs + i];
+            }
+        }
+    }
+}
+
+void scalarDownstream(const float* weights, const float* deltas, int count,
+                      int numInputs, int numNeurons, float* downstream) {
+    for (int r = 0; r < count; r++) {
+        for (int i = 0; i < numInputs; i++) {
+            float sum = 0.0f;
+            for (int n = 0; n < numNeurons; n++) {
+                sum += weights[n * numInputs + i] * deltas[r * numNeurons + n];
+            }
+            downstream[r * numInputs + i] = sum;
+        }
+    }
+}
+
+void scalarDownstreamLive(const float* weights, const float* deltas, int count, int numInputs, int numNeurons,
+                          const int* live, int numLive, float* downstream) {
+    for (int r = 0; r < count; r++) {
+        for (int i = 0; i < numInputs; i++) {
+            float sum = 0.0f;
+            for (int k = 0; k < numLive; k++) {
+                sum += weights[live[k] * numInputs + i] * deltas[r * numNeurons + live[k]];
+            }
+            downstream[r * numInputs + i] = sum;
+        }
+    }
+}
+
+void scalarDownstreamRange(const float* weights, const float* deltas, int count, int numInputs, int numNeurons,
+                           const int* live, int numLive, int begin, int end, float* downstream) {
+    for (int r = 0; r < count; r++) {
+        for (int i = begin; i < end; i++) {
+            float sum = 0.0f;
+            for (int k = 0; k < numLive; k++) {
+                int n = live != nullptr ? live[k] : k;
+                sum += weights[n * numInputs + i] * deltas[r * numNeurons + n];
+            }
+            downstream[r * numInputs + i] = sum;
+        }
+    }
+}
+
+void scalarAxpy(float alpha, const float* x, float* y, int size) {
+    for (int i = 0; i < size; i++) {
+        y[i] += alpha * x[i];
+    }
+}
+
+void scalarScaleAdd(float beta, const float* x, float* y, int size) {
+    for (int i = 0; i < size; i++) {
+        y[i] = beta * y[i] + x[i];
+    }
+}
+
+void scalarExp(const float* x, int size, float* out) {
+    for (int i = 0; i < size; i++) {
+        out[i] = std::exp(x[i]);
+    }
+}
+
+void scalarLog(const float* x, int size, float* out) {
+    for (int i = 0; i < size; i++) {
+        out[i] = std::log(x[i]);
+    }
+}
+
+void scalarSigmoid(const float* logits, int size, float* out) {
+    for (int i = 0; i < size; i++) {
+        out[i] = 1.0f / (1.0f + std::exp(-logits[i]));
+    }
+}
+
+void scalarSoftmax(const float* logits, int count, int numNeurons, float* probabilities, float* logProbabilities) {
+    for (int r = 0; r < count; r++) {
+        const float* x = logits + r * numNeurons;
+        float* p = probabilities + r * numNeurons;
+        float max = *std::max_element(x, x + numNeurons);
+        float sum = 0.0f;
+        for (int n = 0; n < numNeurons; n++) {
+            p[n] = std::exp(x[n] - max);
+            sum += p[n];
+        }
+        for (int n = 0; n < numNeurons; n++) {
+            p[n] /= sum;
+        }
+        if (logProbabilities != nullptr) {
+            float logSum = std::log(sum);
+            for (int n = 0; n < numNeurons; n++) {
+                logProbabilities[r * numNeurons + n] = x[n] - max - logSum;
+            }
+        }
+    }
+}
+
+const NeuralKernels SCALAR_KERNELS {
+    "scalar", scalarForward, scalarWeightGradient, scalarDownstream, scalarWeightGradientLive, scalarDownstreamLive,
+    scalarDownstreamRange, scalarAxpy, scalarScaleAdd, scalarExp, scalarLog, scalarSigmoid, scalarSoftmax,
+};
+
+// Vector kernels, written once against the GCC/Clang vector extensions. They are force-inlined into
+// one entry point per instruction set below, so each copy is compiled for that entry point's target.
+
+#define KERNEL_INLINE __attribute__((always_inline)) inline
+// Tile loops must be unrolled for their accumulators to live in registers, which -O2 alone does not do.
+#define UNROLL_TILE _Pragma("GCC unroll 16")
+
+typedef float Float4 __attribute__((vector_size(16)));
+typedef float Float8 __attribute__((vector_size(32)));
+typedef float Float16 __attribute__((vector_size(64)));
+typedef int32_t Int4 __attribute__((vector_size(16)));
+typedef int32_t Int8 __attribute__((vector_size(32)));
+typedef int32_t Int16 __attribute__((vector_size(64)));
+
+// The integer vector with the lanes of Vec, for bit manipulation and lane masks.
+template <typename Vec>
+struct IntVector;
+template <>
+struct IntVector<Float4> { typedef Int4 type; };
+template <>
+struct IntVector<Float8> { typedef Int8 type; };
+template <>
+struct IntVector<Float16> { typedef Int16 type; };
+template <typename Vec>
+using IntOf = typename IntVector<Vec>::type;
+
+template <typename Vec>
+constexpr int LANES = sizeof(Vec) / sizeof(float);
+
+// Partial loads zero the missing lanes, partial stores leave memory past size untouched. They go
+// through a lane buffer so the vector itself never has its address taken and stays in a register.
+template <typename Vec>
+KERNEL_INLINE void load(Vec& v, const float* p, int size = LANES<Vec>) {
+    if (size == LANES<Vec>) {
+        std::memcpy(&v, p, sizeof(Vec));
+    } else {
+        float lanes[LANES<Vec>] = {};
+        std::memcpy(lanes, p, size * sizeof(float));
+        std::memcpy(&v, lanes, sizeof(Vec));
+    }
+}
+
+template <typename Vec>
+KERNEL_INLINE void store(float* p, const Vec& v, int size = LANES<Vec>) {
+    if (size == LANES<Vec>) {
+        std::memcpy(p, &v, sizeof(Vec));
+    } else {
+        float lanes[LANES<Vec>];
+        std::memcpy(lanes, &v, sizeof(Vec));
+        std::memcpy(p, lanes, size * sizeof(float));
+    }
+}
+
+// Pairwise reductions, halving the width at each step.
+KERNEL_INLINE float horizontalSum(const Float4& v) {
+    Float4 pairs = v + __builtin_shufflevector(v, v, 2, 3, 0, 1);
+    return pairs[0] + pairs[1];
+}
+
+KERNEL_INLINE float horizontalSum(const Float8& v) {
+    return horizontalSum(Float4 {__builtin_shufflevector(v, v, 0, 1, 2, 3)} + __builtin_shufflevector(v, v, 4, 5, 6, 7));
+}
+
+KERNEL_INLINE float horizontalSum(const Float16& v) {
+    return horizontalSum(Float8 {__builtin_shufflevector(v, v, 0, 1, 2, 3, 4, 5, 6, 7)}
+                         + __builtin_shufflevector(v, v, 8, 9, 10, 11, 12, 13, 14, 15));
+}
+
+// ROWS samples against NEURONS neurons, one vector of partial dot products per pair. Every weight
+// chunk is loaded once per tile rather than once per sample.
+template <typename Vec, bool RELU, int ROWS, int NEURONS>
+KERNEL_INLINE void forwardTile(const float* inputs, const float* weights, const float* biases,
+                               int numInputs, int numNeurons, float* outputs) {
+    Vec sums[ROWS][NEURONS] = {};
+    for (int i = 0; i < numInputs; i += LANES<Vec>) {
+        int size = numInputs - i < LANES<Vec> ? numInputs - i : LANES<Vec>;
+        Vec w[NEURONS];
+        UNROLL_TILE
+        for (int n = 0; n < NEURONS; n++) {
+            load(w[n], weights + n * numInputs + i, size);
+        }
+        UNROLL_TILE
+        for (int r = 0; r < ROWS; r++) {
+            Vec x;
+            load(x, inputs + r * numInputs + i, size);
+            UNROLL_TILE
+            for (int n = 0; n < NEURONS; n++) {
+                sums[r][n] += x * w[n];
+            }
+        }
+    }
+    UNROLL_TILE
+    for (int r = 0; r < ROWS; r++) {
+        UNROLL_TILE
+        for (int n = 0; n < NEURONS; n++) {
+            float sum = biases[n] + horizontalSum(sums[r][n]);
+            outputs[r * numNeurons + n] = RELU && sum < 0.0f ? 0.0f : sum;
+        }
+    }
+}
+
+template <typename Vec, bool RELU, int ROWS, int NEURONS>
+KERNEL_INLINE void forwardRows(const float* inputs, const float* weights, const float* biases,
+                               int numInputs, int numNeurons, float* outputs) {
+    int n = 0;
+    for (; n + NEURONS <= numNeurons; n += NEURONS) {
+        forwardTile<Vec, RELU, ROWS, NEURONS>(inputs, weights + n * numInputs, biases + n, numInputs, numNeurons, outputs + n);
+    }
+    for (; n < numNeurons; n++) {
+        forwardTile<Vec, RELU, ROWS, 1>(inputs, weights + n * numInputs, biases + n, numInputs, numNeurons, outputs + n);
+    }
+}
+
+template <typename Vec, bool RELU>
+KERNEL_INLINE void forwardBatch(const float* inputs, int count, const float* weights, const float* biases,
+                                int numInputs, int numNeurons, float* outputs) {
+    int r = 0;
+    for (; r + 4 <= count; r += 4) {
+        forwardRows<Vec, RELU, 4, 2>(inputs + r * numInputs, weights, biases, numInputs, numNeurons, outputs + r * numNeurons);
+    }
+    for (; r < count; r++) {
+        forwardRows<Vec, RELU, 1, 8>(inputs + r * numInputs, weights, biases, numInputs, numNeurons, outputs + r * numNeurons);
+    }
+}
+
+template <typename Vec>
+KERNEL_INLINE void forwardKernel(const float* inputs, int count, const float* weights, const float* biases,
+                                 int numInputs, int numNeurons, Epilogue epilogue, float* outputs) {
+    if (epilogue == Epilogue::RELU) {
+        forwardBatch<Vec, true>(inputs, count, weights, biases, numInputs, numNeurons, outputs);
+    } else {
+        forwardBatch<Vec, false>(inputs, count, weights, biases, numInputs, numNeurons, outputs);
+    }
+}
+
+// Rank-1 updates of the NEURONS gradient rows listed in neurons. Each gradient chunk stays in registers
+// for the whole batch.
+template <typename Vec, int NEURONS>
+KERNEL_INLINE void weightGradientTile(const float* deltas, const float* inputs, int count,
+                                      int numInputs, int numNeurons, const int* neurons, float* weightGradient) {
+    for (int i = 0; i < numInputs; i += LANES<Vec>) {
+        int size = numInputs - i < LANES<Vec> ? numInputs - i : LANES<Vec>;
+        Vec sums[NEURONS];
+        UNROLL_TILE
+        for (int n = 0; n < NEURONS; n++) {
+            load(sums[n], weightGradient + neurons[n] * numInputs + i, size);
+        }
+        for (int r = 0; r < count; r++) {
+            Vec x;
+            load(x, inputs + r * numInputs + i, size);
+            UNROLL_TILE
+            for (int n = 0; n < NEURONS; n++) {
+                sums[n] += deltas[r * numNeurons + neurons[n]] * x;
+            }
+        }
+        UNROLL_TILE
+        for (int n = 0; n < NEURONS; n++) {
+            store(weightGradient + neurons[n] * numInputs + i, sums[n], size);
+        }
+    }
+}
+
+// Neurons live[0, numLive), or all numNeurons when live is null.
+template <typename Vec>
+KERNEL_INLINE void weightGradientKernel(const float* deltas, const float* inputs, int count, int numInputs,
+                                        int numNeurons, const int* live, int numLive, float* weightGradient) {
+    int k = 0;
+    for (; k + 4 <= numLive; k += 4) {
+        int neurons[4];
+        UNROLL_TILE
+        for (int j = 0; j < 4; j++) {
+            neurons[j] = live != nullptr ? live[k + j] : k + j;
+        }
+        weightGradientTile<Vec, 4>(deltas, inputs, count, numInputs, numNeurons, neurons, weightGradient);
+    }
+    for (; k < numLive; k++) {
+        int neuron = live != nullptr ? live[k] : k;
+        weightGradientTile<Vec, 1>(deltas, inputs, count, numInputs, numNeurons, &neuron, weightGradient);
+    }
+}
+
+// Vectors of inputs handled per tile. Each step down the weight column then reads several cache lines
+// of a row instead of a single vector, which on 1024-wide layers is the difference between a strided
+// walk the prefetcher loses and short sequential runs.
+constexpr int DOWNSTREAM_CHUNKS = 4;
+
+// Transposed product for ROWS samples over CHUNKS vectors of inputs: weight rows are streamed once
+// per tile and scaled by each sample's delta, so no weight column is ever gathered.
+template <typename Vec, int ROWS, int CHUNKS>
+KERNEL_INLINE void downstreamTile(const float* weights, const float* deltas, int size, int numInputs,
+                                  int numNeurons, const int* live, int numLive, float* downstream) {
+    Vec sums[ROWS][CHUNKS] = {};
+    for (int k = 0; k < numLive; k++) {
+        int n = live != nullptr ? live[k] : k;
+        Vec w[CHUNKS];
+        UNROLL_TILE
+        for (int c = 0; c < CHUNKS; c++) {
+            load(w[c], weights + n * numInputs + c * LANES<Vec>, size);
+        }
+        UNROLL_TILE
+        for (int r = 0; r < ROWS; r++) {
+            float d = deltas[r * numNeurons + n];
+            UNROLL_TILE
+            for (int c = 0; c < CHUNKS; c++) {
+                sums[r][c] += w[c] * d;
+            }
+        }
+    }
+    UNROLL_TILE
+    for (int r = 0; r < ROWS; r++) {
+        UNROLL_TILE
+        for (int c = 0; c < CHUNKS; c++) {
+            store(downstream + r * numInputs + c * LANES<Vec>, sums[r][c], size);
+        }
+    }
+}
+
+// Inputs [begin, end) of ROWS samples. Each input's sum runs over the neurons in the same order
+// whatever tile it lands in, so any split of the inputs gives the bits of the whole product.
+template <typename Vec, int ROWS, int CHUNKS>
+KERNEL_INLINE void downstreamRows(const float* weights, const float* deltas, int numInputs, int numNeurons,
+                                  const int* live, int numLive, int begin, int end, float* downstream) {
+    int i = begin;
+    for (; i + CHUNKS * LANES<Vec> <= end; i += CHUNKS * LANES<Vec>) {
+        downstreamTile<Vec, ROWS, CHUNKS>(weights + i, deltas, LANES<Vec>, numInputs, numNeurons, live, numLive, downstream + i);
+    }
+    for (; i < end; i += LANES<Vec>) {
+        int size = end - i < LANES<Vec> ? end - i : LANES<Vec>;
+        downstreamTile<Vec, ROWS, 1>(weights + i, deltas, size, numInputs, numNeurons, live, numLive, downstream + i);
+    }
+}
+
+// Sums over neurons live[0, numLive), or all numNeurons when live is null.
+template <typename Vec>
+KERNEL_INLINE void downstreamKernel(const float* weights, const float* deltas, int count, int numInputs,
+                                    int numNeurons, const int* live, int numLive, int begin, int end,
+                                    float* downstream) {
+    int r = 0;
+    for (; r + 4 <= count; r += 4) {
+        downstreamRows<Vec, 4, DOWNSTREAM_CHUNKS>(weights, deltas + r * numNeurons, numInputs, numNeurons,
+                                                  live, numLive, begin, end, downstream + r * numInputs);
+    }
+    for (; r < count; r++) {
+        downstreamRows<Vec, 1, DOWNSTREAM_CHUNKS>(weights, deltas + r * numNeurons, numInputs, numNeurons,
+                                                  live, numLive, begin, end, downstream + r * numInputs);
+    }
+}
+
+template <typename Vec>
+KERNEL_INLINE void axpyKernel(float alpha, const float* x, float* y, int size) {
+    for (int i = 0; i < size; i += LANES<Vec>) {
+        int chunk = size - i < LANES<Vec> ? size - i : LANES<Vec>;
+        Vec vx, vy;
+        load(vx, x + i, chunk);
+        load(vy, y + i, chunk);
+        vy += alpha * vx;
+        store(y + i, vy, chunk);
+    }
+}
+
+template <typename Vec>
+KERNEL_INLINE void scaleAddKernel(float beta, const float* x, float* y, int size) {
+    for (int i = 0; i < size; i += LANES<Vec>) {
+        int chunk = size - i < LANES<Vec> ? size - i : LANES<Vec>;
+        Vec vx, vy;
+        load(vx, x + i, chunk);
+        load(vy, y + i, chunk);
+        vy = beta * vy + vx;
+        store(y + i, vy, chunk);
+    }
+}
+
+// Cephes-style exp: x = n ln2 + r with |r| <= ln2 / 2, a degree 6 polynomial for exp(r) and n added to
+// the exponent bits. n comes from the round-to-nearest of adding 1.5 * 2^23, and ln2 is split in two
+// so n ln2 is exact to float precision. Clamping keeps 2^n a normal float and lets NaN through.
+// Vectors go in and out by reference, like load and store, as passing them by value changes the ABI.
+template <typename Vec>
+KERNEL_INLINE void fastExp(const Vec& in, Vec& out) {
+    const float ROUND = 12582912.0f;
+    Vec x = in < FAST_EXP_MIN ? Vec {} + FAST_EXP_MIN : in;
+    x = x > FAST_EXP_MAX ? Vec {} + FAST_EXP_MAX : x;
+    Vec shifted = x * 1.44269504f + ROUND;
+    Vec n = shifted - ROUND;
+    Vec r = x - n * 0.693359375f;
+    r = r - n * -2.12194440e-4f;
+    Vec p = 1.9875691500e-4f * r + 1.3981999507e-3f;
+    p = p * r + 8.3334519073e-3f;
+    p = p * r + 4.1665795894e-2f;
+    p = p * r + 1.6666665459e-1f;
+    p = p * r + 5.0000001201e-1f;
+    p = p * (r * r) + r + 1.0f;
+    IntOf<Vec> exponent = (__builtin_bit_cast(IntOf<Vec>, shifted) - __builtin_bit_cast(int32_t, ROUND) + 127) << 23;
+    out = p * __builtin_bit_cast(Vec, exponent);
+}
+
+// Cephes-style log: x = m 2^e with m in [sqrt(1/2), sqrt(2)), a degree 9 polynomial for log(m) and e
+// ln2 added back in two parts. The special values are patched in at the end.
+template <typename Vec>
+KERNEL_INLINE void fastLog(const Vec& x, Vec& out) {
+    typedef IntOf<Vec> Int;
+    Int bits = __builtin_bit_cast(Int, x);
+    Int e = (bits >> 23) - 126;
+    Vec m = __builtin_bit_cast(Vec, (bits & 0x007fffff) | 0x3f000000); // [0.5, 1)
+    // Selects on the comparison itself, as turning it into an integer vector does not vectorize on
+    // AVX-512F.
+    e = m < 0.707106781f ? e - 1 : e;
+    m = (m < 0.707106781f ? m + m : m) - 1.0f;
+    Vec ef = __builtin_convertvector(e, Vec);
+    Vec z = m * m;
+    Vec p = 7.0376836292e-2f * m - 1.1514610310e-1f;
+    p = p * m + 1.1676998740e-1f;
+    p = p * m - 1.2420140846e-1f;
+    p = p * m + 1.4249322787e-1f;
+    p = p * m - 1.6668057665e-1f;
+    p = p * m + 2.0000714765e-1f;
+    p = p * m - 2.4999993993e-1f;
+    p = p * m + 3.3333331174e-1f;
+    Vec y = p * m * z + ef * -2.12194440e-4f - 0.5f * z;
+    Vec result = m + y + ef * 0.693359375f;
+    result = x == 0.0f ? Vec {} - INFINITY : result;
+    result = x == INFINITY ? Vec {} + INFINITY : result;
+    result = x < 0.0f ? Vec {} + NAN : result;
+    out = x != x ? x : result;
+}
+
+template <typename Vec>
+KERNEL_INLINE void expKernel(const float* x, int size, float* out) {
+    for (int i = 0; i < size; i += LANES<Vec>) {
+        int chunk = size - i < LANES<Vec> ? size - i : LANES<Vec>;
+        Vec v;
+        load(v, x + i, chunk);
+        fastExp(v, v);
+        store(out + i, v, chunk);
+    }
+}
+
+template <typename Vec>
+KERNEL_INLINE void logKernel(const float* x, int size, float* out) {
+    for (int i = 0; i < size; i += LANES<Vec>) {
+        int chunk = size - i < LANES<Vec> ? size - i : LANES<Vec>;
+        Vec v;
+        load(v, x + i, chunk);
+        fastLog(v, v);
+        store(out + i, v, chunk);
+    }
+}
+
+template <typename Vec>
+KERNEL_INLINE void sigmoidKernel(const float* logits, int size, float* out) {
+    for (int i = 0; i < size; i += LANES<Vec>) {
+        int chunk = size - i < LANES<Vec> ? size - i : LANES<Vec>;
+        Vec v;
+        load(v, logits + i, chunk);
+        v = -v;
+        fastExp(v, v);
+        store(out + i, 1.0f / (1.0f + v), chunk);
+    }
+}
+
+// Lanes 0, 1, 2, ... for masking the tail of a row.
+template <typename Vec>
+KERNEL_INLINE void laneIndices(IntOf<Vec>& lanes) {
+    for (int k = 0; k < LANES<Vec>; k++) {
+        lanes[k] = k;
+    }
+}
+
+// Three passes over each row: its max, the shifted exponentials and their sum, then the division and
+// the log-probabilities. Tail lanes are masked so they add nothing to the max or the sum.
+template <typename Vec>
+KERNEL_INLINE void softmaxKernel(const float* logits, int count, int numNeurons,
+                                 float* probabilities, float* logProbabilities) {
+    IntOf<Vec> lanes;
+    laneIndices<Vec>(lanes);
+    for (int r = 0; r < count; r++) {
+        const float* x = logits + r * numNeurons;
+        float* p = probabilities + r * numNeurons;
+        Vec maxes = Vec {} - INFINITY;
+        for (int i = 0; i < numNeurons; i += LANES<Vec>) {
+            int chunk = numNeurons - i < LANES<Vec> ? numNeurons - i : LANES<Vec>;
+            Vec v;
+            load(v, x + i, chunk);
+            v = lanes < chunk ? v : maxes;
+            maxes = v > maxes ? v : maxes;
+        }
+        float max = maxes[0];
+        for (int k = 1; k < LANES<Vec>; k++) {
+            max = std::max(max, float(maxes[k]));
+        }
+        Vec sums {};
+        for (int i = 0; i < numNeurons; i += LANES<Vec>) {
+            int chunk = numNeurons - i < LANES<Vec> ? numNeurons - i : LANES<Vec>;
+            Vec v;
+            load(v, x + i, chunk);
+            Vec e = v - max;
+            fastExp(e, e);
+            e = lanes < chunk ? e : Vec {};
+            store(p + i, e, chunk);
+            sums += e;
+        }
+        float sum = horizontalSum(sums);
+        Vec logSums = Vec {} + sum;
+        fastLog(logSums, logSums);
+        float logSum = logSums[0];
+        for (int i = 0; i < numNeurons; i += LANES<Vec>) {
+            int chunk = numNeurons - i < LANES<Vec> ? numNeurons - i : LANES<Vec>;
+            Vec e;
+            load(e, p + i, chunk);
+            store(p + i, e / sum, chunk);
+            if (logProbabilities != nullptr) {
+                Vec v;
+                load(v, x + i, chunk);
+                store(logProbabilities + r * numNeurons + i, v - max - logSum, chunk);
+            }
+        }
+    }
+}
+
+// One entry point per kernel, compiled for TARGET, plus the table that collects them.
+#define DEFINE_VECTOR_KERNELS(NAME, TARGET, VEC)                                                          \
+    TARGET void NAME##Forward(const float* inputs, int count, const float* weights, const float* biases, \
+                              int numInputs, int numNeurons, Epilogue epilogue, float* outputs) {        \
+        forwardKernel<VEC>(inputs, count, weights, biases, numInputs, numNeurons, epilogue, outputs);    \
+    }                                                                                                    \
+    TARGET void NAME##WeightGradient(const float* deltas, const float* inputs, int count,               \
+                                     int numInputs, int numNeurons, float* weightGradient) {             \
+        weightGradientKernel<VEC>(deltas, inputs, count, numInputs, numNeurons, nullptr, numNeurons,    \
+                                  weightGradient);                                                       \
+    }                                                                                                    \
+    TARGET void NAME##Downstream(const float* weights, const float* deltas, int count,                  \
+                                 int numInputs, int numNeurons, float* downstream) {                     \
+        downstreamKernel<VEC>(weights, deltas, count, numInputs, numNeurons, nullptr, numNeurons,        \
+                              0, numInputs, downstream);                                                 \
+    }                                                                                                    \
+    TARGET void NAME##WeightGradientLive(const float* deltas, const float* inputs, int count,           \
+                                         int numInputs, int numNeurons, const int* live, int numLive,   \
+                                         float* weightGradient) {                                        \
+        weightGradientKernel<VEC>(deltas, inputs, count, numInputs, numNeurons, live, numLive,          \
+                                  weightGradient);                                                       \
+    }                                                                                                    \
+    TARGET void NAME##DownstreamLive(const float* weights, const float* deltas, int count,              \
+                                     int numInputs, int numNeurons, const int* live, int numLive,       \
+                                     float* downstream) {                                                \
+        downstreamKernel<VEC>(weights, deltas, count, numInputs, numNeurons, live, numLive,             \
+                              0, numInputs, downstream);                                                 \
+    }                                                                                                    \
+    TARGET void NAME##DownstreamRange(const float* weights, const float* deltas, int count,             \
+                                      int numInputs, int numNeurons, const int* live, int numLive,      \
+                                      int begin, int end, float* downstream) {                           \
+        downstreamKernel<VEC>(weights, deltas, count, numInputs, numNeurons, live, numLive,             \
+                              begin, end, downstream);                                                   \
+    }                                                                                                    \
+    TARGET void NAME##Axpy(float alpha, const float* x, float* y, int size) {                           \
+        axpyKernel<VEC>(alpha, x, y, size);                                                              \
+    }                                                                                                    \
+    TARGET void NAME##ScaleAdd(float beta, const float* x, float* y, int size) {                        \
+        scaleAddKernel<VEC>(beta, x, y, size);                                                           \
+    }                                                                                                    \
+    TARGET void NAME##Exp(const float* x, int size, float* out) {                                       \
+        expKernel<VEC>(x, size, out);                                                                    \
+    }                                                                                                    \
+    TARGET void NAME##Log(const float* x, int size, float* out) {                                       \
+        logKernel<VEC>(x, size, out);                                                                    \
+    }                                                                                                    \
+    TARGET void NAME##Sigmoid(const float* logits, int size, float* out) {                              \
+        sigmoidKernel<VEC>(logits, size, out);                                                           \
+    }                                                                                                    \
+    TARGET void NAME##Softmax(const float* logits, int count, int numNeurons,                           \
+                              float* probabilities, float* logProbabilities) {                           \
+        softmaxKernel<VEC>(logits, count, numNeurons, probabilities, logProbabilities);                  \
+    }                                                                                                    \
+    const NeuralKernels NAME##_KERNELS {                                                                 \
+        #NAME, NAME##Forward, NAME##WeightGradient, NAME##Downstream, NAME##WeightGradientLive,           \
+        NAME##DownstreamLive, NAME##DownstreamRange, NAME##Axpy, NAME##ScaleAdd, NAME##Exp, NAME##Log,    \
+        NAME##Sigmoid, NAME##Softmax,                                                                    \
+    };
+
+// SSE2 is part of the x86-64 baseline, elsewhere the four lanes map to whatever the target has.
+DEFINE_VECTOR_KERNELS(sse2, , Float4)
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAS_X86_DISPATCH
+DEFINE_VECTOR_KERNELS(avx2, __attribute__((target("avx2,fma"))), Float8)
+DEFINE_VECTOR_KERNELS(avx512, __attribute__((target("avx512f,fma"))), Float16)
+#endif
+
+} // namespace
+
+const NeuralKernels& scalarNeuralKernels() {
+    return SCALAR_KERNELS;
+}
+
+std::vector<const NeuralKernels*> supportedNeuralKernels() {
+    std::vector<const NeuralKernels*> supported {&SCALAR_KERNELS, &sse2_KERNELS};
+#ifdef HAS_X86_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        supported.push_back(&avx2_KERNELS);
+    }
+    if (__builtin_cpu_supports("avx512f")) {
+        supported.push_back(&avx512_KERNELS);
+    }
+#endif
+    return supported;
+}
+
+const NeuralKernels& neuralKernels() {
+    static const NeuralKernels& best = *supportedNeuralKernels().back();
+    return best;
+}
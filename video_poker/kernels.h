@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vector>
+
+// Applied by forward to each sum while it is still in a register.
+enum class Epilogue {
+    NONE,
+    RELU,
+};
+
+// The dense loops of NeuralNet, compiled once per instruction set and picked at startup from cpuid.
+//
+// Matrices are row-major: weights are numNeurons x numInputs and batches hold one sample per row.
+// Every set computes the same sums, the vector sets just add them in a different order (and with FMA
+// where the CPU has it), so results agree with the scalar set up to rounding. Within one set a row's
+// result never depends on count, so a single sample gets the same bits as it does inside a batch.
+struct NeuralKernels {
+    const char* name;
+    // outputs[r][n] = epilogue(biases[n] + sum_i inputs[r][i] * weights[n][i])
+    void (*forward)(const float* inputs, int count, const float* weights, const float* biases,
+                    int numInputs, int numNeurons, Epilogue epilogue, float* outputs);
+    // weightGradient[n][i] += deltas[r][n] * inputs[r][i], one sample after another.
+    void (*weightGradient)(const float* deltas, const float* inputs, int count,
+                           int numInputs, int numNeurons, float* weightGradient);
+    // downstream[r][i] = sum_n weights[n][i] * deltas[r][n]
+    void (*downstream)(const float* weights, const float* deltas, int count,
+                       int numInputs, int numNeurons, float* downstream);
+    // The same two products over only the numLive neurons listed, in ascending order, in live. The other
+    // gradient rows are left alone and the other neurons add nothing downstream, which matches the dense
+    // kernels exactly when their deltas are all zero.
+    void (*weightGradientLive)(const float* deltas, const float* inputs, int count, int numInputs, int numNeurons,
+                               const int* live, int numLive, float* weightGradient);
+    void (*downstreamLive)(const float* weights, const float* deltas, int count, int numInputs, int numNeurons,
+                           const int* live, int numLive, float* downstream);
+    // downstream[r][i] for inputs [begin, end) only, over the live neurons or all of them when live is
+    // null. Splits of the inputs get the same bits as the whole product, so threads can share one.
+    void (*downstreamRange)(const float* weights, const float* deltas, int count, int numInputs, int numNeurons,
+                            const int* live, int numLive, int begin, int end, float* downstream);
+    // y += alpha * x
+    void (*axpy)(float alpha, const float* x, float* y, int size);
+    // y = beta * y + x
+    void (*scaleAdd)(float beta, const float* x, float* y, int size);
+
+    // Transcendentals. The scalar set calls libm; the vector sets evaluate polynomials, with exp within
+    // FAST_EXP_MAX_ERROR and log within FAST_LOG_MAX_ERROR of it, relative. exp saturates to its
+    // values at [FAST_EXP_MIN, FAST_EXP_MAX] outside that range. log gives -inf at 0, NaN below it and
+    // is only bounded on normal inputs.
+    void (*exp)(const float* x, int size, float* out);
+    void (*log)(const float* x, int size, float* out);
+    // out = 1 / (1 + exp(-x))
+    void (*sigmoid)(const float* logits, int size, float* out);
+    // Softmax of each of count rows of numNeurons logits. logProbabilities, if not null, gets the log of
+    // each probability as logit - max - log(sum), with one log per row and exact for tiny probabilities.
+    void (*softmax)(const float* logits, int count, int numNeurons, float* probabilities, float* logProbabilities);
+};
+
+constexpr float FAST_EXP_MIN = -87.3365478f; // log(FLT_MIN)
+constexpr float FAST_EXP_MAX = 88.3762626f; // Just below log(FLT_MAX)
+constexpr float FAST_EXP_MAX_ERROR = 2e-7f;
+constexpr float FAST_LOG_MAX_ERROR = 2e-7f;
+
+// The widest kernels this CPU runs.
+const NeuralKernels& neuralKernels();
+const NeuralKernels& scalarNeuralKernels();
+// Every set this CPU can run, scalar first. For tests and benchmarks.
+std::vector<const NeuralKernels*> supportedNeuralKernels();
@@ -3,6 +3,10 @@
 #include "poker.h"
 #include "agent/policy_gradient_agent.h"
 #include "hyperparams.h"
+#include "rng.h"
+#include "ev_solver.h"
+#include "ev_cache.h"
+#include "deal_corpus.h"
 
 #include <iostream>
 #include <random>
@@ -12,9 +16,19 @@
 #include <thread>
 #include <chrono>
 #include <ctime>
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <stdexcept>
 
 #define EVAL_ITERATIONS 100000
 #define LOGS_DIR "logs/"
+#define EV_CACHE_DIR "bin/"
+#define CORPUS_PATH "bin/corpus.bin"
+#define DEFAULT_CORPUS_DEALS 1000000
+#define COMPILED_DIR "bin/compiled"
+#define COMPILED_NAME "policy_net"
+#define CHECKPOINT_DIR "bin/"
 
 std::string getLogName(std::string actorName) {
     const auto now = std::chrono::system_clock::now();
@@ -31,22 +45,31 @@ std::unique_ptr<BaselineCalculator> getRunningAverageBaseline() {
     return std::make_unique<RunningAverageBaseline>();
 }
 
-std::unique_ptr<BaselineCalculator> getCriticNetworkBaseline(NeuralNet* net, const HyperParameters& config) {
-    std::unique_ptr<Optimizer> optimizer;
+std::unique_ptr<Optimizer> getCriticOptimizer(Network* net, const HyperParameters& config) {
     switch (config.criticOptimizerType) {
         case SDG:
-            optimizer = std::make_unique<SDGOptimizer>();
-            break;
+            return std::make_unique<SDGOptimizer>();
         case MOMENTUM:
-            optimizer = std::make_unique<MomentumOptimizer>(net, config.criticMomentumCoeff);
-            break;
+            return std::make_unique<MomentumOptimizer>(net, config.criticMomentumCoeff);
     }
-    return std::make_unique<CriticNetworkBaseline>(net, config.criticTopology, config.criticLearningRate, std::move(optimizer));
+    throw std::invalid_argument("Unknown critic optimizer");
+}
+
+std::unique_ptr<BaselineCalculator> getCriticNetworkBaseline(Network* net, Optimizer* optimizer, const HyperParameters& config) {
+    return std::make_unique<CriticNetworkBaseline>(net, config.criticTopology, config.criticLearningRate, optimizer);
 }
 
-int main() {
-    std::random_device rd {};
-    std::mt19937 rng {rd()};
+int main(int argc, char* argv[]) {
+    // Every random stream in a run is split off this seed. Pass a logged seed to replay a run.
+    uint64_t seed;
+    if (argc > 1) {
+        seed = std::stoull(argv[1]);
+    } else {
+        std::random_device rd {};
+        seed = (uint64_t(rd()) << 32) | rd();
+    }
+    std::cout << "Seed: " << seed << std::endl;
+    Rng rng = Rng(seed).split(EVAL_STREAM);
 
     std::cout << "Select Config:" << std::endl;
     for (size_t i = 0; i < AvailableConfigs.size(); i++) {
@@ -63,7 +86,9 @@ int main() {
     std::cout << "Loading " << config.name << std::endl;
 
     // TODO: Create all Neural Nets in the same place (i.e. main or agent).
-    std::unique_ptr<NeuralNet> criticNetwork = std::make_unique<NeuralNet>(CRITIC_NETWORK_TOPOLOGY);
+    std::unique_ptr<Network> criticNetwork = makeNetwork(CRITIC_NETWORK_TOPOLOGY, Rng(seed).split(CRITIC_INIT_STREAM));
+    // Shared by every training session, so its momentum carries over like the agent's.
+    std::unique_ptr<Optimizer> criticOptimizer = getCriticOptimizer(criticNetwork.get(), config);
     std::function<std::unique_ptr<BaselineCalculator>()> baselineFactory;
     switch(config.baselineCalculatorType) {
         case FLAT:
@@ -73,17 +98,30 @@ int main() {
             baselineFactory = getRunningAverageBaseline;
             break;
         case CRITIC_NETWORK:
-            baselineFactory = std::bind(getCriticNetworkBaseline, criticNetwork.get(), config);
+            baselineFactory = std::bind(getCriticNetworkBaseline, criticNetwork.get(), criticOptimizer.get(), config);
             break;
     }
 
     PolicyGradientAgent agent {
         config,
         getLogName(config.name), 
-        rd(), 
+        seed, 
         baselineFactory,
     };
+    agent.setCritic(criticNetwork.get(), criticOptimizer.get());
 
+    std::unique_ptr<EvSolver> evSolver; // Built on first use.
+    const GameTables& tables = getGameTables(config.variant);
+    std::string evCachePath = std::string(EV_CACHE_DIR) + "ev_cache_" + tables.name + ".bin";
+    std::unique_ptr<EvCache> evCache;
+    try {
+        evCache = std::make_unique<EvCache>(evCachePath, tables);
+        std::cout << "Loaded EV cache: " << evCachePath << std::endl;
+    } catch (const std::runtime_error& e) {
+        std::cout << e.what() << ", run build_cache to create it." << std::endl;
+    }
+    std::unique_ptr<DealCorpus> corpus;
+    std::vector<int> lastCorpusScores; // Baseline for the paired comparison of the next corpus eval.
     std::string input;
     std::cout << "Enter command: ";
     while (std::getline(std::cin, input)) {
@@ -97,7 +135,90 @@ int main() {
             std::cout << "Agent Iterations: " << agent.getNumTrainingIterations() << std::endl;
         } else if (input == "eval") {
             agent.randomEval(EVAL_ITERATIONS, rng);
-            agent.targetedEval(rng);
+            agent.targetedEval(rng, evCache.get());
+        } else if (input == "regret") {
+            if (evCache) {
+                agent.regretEval(EVAL_ITERATIONS, rng, *evCache);
+            } else {
+                if (!evSolver) evSolver = std::make_unique<EvSolver>(tables);
+                agent.regretEval(EVAL_ITERATIONS, rng, *evSolver);
+            }
+        } else if (input == "exact") {
+            if (evCache) {
+                agent.exactEval(*evCache, std::thread::hardware_concurrency());
+            } else {
+                if (!evSolver) evSolver = std::make_unique<EvSolver>(tables);
+                agent.exactEval(*evSolver, std::thread::hardware_concurrency());
+            }
+        } else if (input == "write_corpus" || input.rfind("write_corpus ", 0) == 0) {
+            long long numDeals = input.size() > 13 ? std::atoll(input.c_str() + 13) : DEFAULT_CORPUS_DEALS;
+            if (numDeals <= 0) {
+                std::cout << "Invalid corpus size: " << input.substr(13) << std::endl;
+            } else {
+                corpus.reset();
+                lastCorpusScores.clear();
+                Rng corpusRng = Rng(seed).split(CORPUS_STREAM);
+                DealCorpus::write(CORPUS_PATH, numDeals, corpusRng);
+                std::cout << "Wrote " << numDeals << " deals to " << CORPUS_PATH << std::endl;
+            }
+        } else if (input == "corpus") {
+            try {
+                if (!corpus) corpus = std::make_unique<DealCorpus>(CORPUS_PATH);
+            } catch (const std::runtime_error& e) {
+                std::cout << e.what() << ", run write_corpus to create it." << std::endl;
+            }
+            if (corpus) {
+                std::vector<int> scores = agent.corpusEval(*corpus, std::thread::hardware_concurrency());
+                if (!lastCorpusScores.empty()) {
+                    ScoreSummary difference = summarizePairedDifference(scores, lastCorpusScores);
+                    std::cout << "Change since last corpus eval: " << difference.mean << " +/- " << difference.standardError << std::endl;
+                }
+                lastCorpusScores = std::move(scores);
+            }
+        } else if (input == "build_cache") {
+            if (!evSolver) evSolver = std::make_unique<EvSolver>(tables);
+            evCache.reset();
+            EvCache::build(evCachePath, *evSolver);
+            evCache = std::make_unique<EvCache>(evCachePath, tables);
+            std::cout << "Wrote " << evCache->getNumClasses() << " classes to " << evCachePath << std::endl;
+        } else if (input == "quantize") {
+            agent.quantize(EVAL_ITERATIONS, rng);
+            std::cout << "Evals use the int8 net until the next train or fp32." << std::endl;
+        } else if (input == "fp32") {
+            agent.useFp32();
+        } else if (input == "save" || input.rfind("save ", 0) == 0) {
+            std::string path = input.size() > 5 ? input.substr(5) : CHECKPOINT_DIR + config.name + ".ckpt";
+            try {
+                agent.save(path);
+                std::cout << "Saved " << path << ", training now saves there every " << CHECKPOINT_STEP << " batches." << std::endl;
+            } catch (const std::runtime_error& e) {
+                std::cout << e.what() << std::endl;
+            }
+        } else if (input == "load" || input.rfind("load ", 0) == 0) {
+            std::string path = input.size() > 5 ? input.substr(5) : CHECKPOINT_DIR + config.name + ".ckpt";
+            try {
+                agent.load(path);
+                std::cout << "Loaded " << path << " at batch " << agent.getNumBatches() << std::endl;
+            } catch (const std::runtime_error& e) {
+                std::cout << e.what() << std::endl;
+            }
+        } else if (input == "compile") {
+            std::filesystem::create_directories(COMPILED_DIR);
+            agent.compile(COMPILED_DIR, COMPILED_NAME);
+            std::cout << "Wrote " << COMPILED_DIR << "/" << COMPILED_NAME << ".h and .cc, make bench_compiled to time them." << std::endl;
+        } else if (input.rfind("threads ", 0) == 0) {
+            int threads = std::atoi(input.c_str() + 8);
+            agent.setLayerThreads(std::max(threads, 1));
+            int wideLayers = 0;
+            for (size_t i = 1; i < config.actorTopology.size(); i++) {
+                wideLayers += int64_t(config.actorTopology[i - 1].numNeurons) * config.actorTopology[i].numNeurons >= TEAM_MIN_WEIGHTS;
+            }
+            if (wideLayers == 0) {
+                std::cout << "No layer of " << config.name << " has the " << TEAM_MIN_WEIGHTS
+                          << " weights it takes to split, per-sample evals stay on one thread." << std::endl;
+            } else {
+                std::cout << "Per-sample evals split " << wideLayers << " wide layers across " << std::max(threads, 1) << " threads." << std::endl;
+            }
         } else if (input == "exit") {
             break;
         } else {
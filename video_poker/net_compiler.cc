@@ -0,0 +1,258 @@
+#include "net_compiler.h"
+
+#include "poker.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <ios>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// Neurons per cache line, the padding of every emitted layer.
+constexpr int EMIT_ALIGNMENT = 16;
+constexpr int VALUES_PER_LINE = 8;
+constexpr int BLOCKS_PER_PASS = 4;
+
+int paddedSize(int size) {
+    return (size + EMIT_ALIGNMENT - 1) / EMIT_ALIGNMENT * EMIT_ALIGNMENT;
+}
+
+bool isIdentifier(const std::string& name) {
+    if (name.empty() || std::isdigit(static_cast<unsigned char>(name[0]))) {
+        return false;
+    }
+    for (char c : name) {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_') {
+            return false;
+        }
+    }
+    return true;
+}
+
+void checkTopology(const std::vector<LayerSpecification>& topology) {
+    if (topology.size() < 2 || topology.front().numNeurons != ENCODED_HAND_SIZE) {
+        throw std::invalid_argument("Only nets over the one-hot hand encoding can be compiled");
+    }
+    const LayerSpecification& output = topology.back();
+    bool argmax = output.numNeurons == 32 &&
+                  (output.activationType == Activation::SOFTMAX || output.activationType == Activation::LINEAR);
+    bool perCard = output.numNeurons == 5 && output.activationType == Activation::SIGMOID;
+    if (!argmax && !perCard) {
+        throw std::invalid_argument("Compiled nets need 32 SOFTMAX or LINEAR outputs or 5 SIGMOID ones");
+    }
+    for (size_t l = 1; l + 1 < topology.size(); l++) {
+        if (topology[l].activationType == Activation::SOFTMAX) {
+            throw std::invalid_argument("Compiled nets can not have hidden SOFTMAX layers");
+        }
+    }
+}
+
+// Floats as hex literals, which round-trip exactly.
+void writeValues(std::ostream& out, const float* values, int size, const char* indent) {
+    for (int i = 0; i < size; i++) {
+        out << (i % VALUES_PER_LINE == 0 ? indent : " ") << values[i] << "f" << (i + 1 < size ? "," : "");
+        if (i % VALUES_PER_LINE == VALUES_PER_LINE - 1 || i + 1 == size) {
+            out << "\n";
+        }
+    }
+}
+
+// Layer l's parameters, zero in the padding: B<l>[padded] and, for the one-hot first layer, the weight
+// rows of each input as W1[numInputs][padded]. Later layers are in blocks of EMIT_ALIGNMENT neurons,
+// W<l>[padded / EMIT_ALIGNMENT][numInputs] vectors, so a block's sums stay in a register while its
+// weights stream past in order.
+void writeParameters(std::ostream& out, const Network& net, const std::vector<LayerSpecification>& topology, int l) {
+    int numInputs = topology[l - 1].numNeurons;
+    int numNeurons = topology[l].numNeurons;
+    int padded = paddedSize(numNeurons);
+    std::vector<float> weights = net.getLayerWeights(l - 1);
+    std::vector<float> biases = net.getLayerBiases(l - 1);
+    biases.resize(padded, 0.0f);
+    auto weight = [&](int n, int i) {
+        return n < numNeurons ? weights[n * numInputs + i] : 0.0f;
+    };
+    out << "// Layer " << l << ": " << topology[l] << ".\n";
+    std::vector<float> row;
+    if (l == 1) {
+        out << "alignas(64) constexpr float W1[" << numInputs << "][" << padded << "] = {\n";
+        for (int i = 0; i < numInputs; i++) {
+            row.clear();
+            for (int n = 0; n < padded; n++) {
+                row.push_back(weight(n, i));
+            }
+            out << "    {\n";
+            writeValues(out, row.data(), padded, "        ");
+            out << "    },\n";
+        }
+    } else {
+        out << "constexpr Block W" << l << "[" << padded / EMIT_ALIGNMENT << "][" << numInputs << "] = {\n";
+        for (int block = 0; block < padded; block += EMIT_ALIGNMENT) {
+            out << "    {\n";
+            for (int i = 0; i < numInputs; i++) {
+                row.clear();
+                for (int n = block; n < block + EMIT_ALIGNMENT; n++) {
+                    row.push_back(weight(n, i));
+                }
+                out << "        {\n";
+                writeValues(out, row.data(), EMIT_ALIGNMENT, "            ");
+                out << "        },\n";
+            }
+            out << "    },\n";
+        }
+    }
+    out << "};\n";
+    out << "alignas(64) constexpr float B" << l << "[" << padded << "] = {\n";
+    writeValues(out, biases.data(), padded, "    ");
+    out << "};\n\n";
+}
+
+// Sums of layer l into a<l>, then its hidden activation.
+void writeLayer(std::ostream& out, const std::vector<LayerSpecification>& topology, int l) {
+    int numInputs = topology[l - 1].numNeurons;
+    int padded = paddedSize(topology[l].numNeurons);
+    out << "    alignas(64) float a" << l << "[" << padded << "];\n";
+    if (l == 1) {
+        out << "    for (int n = 0; n < " << padded << "; n++) {\n";
+        out << "        a1[n] = B1[n];\n";
+        out << "    }\n";
+        out << "    for (int k = 0; k < ENCODED_ACTIVE_INPUTS; k++) {\n";
+        out << "        const float* w = W1[active[k]];\n";
+        out << "        for (int n = 0; n < " << padded << "; n++) {\n";
+        out << "            a1[n] += w[n];\n";
+        out << "        }\n";
+        out << "    }\n";
+    } else {
+        bool sparse = topology[l - 1].activationType == Activation::RELU;
+        if (sparse) {
+            // Compacted without branches, which would mispredict on every other input.
+            out << "    int live" << l - 1 << "[" << numInputs << "];\n";
+            out << "    int numLive" << l - 1 << " = 0;\n";
+            out << "    for (int i = 0; i < " << numInputs << "; i++) {\n";
+            out << "        live" << l - 1 << "[numLive" << l - 1 << "] = i;\n";
+            out << "        numLive" << l - 1 << " += a" << l - 1 << "[i] != 0.0f;\n";
+            out << "    }\n";
+        }
+        // Blocks are summed BLOCKS_PER_PASS at a time, as independent chains of adds that hide each
+        // other's latency.
+        int numBlocks = padded / EMIT_ALIGNMENT;
+        for (int first = 0; first < numBlocks; first += BLOCKS_PER_PASS) {
+            int last = std::min(first + BLOCKS_PER_PASS, numBlocks);
+            out << "    {\n";
+            for (int b = first; b < last; b++) {
+                out << "        Block sums" << b - first << " = *reinterpret_cast<const Block*>(B" << l << " + "
+                    << b * EMIT_ALIGNMENT << ");\n";
+            }
+            if (sparse) {
+                out << "        for (int k = 0; k < numLive" << l - 1 << "; k++) {\n";
+                out << "            int i = live" << l - 1 << "[k];\n";
+            } else {
+                out << "        for (int i = 0; i < " << numInputs << "; i++) {\n";
+            }
+            out << "            float x = a" << l - 1 << "[i];\n";
+            for (int b = first; b < last; b++) {
+                out << "            sums" << b - first << " += x * W" << l << "[" << b << "][i];\n";
+            }
+            out << "        }\n";
+            for (int b = first; b < last; b++) {
+                out << "        *reinterpret_cast<Block*>(a" << l << " + " << b * EMIT_ALIGNMENT << ") = sums" << b - first
+                    << ";\n";
+            }
+            out << "    }\n";
+        }
+    }
+    if (l + 1 == int(topology.size())) {
+        return;
+    }
+    switch (topology[l].activationType) {
+        case Activation::RELU:
+            out << "    for (int n = 0; n < " << padded << "; n++) {\n";
+            out << "        a" << l << "[n] = a" << l << "[n] > 0.0f ? a" << l << "[n] : 0.0f;\n";
+            out << "    }\n";
+            break;
+        case Activation::SIGMOID:
+            out << "    for (int n = 0; n < " << padded << "; n++) {\n";
+            out << "        a" << l << "[n] = 1.0f / (1.0f + std::exp(-a" << l << "[n]));\n";
+            out << "    }\n";
+            break;
+        case Activation::LINEAR:
+        case Activation::SOFTMAX:
+            break;
+    }
+}
+
+void writeDecision(std::ostream& out, const std::vector<LayerSpecification>& topology) {
+    int last = topology.size() - 1;
+    if (topology[last].numNeurons == 32) {
+        out << "    int best = 0;\n";
+        out << "    for (int n = 1; n < 32; n++) {\n";
+        out << "        if (a" << last << "[n] > a" << last << "[best]) {\n";
+        out << "            best = n;\n";
+        out << "        }\n";
+        out << "    }\n";
+        out << "    return best;\n";
+    } else {
+        out << "    int exchanges = 0;\n";
+        out << "    for (int n = 0; n < 5; n++) {\n";
+        out << "        exchanges |= (1.0f / (1.0f + std::exp(-a" << last << "[n])) > 0.5f) << n;\n";
+        out << "    }\n";
+        out << "    return exchanges;\n";
+    }
+}
+
+std::ofstream openOutput(const std::string& path) {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out.is_open()) throw std::runtime_error("Could not open compiled net for writing: " + path);
+    return out;
+}
+
+} // namespace
+
+void compileNetwork(const Network& net, const std::string& directory, const std::string& name) {
+    if (!isIdentifier(name)) {
+        throw std::invalid_argument("Compiled net names must be identifiers: " + name);
+    }
+    std::vector<LayerSpecification> topology = net.getTopology();
+    checkTopology(topology);
+
+    std::string headerPath = directory + "/" + name + ".h";
+    std::ofstream header = openOutput(headerPath);
+    header << "// Generated by compileNetwork, do not edit.\n";
+    header << "#pragma once\n\n";
+    header << "#include \"poker.h\"\n\n";
+    header << "namespace " << name << " {\n\n";
+    header << "// The ExchangeMask the greedy policy of the net picks for hand.\n";
+    header << "int bestHold(const Hand& hand);\n\n";
+    header << "} // namespace " << name << "\n";
+    if (!header) throw std::runtime_error("Failed writing compiled net: " + headerPath);
+
+    std::string sourcePath = directory + "/" + name + ".cc";
+    std::ofstream source = openOutput(sourcePath);
+    source << std::hexfloat;
+    source << "// Generated by compileNetwork, do not edit.\n";
+    source << "#include \"" << name << ".h\"\n\n";
+    source << "#include <cmath>\n\n";
+    source << "namespace " << name << " {\n\n";
+    source << "namespace {\n\n";
+    source << "// One cache line of neurons.\n";
+    source << "typedef float Block __attribute__((vector_size(" << EMIT_ALIGNMENT * sizeof(float) << ")));\n\n";
+    for (size_t l = 1; l < topology.size(); l++) {
+        writeParameters(source, net, topology, l);
+    }
+    source << "} // namespace\n\n";
+    // One clone per instruction set, picked at load time from cpuid, so blocks are one zmm register
+    // where the CPU has them.
+    source << "__attribute__((target_clones(\"avx512f\", \"avx2\", \"default\")))\n";
+    source << "int bestHold(const Hand& hand) {\n";
+    source << "    int active[ENCODED_ACTIVE_INPUTS];\n";
+    source << "    encodeHandIndices(hand, active);\n";
+    for (size_t l = 1; l < topology.size(); l++) {
+        writeLayer(source, topology, l);
+    }
+    writeDecision(source, topology);
+    source << "}\n\n";
+    source << "} // namespace " << name << "\n";
+    if (!source) throw std::runtime_error("Failed writing compiled net: " + sourcePath);
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "neural.h"
+
+#include <string>
+
+// Ahead-of-time compiler from a trained policy network to C++ source.
+//
+// Writes directory/name.h and directory/name.cc, which depend on nothing but poker.h and declare one
+// entry point, name::bestHold(const Hand&), returning the ExchangeMask the net's greedy policy picks.
+// The parameters become aligned constexpr arrays and every loop bound and activation is fixed, with a
+// clone of the code per instruction set like the kernels:
+// - the one-hot first layer sums the weight rows of the hand's active inputs;
+// - the other layers keep their sums in vector registers, one per cache line of neurons, and stream
+//   their weights in the order the sums read them, skipping the inputs a ReLU zeroed;
+// - a 32-way output picks its largest logit without the softmax, which cannot change the order, and
+//   a 5-way sigmoid output sets a bit per card whose probability is above one half.
+// Sums run in a different order than the kernels, so the result can differ from predict where two
+// holds are within rounding of each other.
+//
+// Throws std::invalid_argument unless the net takes the ENCODED_HAND_SIZE one-hot inputs and ends in
+// 32 SOFTMAX or LINEAR outputs or 5 SIGMOID ones, and std::runtime_error if a file can not be written.
+void compileNetwork(const Network& net, const std::string& directory, const std::string& name);
@@ -1,125 +1,348 @@
 #include "neural.h"
 #include "activations.h"
 #include "workspace.h"
+#include "kernels.h"
+#include "thread_team.h"
 
+#include <cstdint>
 #include <random>
 #include <memory>
 #include <stdexcept>
 #include <cmath>
+#include <algorithm>
+
+namespace {
+
+// Blocks per team thread in a split layer, so a thread that falls behind is made up for by the others.
+constexpr int TEAM_BLOCKS_PER_THREAD = 4;
+// Block sizes are a multiple of this, so blocks of neurons or inputs start on a cache line.
+constexpr int TEAM_BLOCK_ALIGNMENT = 16;
+
+int ceilDiv(int value, int divisor) {
+    return (value + divisor - 1) / divisor;
+}
+
+int teamBlockSize(int size, const ThreadTeam& team) {
+    int blockSize = ceilDiv(size, team.size() * TEAM_BLOCKS_PER_THREAD);
+    return std::max(1, ceilDiv(blockSize, TEAM_BLOCK_ALIGNMENT)) * TEAM_BLOCK_ALIGNMENT;
+}
+
+// Whether a per-sample pass through a layer of numNeurons x numInputs weights is split across team,
+// which may be null.
+bool shouldSplitLayer(const ThreadTeam* team, int numInputs, int numNeurons) {
+    return team != nullptr && team->size() > 1 && int64_t(numNeurons) * numInputs >= TEAM_MIN_WEIGHTS;
+}
+
+// One sample through such a layer with the products split across team. forwardSplit writes
+// epilogue(sums) to outputs. backwardSplit takes the layer's deltas, and live lists numLive neurons to
+// restrict the products to, or is null for all of them. downstreamGradientOut may be null.
+void forwardSplit(const float* inputs, const float* weights, const float* biases, int numInputs, int numNeurons,
+                  Epilogue epilogue, float* outputs, ThreadTeam& team) {
+    const NeuralKernels& kernels = neuralKernels();
+    int blockSize = teamBlockSize(numNeurons, team);
+    team.parallelFor(ceilDiv(numNeurons, blockSize), [&](int block) {
+        int begin = block * blockSize;
+        int size = std::min(blockSize, numNeurons - begin);
+        kernels.forward(inputs, 1, weights + begin * numInputs, biases + begin, numInputs, size, epilogue, outputs + begin);
+    });
+}
+
+void backwardSplit(const float* deltas, const float* layerInputs, const float* weights, int numInputs, int numNeurons,
+                   const int* live, int numLive, float* weightGradientOut, float* downstreamGradientOut,
+                   ThreadTeam& team) {
+    const NeuralKernels& kernels = neuralKernels();
+    if (live == nullptr) {
+        numLive = numNeurons;
+    }
+    // Neurons own disjoint gradient rows and inputs disjoint downstream entries, so the blocks of both
+    // products can run in one job without any reduction.
+    int neuronBlockSize = teamBlockSize(numLive, team);
+    int neuronBlocks = ceilDiv(numLive, neuronBlockSize);
+    int inputBlockSize = downstreamGradientOut != nullptr ? teamBlockSize(numInputs, team) : numInputs;
+    int inputBlocks = downstreamGradientOut != nullptr ? ceilDiv(numInputs, inputBlockSize) : 0;
+    team.parallelFor(neuronBlocks + inputBlocks, [&](int block) {
+        if (block < neuronBlocks) {
+            int begin = block * neuronBlockSize;
+            int size = std::min(neuronBlockSize, numLive - begin);
+            if (live != nullptr) {
+                kernels.weightGradientLive(deltas, layerInputs, 1, numInputs, numNeurons, live + begin, size,
+                                           weightGradientOut);
+            } else {
+                kernels.weightGradient(deltas + begin, layerInputs, 1, numInputs, size,
+                                       weightGradientOut + begin * numInputs);
+            }
+        } else {
+            int begin = (block - neuronBlocks) * inputBlockSize;
+            int end = std::min(begin + inputBlockSize, numInputs);
+            kernels.downstreamRange(weights, deltas, 1, numInputs, numNeurons, live, numLive,
+                                    begin, end, downstreamGradientOut);
+        }
+    });
+}
+
+} // namespace
+
+int findLiveNeurons(const float* activations, int count, int numNeurons, int* live) {
+    std::fill_n(live, numNeurons, 0);
+    for (int r = 0; r < count; r++) {
+        for (int n = 0; n < numNeurons; n++) {
+            live[n] |= activations[r * numNeurons + n] > 0.0f;
+        }
+    }
+    // In place, as index k is only written once flag n >= k has been read.
+    int numLive = 0;
+    for (int n = 0; n < numNeurons; n++) {
+        if (live[n]) {
+            live[numLive++] = n;
+        }
+    }
+    return numLive;
+}
+
+void transposeMatrix(const float* in, int rows, int cols, float* out) {
+    for (int c = 0; c < cols; c++) {
+        for (int r = 0; r < rows; r++) {
+            out[c * rows + r] = in[r * cols + c];
+        }
+    }
+}
 
 Layer::Layer(int num_neurons, 
              int num_inputs,
-             Activation activationType)
+             Activation activationType,
+             Rng& rng,
+             std::span<float> weights,
+             std::span<float> biases)
              : mNumNeurons(num_neurons),
                mNumInputs(num_inputs),
-               mBiases(std::vector<float>(num_neurons, 0.0f)), // Biases can start at 0 since weights break symmetry
+               mWeights(weights),
+               mBiases(biases), // Biases can start at 0 since weights break symmetry
                mActivationType(activationType) {
-    std::random_device rd;
-    std::mt19937 generator(rd());
+    if (mWeights.size() != size_t(num_neurons) * num_inputs || mBiases.size() != size_t(num_neurons)) {
+        throw std::invalid_argument("Parameter views do not match the layer");
+    }
     std::uniform_real_distribution<float> dis(-1.0, 1.0);
-    mWeights.reserve(num_neurons * num_inputs);
-    for (int i = 0; i < num_neurons * num_inputs; i++) {
-        mWeights.push_back(dis(generator) / sqrt(num_inputs));
+    for (float& w : mWeights) {
+        w = dis(rng) / sqrt(num_inputs);
     }
+    std::fill(mBiases.begin(), mBiases.end(), 0.0f);
 }
 
 void Layer::fire(const std::vector<float>& inputs,
                  std::vector<float>& logitsBuffer,
-                 std::vector<float>& activationsOut) const {
+                 std::vector<float>& activationsOut,
+                 ThreadTeam* team) const {
     if (int(inputs.size()) != mNumInputs) {
         std::cerr << "Inputs: " << inputs.size() << ", Neurons: " << mNumInputs << std::endl;
         throw std::invalid_argument("Inputs != Weights");
     }
-    for (int n = 0; n < mNumNeurons; n++) {
-        float sum = mBiases[n];
-        for (size_t i = 0; i < inputs.size(); i++) {
-            sum += inputs[i] * mWeights[n*mNumInputs+i];
-        }
-        logitsBuffer[n] = sum;
+    if (shouldSplitLayer(team, mNumInputs, mNumNeurons)) {
+        fireSplit(inputs.data(), logitsBuffer.data(), activationsOut.data(), *team);
+        return;
+    }
+    fireBatch(inputs.data(), 1, logitsBuffer.data(), activationsOut.data());
+}
+
+void Layer::backpropagate(const std::vector<float>& upstreamGradient,
+                          const std::vector<float>& layerInputs,
+                          const std::vector<float>& layerActivations,
+                          std::vector<float>& deltaBuffer,
+                          std::vector<int>& liveBuffer,
+                          float* weightGradientOut,
+                          float* biasGradientOut,
+                          float* downstreamGradientOut,
+                          ThreadTeam* team) const {
+    if (shouldSplitLayer(team, mNumInputs, mNumNeurons)) {
+        backpropagateSplit(upstreamGradient.data(),
+                           layerInputs.data(),
+                           layerActivations.data(),
+                           deltaBuffer.data(),
+                           liveBuffer.data(),
+                           weightGradientOut,
+                           biasGradientOut,
+                           downstreamGradientOut,
+                           *team);
+        return;
     }
+    backpropagateBatch(upstreamGradient.data(),
+                       1,
+                       layerInputs.data(),
+                       layerActivations.data(),
+                       deltaBuffer.data(),
+                       liveBuffer.data(),
+                       weightGradientOut,
+                       biasGradientOut,
+                       downstreamGradientOut);
+}
+
+void Layer::fireBatch(const float* inputs,
+                      int count,
+                      float* logitsBuffer,
+                      float* activationsOut,
+                      float* logActivationsOut) const {
+    const NeuralKernels& kernels = neuralKernels();
     switch (mActivationType) {
         case Activation::LINEAR:
-            activationsOut = logitsBuffer;
+            kernels.forward(inputs, count, mWeights.data(), mBiases.data(), mNumInputs, mNumNeurons, Epilogue::NONE, activationsOut);
             break;
         case Activation::RELU:
-            relu(logitsBuffer, mNumNeurons, activationsOut);
+            kernels.forward(inputs, count, mWeights.data(), mBiases.data(), mNumInputs, mNumNeurons, Epilogue::RELU, activationsOut);
             break;
         case Activation::SIGMOID:
-            sigmoid(logitsBuffer, mNumNeurons, activationsOut);
-            break;
         case Activation::SOFTMAX:
-            softmax(logitsBuffer, mNumNeurons, activationsOut);
+            kernels.forward(inputs, count, mWeights.data(), mBiases.data(), mNumInputs, mNumNeurons, Epilogue::NONE, logitsBuffer);
+            activate(logitsBuffer, count, activationsOut, logActivationsOut);
             break;
     }
 }
 
-void Layer::backpropagate(const std::vector<float>& upstreamGradient,
-                          const std::vector<float>& layerInputs,
-                          const std::vector<float>& layerActivations,
-                          std::vector<float>& deltaBuffer,
-                          std::vector<float>& outputDerivativesBuffer,
-                          std::vector<float>& weightGradientOut,
-                          std::vector<float>& biasGradientOut,
-                          std::vector<float>& downstreamGradientOut) const {
-    if (mActivationType == Activation::SOFTMAX) {
-        deltaBuffer = upstreamGradient;
-    } else {
-        switch (mActivationType) {
-            case Activation::LINEAR:
-                std::fill(outputDerivativesBuffer.begin(), outputDerivativesBuffer.end(), 1.0f);
-                break;
-            case Activation::RELU:
-                // TODO: May need to pass # of inputs/neurons here?
-                relu_derivative(layerActivations, outputDerivativesBuffer);
-                break;
-            case Activation::SIGMOID:
-                sigmoid_derivative(layerActivations, outputDerivativesBuffer);
-                break;
-            case Activation::SOFTMAX:
-                // Errors vector is already final gradient, handled above.
-                break;
+void Layer::fireSparse(const int* activeInputs,
+                       int activePerSample,
+                       int count,
+                       const float* inputMajorWeights,
+                       float* logitsBuffer,
+                       float* activationsOut,
+                       float* logActivationsOut) const {
+    const NeuralKernels& kernels = neuralKernels();
+    bool fused = mActivationType == Activation::LINEAR || mActivationType == Activation::RELU;
+    float* outputs = fused ? activationsOut : logitsBuffer;
+    for (int r = 0; r < count; r++) {
+        const int* active = activeInputs + r * activePerSample;
+        float* row = outputs + r * mNumNeurons;
+        std::copy(mBiases.begin(), mBiases.end(), row);
+        // x * 1 + y rounds like x + y, with or without FMA.
+        for (int k = 0; k < activePerSample; k++) {
+            kernels.axpy(1.0f, inputMajorWeights + active[k] * mNumNeurons, row, mNumNeurons);
         }
-        for (int n = 0; n < mNumNeurons; n++) {
-            deltaBuffer[n] = outputDerivativesBuffer[n] * upstreamGradient[n];
+        if (mActivationType == Activation::RELU) {
+            for (int n = 0; n < mNumNeurons; n++) {
+                row[n] = row[n] < 0.0f ? 0.0f : row[n];
+            }
         }
     }
-    for (int n = 0; n < mNumNeurons; n++) {
-        for (int i = 0; i < mNumInputs; i++) {
-            weightGradientOut[n*mNumInputs+i] += deltaBuffer[n] * layerInputs[i];
-        }
-        biasGradientOut[n] += deltaBuffer[n];
+    if (!fused) {
+        activate(logitsBuffer, count, activationsOut, logActivationsOut);
     }
+}
 
-    for (int i = 0; i < mNumInputs; i++) {
-        float sum = 0.0f;
-        for (int n = 0; n < mNumNeurons; n++) {
-            sum += mWeights[n*mNumInputs+i] * deltaBuffer[n];
-        }
-        downstreamGradientOut[i] = sum;
+void Layer::activate(const float* logitsBuffer, int count, float* activationsOut, float* logActivationsOut) const {
+    switch (mActivationType) {
+        case Activation::LINEAR:
+        case Activation::RELU:
+            // Applied by the forward pass itself.
+            break;
+        case Activation::SIGMOID:
+            neuralKernels().sigmoid(logitsBuffer, count * mNumNeurons, activationsOut);
+            break;
+        case Activation::SOFTMAX:
+            neuralKernels().softmax(logitsBuffer, count, mNumNeurons, activationsOut, logActivationsOut);
+            break;
     }
 }
 
-void Layer::update(float learningRate, 
-                   const std::vector<float>& weightGradient, 
-                   const std::vector<float>& biasGradient) {
-    for (int n = 0; n < mNumNeurons; n++) {
-        for (int i = 0; i < mNumInputs; i++) {
-            mWeights[n*mNumInputs+i] = mWeights[n*mNumInputs+i] - (learningRate * weightGradient[n*mNumInputs+i]);
+void Layer::backpropagateBatch(const float* upstreamGradient,
+                               int count,
+                               const float* layerInputs,
+                               const float* layerActivations,
+                               float* deltaBuffer,
+                               int* liveBuffer,
+                               float* weightGradientOut,
+                               float* biasGradientOut,
+                               float* downstreamGradientOut) const {
+    const float* deltas = computeDeltas(upstreamGradient, count, layerActivations, deltaBuffer, biasGradientOut);
+    const NeuralKernels& kernels = neuralKernels();
+    int numLive = mActivationType == Activation::RELU ? findLiveNeurons(layerActivations, count, mNumNeurons, liveBuffer) : mNumNeurons;
+    if (numLive < LIVE_DENSITY_MAX * mNumNeurons) {
+        kernels.weightGradientLive(deltas, layerInputs, count, mNumInputs, mNumNeurons, liveBuffer, numLive, weightGradientOut);
+        if (downstreamGradientOut != nullptr) {
+            kernels.downstreamLive(mWeights.data(), deltas, count, mNumInputs, mNumNeurons, liveBuffer, numLive,
+                                   downstreamGradientOut);
         }
-        mBiases[n] = mBiases[n] - (learningRate * biasGradient[n]);
+        return;
+    }
+    kernels.weightGradient(deltas, layerInputs, count, mNumInputs, mNumNeurons, weightGradientOut);
+    if (downstreamGradientOut != nullptr) {
+        kernels.downstream(mWeights.data(), deltas, count, mNumInputs, mNumNeurons, downstreamGradientOut);
+    }
+}
+
+void Layer::fireSplit(const float* inputs, float* logitsBuffer, float* activationsOut, ThreadTeam& team) const {
+    bool fused = mActivationType == Activation::LINEAR || mActivationType == Activation::RELU;
+    Epilogue epilogue = mActivationType == Activation::RELU ? Epilogue::RELU : Epilogue::NONE;
+    forwardSplit(inputs, mWeights.data(), mBiases.data(), mNumInputs, mNumNeurons, epilogue,
+                 fused ? activationsOut : logitsBuffer, team);
+    if (!fused) {
+        activate(logitsBuffer, 1, activationsOut, nullptr);
     }
 }
 
+void Layer::backpropagateSplit(const float* upstreamGradient,
+                               const float* layerInputs,
+                               const float* layerActivations,
+                               float* deltaBuffer,
+                               int* liveBuffer,
+                               float* weightGradientOut,
+                               float* biasGradientOut,
+                               float* downstreamGradientOut,
+                               ThreadTeam& team) const {
+    const float* deltas = computeDeltas(upstreamGradient, 1, layerActivations, deltaBuffer, biasGradientOut);
+    int numLive = mActivationType == Activation::RELU ? findLiveNeurons(layerActivations, 1, mNumNeurons, liveBuffer) : mNumNeurons;
+    const int* live = numLive < LIVE_DENSITY_MAX * mNumNeurons ? liveBuffer : nullptr;
+    backwardSplit(deltas, layerInputs, mWeights.data(), mNumInputs, mNumNeurons, live, numLive, weightGradientOut,
+                  downstreamGradientOut, team);
+}
 
-double Layer::getWeightNormSquared() const {
-    double sum = 0.0;
-    for (float b : mBiases) {
-        sum += b * b;
+void Layer::backpropagateSparse(const float* upstreamGradient,
+                                int count,
+                                const int* activeInputs,
+                                int activePerSample,
+                                const float* layerActivations,
+                                float* deltaBuffer,
+                                float* inputMajorGradient,
+                                float* biasGradientOut) const {
+    const float* deltaRows = computeDeltas(upstreamGradient, count, layerActivations, deltaBuffer, biasGradientOut);
+    const NeuralKernels& kernels = neuralKernels();
+    for (int r = 0; r < count; r++) {
+        const int* active = activeInputs + r * activePerSample;
+        for (int k = 0; k < activePerSample; k++) {
+            kernels.axpy(1.0f, deltaRows + r * mNumNeurons, inputMajorGradient + active[k] * mNumNeurons, mNumNeurons);
+        }
     }
-    for (float w : mWeights) {
-        sum += w * w;
+}
+
+const float* Layer::computeDeltas(const float* upstreamGradient,
+                                  int count,
+                                  const float* layerActivations,
+                                  float* deltaBuffer,
+                                  float* biasGradient) const {
+    for (int r = 0; r < count; r++) {
+        const float* upstream = upstreamGradient + r * mNumNeurons;
+        const float* activations = layerActivations + r * mNumNeurons;
+        float* deltas = deltaBuffer + r * mNumNeurons;
+        switch (mActivationType) {
+            case Activation::LINEAR:
+            case Activation::SOFTMAX:
+                // Errors vector is already final gradient.
+                for (int n = 0; n < mNumNeurons; n++) {
+                    biasGradient[n] += upstream[n];
+                }
+                break;
+            case Activation::RELU:
+                for (int n = 0; n < mNumNeurons; n++) {
+                    deltas[n] = activations[n] > 0.0f ? upstream[n] : 0.0f;
+                    biasGradient[n] += deltas[n];
+                }
+                break;
+            case Activation::SIGMOID:
+                for (int n = 0; n < mNumNeurons; n++) {
+                    deltas[n] = activations[n] * (1.0f - activations[n]) * upstream[n];
+                    biasGradient[n] += deltas[n];
+                }
+                break;
+        }
     }
-    return sum;
+    bool passThrough = mActivationType == Activation::LINEAR || mActivationType == Activation::SOFTMAX;
+    return passThrough ? upstreamGradient : deltaBuffer;
 }
 
 int Layer::getNumInputs() const {
@@ -130,68 +353,184 @@ int Layer::getNumNeurons() const {
     return mNumNeurons;
 }
 
-NeuralNet::NeuralNet(const std::vector<LayerSpecification>& topology) {
+void Network::checkActiveInputs(const std::vector<int>& activeInputs, int activePerSample, int count, int numInputs) {
+    size_t numActive = size_t(count) * activePerSample;
+    if (activePerSample <= 0 || activeInputs.size() < numActive) {
+        throw std::invalid_argument("Fewer active inputs than batch rows");
+    }
+    for (size_t k = 0; k < numActive; k++) {
+        if (activeInputs[k] < 0 || activeInputs[k] >= numInputs) {
+            throw std::out_of_range("Active input index out of range");
+        }
+    }
+}
+
+void Network::update(float learningRate, const ParameterArena& gradients) {
+    ParameterArena& parameters = getParameters();
+    if (!parameters.hasLayoutOf(gradients)) {
+        throw std::invalid_argument("Gradients do not match the parameters");
+    }
+    neuralKernels().axpy(-learningRate, gradients.data(), parameters.data(), parameters.size());
+}
+
+std::vector<double> Network::getLayerWeightNormsSquared() const {
+    return getParameters().getLayerNormsSquared();
+}
+
+std::vector<float> Network::getLayerWeights(int layer) const {
+    std::span<const float> weights = getParameters().weights(layer);
+    return {weights.begin(), weights.end()};
+}
+
+std::vector<float> Network::getLayerBiases(int layer) const {
+    std::span<const float> biases = getParameters().biases(layer);
+    return {biases.begin(), biases.end()};
+}
+
+NeuralNet::NeuralNet(const std::vector<LayerSpecification>& topology, const Rng& initRng)
+        : mTopology(topology),
+          mParameters(topology) {
     for (size_t i = 1; i < topology.size(); i++) {
+        Rng layerRng = initRng.split(i);
         mLayers.push_back(Layer(topology[i].numNeurons, 
                                 topology[i-1].numNeurons, 
-                                topology[i].activationType));
+                                topology[i].activationType,
+                                layerRng,
+                                mParameters.weights(i - 1),
+                                mParameters.biases(i - 1)));
     }
 }
 
+const float* NeuralNet::getInputMajorWeights() const {
+    uint64_t version = mParameters.getVersion();
+    if (mInputMajorVersion.load(std::memory_order_acquire) != version) {
+        std::lock_guard<std::mutex> lock(mInputMajorMutex);
+        if (mInputMajorVersion.load(std::memory_order_relaxed) != version) {
+            const Layer& layer = mLayers[0];
+            mInputMajorWeights.resize(size_t(layer.getNumInputs()) * layer.getNumNeurons());
+            transposeMatrix(mParameters.weights(0).data(), layer.getNumNeurons(), layer.getNumInputs(),
+                            mInputMajorWeights.data());
+            mInputMajorVersion.store(version, std::memory_order_release);
+        }
+    }
+    return mInputMajorWeights.data();
+}
+
 const std::vector<Layer>& NeuralNet::getLayers() {
     return mLayers;
 }
 
+std::vector<LayerSpecification> NeuralNet::getTopology() const {
+    return mTopology;
+}
+
+ParameterArena& NeuralNet::getParameters() {
+    return mParameters;
+}
+
+const ParameterArena& NeuralNet::getParameters() const {
+    return mParameters;
+}
+
 void NeuralNet::feedforward(const std::vector<float>& inputs, InferenceWorkspace& workspace) const {
     workspace.mActivations[0] = inputs;
-    mLayers[0].fire(workspace.mActivations[0], workspace.mLogitsBuffer, workspace.mActivations[1]);
+    mLayers[0].fire(workspace.mActivations[0], workspace.mLogitsBuffer, workspace.mActivations[1], workspace.mTeam);
     for (size_t i = 1; i < mLayers.size(); i++) {
-        mLayers[i].fire(workspace.mActivations[i], workspace.mLogitsBuffer, workspace.mActivations[i+1]);
+        mLayers[i].fire(workspace.mActivations[i], workspace.mLogitsBuffer, workspace.mActivations[i+1], workspace.mTeam);
     }
 }
 
 void NeuralNet::backpropagate(const std::vector<float>& errors, TrainingWorkspace& workspace) const {
-    std::vector<float>* upstreamGradient = nullptr;
-    std::vector<float>* downstreamGradient = &workspace.mBlameBufferA; 
-    int last = mLayers.size() - 1;
     const std::vector<std::vector<float>>& activations = workspace.mInferenceWorkspace.getActivations();
-    mLayers[last].backpropagate(errors, 
-                               activations[last],
-                               activations[last+1],
-                               workspace.mDeltaBuffer, 
-                               workspace.mOutputDerivativesBuffer, 
-                               workspace.mTotalWeightGradients[last], 
-                               workspace.mTotalBiasGradients[last], 
-                               *downstreamGradient);
-    for (int i = last-1; i >= 0; i--) {
+    const std::vector<float>* upstreamGradient = &errors;
+    std::vector<float>* downstreamGradient = &workspace.mBlameBufferA;
+    for (int i = mLayers.size() - 1; i >= 0; i--) {
+        // Nothing consumes the gradient of the net's inputs.
+        mLayers[i].backpropagate(*upstreamGradient,
+                                 activations[i],
+                                 activations[i+1],
+                                 workspace.mDeltaBuffer,
+                                 workspace.mLiveNeurons,
+                                 workspace.mGradients.weights(i).data(),
+                                 workspace.mGradients.biases(i).data(),
+                                 i > 0 ? downstreamGradient->data() : nullptr,
+                                 workspace.mInferenceWorkspace.mTeam);
         upstreamGradient = downstreamGradient;
-        downstreamGradient = (upstreamGradient == &workspace.mBlameBufferA ? &workspace.mBlameBufferB : &workspace.mBlameBufferA);
-        mLayers[i].backpropagate(*upstreamGradient, 
-                                activations[i],
-                                activations[i+1],
-                                workspace.mDeltaBuffer, 
-                                workspace.mOutputDerivativesBuffer, 
-                                workspace.mTotalWeightGradients[i], 
-                                workspace.mTotalBiasGradients[i], 
-                                *downstreamGradient);
+        downstreamGradient = (downstreamGradient == &workspace.mBlameBufferA ? &workspace.mBlameBufferB : &workspace.mBlameBufferA);
     }
 }
 
-void NeuralNet::update(float learningRate, 
-        const std::vector<std::vector<float>>& weightGradients,
-        const std::vector<std::vector<float>>& biasGradients) {
-    for (int i = mLayers.size()-1; i >= 0; i--) {
-        mLayers[i].update(learningRate, weightGradients[i], biasGradients[i]);
+void NeuralNet::feedforward(const std::vector<float>& inputs, int count, BatchInferenceWorkspace& workspace) const {
+    if (int(inputs.size()) < count * mLayers[0].getNumInputs()) {
+        throw std::invalid_argument("Fewer inputs than batch rows");
+    }
+    workspace.resize(count);
+    workspace.mActivePerSample = 0;
+    std::copy_n(inputs.begin(), size_t(count) * mLayers[0].getNumInputs(), workspace.mActivations[0].begin());
+    for (size_t i = 0; i < mLayers.size(); i++) {
+        mLayers[i].fireBatch(workspace.mActivations[i].data(),
+                             count,
+                             workspace.mLogitsBuffer.data(),
+                             workspace.mActivations[i+1].data(),
+                             i + 1 == mLayers.size() ? workspace.getLogOutputsBuffer() : nullptr);
     }
 }
 
+void NeuralNet::feedforward(const std::vector<int>& activeInputs, int activePerSample, int count,
+                            BatchInferenceWorkspace& workspace) const {
+    checkActiveInputs(activeInputs, activePerSample, count, mLayers[0].getNumInputs());
+    workspace.resize(count);
+    workspace.mActivePerSample = activePerSample;
+    workspace.mActiveInputs.assign(activeInputs.begin(), activeInputs.begin() + size_t(count) * activePerSample);
+    mLayers[0].fireSparse(workspace.mActiveInputs.data(),
+                          activePerSample,
+                          count,
+                          getInputMajorWeights(),
+                          workspace.mLogitsBuffer.data(),
+                          workspace.mActivations[1].data(),
+                          mLayers.size() == 1 ? workspace.getLogOutputsBuffer() : nullptr);
+    for (size_t i = 1; i < mLayers.size(); i++) {
+        mLayers[i].fireBatch(workspace.mActivations[i].data(),
+                             count,
+                             workspace.mLogitsBuffer.data(),
+                             workspace.mActivations[i+1].data(),
+                             i + 1 == mLayers.size() ? workspace.getLogOutputsBuffer() : nullptr);
+    }
+}
 
-std::vector<double> NeuralNet::getLayerWeightNormsSquared() const {
-    std::vector<double> ret;
-    for (size_t i = 0; i < mLayers.size(); i++) {
-        ret.push_back(mLayers[i].getWeightNormSquared());
+void NeuralNet::backpropagate(const std::vector<float>& errors, int count, TrainingWorkspace& workspace) const {
+    workspace.reserveBatch(count);
+    const BatchInferenceWorkspace& batch = workspace.mBatchInferenceWorkspace;
+    const std::vector<std::vector<float>>& activations = batch.getActivations();
+    const float* upstreamGradient = errors.data();
+    float* downstreamGradient = workspace.mBatchBlameBufferA.data();
+    for (int i = mLayers.size() - 1; i >= 0; i--) {
+        if (i == 0 && batch.mActivePerSample > 0) {
+            mLayers[0].backpropagateSparse(upstreamGradient,
+                                           count,
+                                           batch.mActiveInputs.data(),
+                                           batch.mActivePerSample,
+                                           activations[1].data(),
+                                           workspace.mBatchDeltaBuffer.data(),
+                                           workspace.getInputMajorGradients(),
+                                           workspace.mGradients.biases(0).data());
+            break;
+        }
+        // Nothing consumes the gradient of the net's inputs.
+        mLayers[i].backpropagateBatch(upstreamGradient,
+                                      count,
+                                      activations[i].data(),
+                                      activations[i+1].data(),
+                                      workspace.mBatchDeltaBuffer.data(),
+                                      workspace.mLiveNeurons.data(),
+                                      workspace.mGradients.weights(i).data(),
+                                      workspace.mGradients.biases(i).data(),
+                                      i > 0 ? downstreamGradient : nullptr);
+        upstreamGradient = downstreamGradient;
+        downstreamGradient = (downstreamGradient == workspace.mBatchBlameBufferA.data()
+                                  ? workspace.mBatchBlameBufferB.data()
+                                  : workspace.mBatchBlameBufferA.data());
     }
-    return ret;
 }
 
 std::ostream& operator<<(std::ostream& os, const std::vector<float>& v) {
@@ -3,10 +3,19 @@
 #include <vector>
 #include <iostream>
 #include <functional>
+#include <span>
 #include <string>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+#include "rng.h"
+#include "parameter_arena.h"
 
 class InferenceWorkspace;
+class BatchInferenceWorkspace;
 class TrainingWorkspace;
+class ThreadTeam;
 
 enum class Activation {
     SIGMOID,
@@ -15,14 +24,40 @@ enum class Activation {
     LINEAR
 };
 
+// ReLU layers backpropagate through only the neurons some sample of the batch activated, as the dead
+// ones have zero deltas. At or above this fraction of live neurons the dense kernels are faster.
+constexpr float LIVE_DENSITY_MAX = 0.875f;
+
+// Per-sample fire and backpropagate split a layer across a ThreadTeam from this many weights on.
+// Unmeasured: it was set on a single-core machine, where a team never splits, as a guess at where one
+// pass takes long enough to cover the handoffs. The production layers are well below it. Set it from
+// benchLayerThreads in bench_neural on a multi-core machine before relying on it.
+constexpr int TEAM_MIN_WEIGHTS = 1 << 17;
+
+// Compacts the indices of the neurons active in any of count rows of activations into live, which
+// holds at least numNeurons ints, and returns how many there are.
+int findLiveNeurons(const float* activations, int count, int numNeurons, int* live);
+
+// out[c][r] = in[r][c] for a row-major rows x cols matrix in.
+void transposeMatrix(const float* in, int rows, int cols, float* out);
+
+// A view of one layer's block of its net's ParameterArena, so it must not outlive the net.
 class Layer {
 public:
+    // Draws the initial weights into weights and leaves the biases at 0.
     Layer(int num_neurons, 
           int num_inputs, 
-          Activation activationtype);
+          Activation activationtype,
+          Rng& rng,
+          std::span<float> weights,
+          std::span<float> biases);
+    // team, if not null, shares the products of a wide layer: the forward pass and the weight gradient
+    // by blocks of neurons, the downstream gradient by blocks of inputs. The results are the same bits
+    // as without one.
     void fire(const std::vector<float>& inputs,
               std::vector<float>& logitsBuffer,
-              std::vector<float>& outputs) const;
+              std::vector<float>& outputs,
+              ThreadTeam* team = nullptr) const;
     const std::vector<float>& getOutputs() const;
     int getNumInputs() const;
     int getNumNeurons() const;
@@ -30,41 +65,151 @@ public:
                        const std::vector<float>& layerInputs,
                        const std::vector<float>& layerActivations,
                        std::vector<float>& deltaBuffer,
-                       std::vector<float>& outputDerivativesBuffer,
-                       std::vector<float>& weightGradientOut,
-                       std::vector<float>& biasGradientOut,
-                       std::vector<float>& downstreamGradientOut) const;
-    void update(float learningRate,
-                const std::vector<float>& weightGradient, 
-                const std::vector<float>& biasGradient);
-    double getWeightNormSquared() const;
+                       std::vector<int>& liveBuffer,
+                       float* weightGradientOut,
+                       float* biasGradientOut,
+                       float* downstreamGradientOut,
+                       ThreadTeam* team = nullptr) const;
+    // Minibatch versions over count row-major samples, computed as register-tiled matrix-matrix
+    // products. fire and backpropagate run them on one sample, so the results match the per-sample
+    // path exactly. Here and in backpropagate, downstreamGradientOut may be null for the first layer.
+    //
+    // LINEAR and RELU layers are activated by the forward kernel as each sum leaves its register, and
+    // only SIGMOID and SOFTMAX go through logitsBuffer. A SOFTMAX layer also writes the log of its
+    // activations to logActivationsOut unless it is null; other layers ignore it. The backward pass
+    // forms the deltas and adds them to the bias gradient in one sweep, and LINEAR and SOFTMAX layers
+    // use the upstream gradient as their deltas without copying it. RELU layers list their live neurons
+    // in liveBuffer, of at least getNumNeurons() ints, and skip the dead ones when that pays off.
+    void fireBatch(const float* inputs,
+                   int count,
+                   float* logitsBuffer,
+                   float* activationsOut,
+                   float* logActivationsOut = nullptr) const;
+    void backpropagateBatch(const float* upstreamGradient,
+                            int count,
+                            const float* layerInputs,
+                            const float* layerActivations,
+                            float* deltaBuffer,
+                            int* liveBuffer,
+                            float* weightGradientOut,
+                            float* biasGradientOut,
+                            float* downstreamGradientOut) const;
+    // One-hot inputs given by the indices of their activePerSample active inputs, all other inputs
+    // being 0. Both passes work on input-major getNumInputs() x getNumNeurons() matrices, adding one
+    // contiguous row per active input with the vector kernels. The forward pass sums the rows of
+    // inputMajorWeights, this layer's weights transposed, like an embedding lookup. The backward pass
+    // adds each sample's deltas to the active rows of inputMajorGradient, for the caller to fold into
+    // the weight gradient, and never forms an input gradient.
+    void fireSparse(const int* activeInputs,
+                    int activePerSample,
+                    int count,
+                    const float* inputMajorWeights,
+                    float* logitsBuffer,
+                    float* activationsOut,
+                    float* logActivationsOut = nullptr) const;
+    void backpropagateSparse(const float* upstreamGradient,
+                             int count,
+                             const int* activeInputs,
+                             int activePerSample,
+                             const float* layerActivations,
+                             float* deltaBuffer,
+                             float* inputMajorGradient,
+                             float* biasGradientOut) const;
 
 private:
+    void activate(const float* logitsBuffer, int count, float* activationsOut, float* logActivationsOut) const;
+    void fireSplit(const float* inputs, float* logitsBuffer, float* activationsOut, ThreadTeam& team) const;
+    void backpropagateSplit(const float* upstreamGradient,
+                            const float* layerInputs,
+                            const float* layerActivations,
+                            float* deltaBuffer,
+                            int* liveBuffer,
+                            float* weightGradientOut,
+                            float* biasGradientOut,
+                            float* downstreamGradientOut,
+                            ThreadTeam& team) const;
+    // Returns the deltas, either deltaBuffer or upstreamGradient itself.
+    const float* computeDeltas(const float* upstreamGradient,
+                               int count,
+                               const float* layerActivations,
+                               float* deltaBuffer,
+                               float* biasGradientOut) const;
+
     int mNumNeurons;
     int mNumInputs;
-    std::vector<float> mWeights;
-    std::vector<float> mBiases;
+    std::span<float> mWeights;
+    std::span<float> mBiases;
     Activation mActivationType;
 };
 
 struct LayerSpecification {
     int numNeurons;
     Activation activationType;
+
+    bool operator==(const LayerSpecification& other) const = default;
 };
 
-class NeuralNet {
+// What the agent, the critic and the optimizers drive, implemented by NeuralNet. StaticNet
+// (static_net.h) is a NeuralNet with its topology in its type.
+class Network {
 public:
-    NeuralNet(const std::vector<LayerSpecification>& topology);
-    void feedforward(const std::vector<float>& inputs, InferenceWorkspace& workspace) const;
-    void backpropagate(const std::vector<float>& errors, TrainingWorkspace& workspace) const;
-    void update(float learningRate,
-        const std::vector<std::vector<float>>& weightGradients,
-        const std::vector<std::vector<float>>& biasGradients);
+    virtual ~Network() = default;
+    virtual void feedforward(const std::vector<float>& inputs, InferenceWorkspace& workspace) const = 0;
+    virtual void backpropagate(const std::vector<float>& errors, TrainingWorkspace& workspace) const = 0;
+    // Runs count row-major inputs at once. Outputs are the first count rows of workspace.getOutputs().
+    virtual void feedforward(const std::vector<float>& inputs, int count, BatchInferenceWorkspace& workspace) const = 0;
+    // Sparse one-hot inputs, activePerSample indices per sample. See Layer::fireSparse.
+    virtual void feedforward(const std::vector<int>& activeInputs, int activePerSample, int count,
+                             BatchInferenceWorkspace& workspace) const = 0;
+    // Accumulates the gradients of count row-major error rows against the last batched feedforward
+    // through workspace.mBatchInferenceWorkspace. Same totals as count calls to backpropagate.
+    virtual void backpropagate(const std::vector<float>& errors, int count, TrainingWorkspace& workspace) const = 0;
+    virtual std::vector<LayerSpecification> getTopology() const = 0;
+    // Every weight and bias, laid out as ParameterArena(getTopology()).
+    virtual ParameterArena& getParameters() = 0;
+    virtual const ParameterArena& getParameters() const = 0;
+
+    // parameters -= learningRate * gradients, in one pass over the arena.
+    void update(float learningRate, const ParameterArena& gradients);
     std::vector<double> getLayerWeightNormsSquared() const;
+    // Copies of layer l's row-major numNeurons x numInputs weights and of its biases.
+    std::vector<float> getLayerWeights(int layer) const;
+    std::vector<float> getLayerBiases(int layer) const;
+
+protected:
+    // Throws unless there are count * activePerSample indices, all below numInputs.
+    static void checkActiveInputs(const std::vector<int>& activeInputs, int activePerSample, int count, int numInputs);
+};
+
+class NeuralNet : public Network {
+public:
+    // Layer i is initialized from initRng.split(i), so a net is reproducible from its stream.
+    NeuralNet(const std::vector<LayerSpecification>& topology, const Rng& initRng);
+    // The layers view mParameters, so a copy would share the original's weights.
+    NeuralNet(const NeuralNet&) = delete;
+    NeuralNet& operator=(const NeuralNet&) = delete;
+    void feedforward(const std::vector<float>& inputs, InferenceWorkspace& workspace) const override;
+    void backpropagate(const std::vector<float>& errors, TrainingWorkspace& workspace) const override;
+    void feedforward(const std::vector<float>& inputs, int count, BatchInferenceWorkspace& workspace) const override;
+    void feedforward(const std::vector<int>& activeInputs, int activePerSample, int count,
+                     BatchInferenceWorkspace& workspace) const override;
+    void backpropagate(const std::vector<float>& errors, int count, TrainingWorkspace& workspace) const override;
+    std::vector<LayerSpecification> getTopology() const override;
+    ParameterArena& getParameters() override;
+    const ParameterArena& getParameters() const override;
     const std::vector<Layer>& getLayers();
  
 private:
+    std::vector<LayerSpecification> mTopology;
+    ParameterArena mParameters;
     std::vector<Layer> mLayers;
+    // The first layer's weights input-major for its sparse passes, rebuilt by the first of them after
+    // mParameters changes version. Evaluating threads share it, so the rebuild takes the mutex.
+    mutable std::vector<float> mInputMajorWeights;
+    mutable std::atomic<uint64_t> mInputMajorVersion {0};
+    mutable std::mutex mInputMajorMutex;
+
+    const float* getInputMajorWeights() const;
 };
 
 
@@ -0,0 +1,299 @@
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <thread>
+
+#include "neural.h"
+#include "workspace.h"
+#include "rng.h"
+#include "kernels.h"
+#include "quantized_net.h"
+#include "optimizer.h"
+#include "thread_team.h"
+
+const std::vector<LayerSpecification> TOPOLOGY {
+    {85, Activation::LINEAR},
+    {170, Activation::RELU},
+    {170, Activation::RELU},
+    {32, Activation::SOFTMAX},
+};
+
+// One training step per sample: forward pass, then backward pass into the accumulated gradients.
+void benchTrainingStep(const Network& net, int batchSize) {
+    Rng rng {1};
+    constexpr int NUM_SAMPLES = 1 << 15;
+    std::uniform_real_distribution<float> dis(0.0f, 1.0f);
+    // Ten active inputs per sample, one per block of 8.5 like the card encoding.
+    std::vector<int> activeInputs;
+    std::vector<float> inputs(batchSize * 85, 0.0f);
+    for (int r = 0; r < batchSize; r++) {
+        for (int k = 0; k < 10; k++) {
+            int index = (k * 85) / 10 + int(dis(rng) * 8);
+            activeInputs.push_back(index);
+            inputs[r * 85 + index] = 1.0f;
+        }
+    }
+    std::vector<float> errors(batchSize * 32);
+    for (float& x : errors) {
+        x = dis(rng) - 0.5f;
+    }
+
+    TrainingWorkspace workspace {TOPOLOGY};
+    std::vector<float> input(85);
+    std::vector<float> error(32);
+    auto start = std::chrono::steady_clock::now();
+    for (int step = 0; step < NUM_SAMPLES / batchSize; step++) {
+        for (int r = 0; r < batchSize; r++) {
+            std::copy_n(inputs.begin() + r * 85, 85, input.begin());
+            std::copy_n(errors.begin() + r * 32, 32, error.begin());
+            net.feedforward(input, workspace.mInferenceWorkspace);
+            net.backpropagate(error, workspace);
+        }
+    }
+    std::chrono::duration<double> single = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    for (int step = 0; step < NUM_SAMPLES / batchSize; step++) {
+        net.feedforward(inputs, batchSize, workspace.mBatchInferenceWorkspace);
+        net.backpropagate(errors, batchSize, workspace);
+    }
+    std::chrono::duration<double> batched = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    for (int step = 0; step < NUM_SAMPLES / batchSize; step++) {
+        net.feedforward(activeInputs, 10, batchSize, workspace.mBatchInferenceWorkspace);
+        net.backpropagate(errors, batchSize, workspace);
+    }
+    std::chrono::duration<double> sparse = std::chrono::steady_clock::now() - start;
+
+    std::cout << "Training step, batch " << batchSize << ": "
+              << NUM_SAMPLES / single.count() / 1e3 << " K samples/sec per sample, "
+              << NUM_SAMPLES / batched.count() / 1e3 << " K batched, "
+              << NUM_SAMPLES / sparse.count() / 1e3 << " K batched sparse (checksum "
+              << workspace.getLayerGradientNormsSquared()[0] << ")" << std::endl;
+}
+
+// Greedy evaluation throughput: sparse batched forward passes of the fp32 net against its int8 copy.
+void benchEvaluation(const Network& net, int batchSize) {
+    Rng rng {1};
+    constexpr int NUM_SAMPLES = 1 << 16;
+    std::uniform_int_distribution<int> offset(0, 7);
+    std::vector<int> activeInputs;
+    for (int r = 0; r < batchSize; r++) {
+        for (int k = 0; k < 10; k++) {
+            activeInputs.push_back((k * 85) / 10 + offset(rng));
+        }
+    }
+    QuantizedNet quantized(net);
+    BatchInferenceWorkspace workspace {TOPOLOGY};
+    std::vector<float> outputs;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int step = 0; step < NUM_SAMPLES / batchSize; step++) {
+        net.feedforward(activeInputs, 10, batchSize, workspace);
+    }
+    std::chrono::duration<double> fp32 = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    for (int step = 0; step < NUM_SAMPLES / batchSize; step++) {
+        quantized.feedforward(activeInputs, 10, batchSize, outputs);
+    }
+    std::chrono::duration<double> int8 = std::chrono::steady_clock::now() - start;
+
+    std::cout << "Evaluation, batch " << batchSize << ": "
+              << NUM_SAMPLES / fp32.count() / 1e3 << " K samples/sec fp32, "
+              << NUM_SAMPLES / int8.count() / 1e3 << " K int8 " << quantizedKernels().name
+              << " (outputs " << workspace.getOutputs()[0] << " vs " << outputs[0] << ")" << std::endl;
+}
+
+// The single-threaded end of every training batch: fold the worker gradients together, average them,
+// take a momentum step and clear them. Each is one pass over the parameter arenas.
+void benchCompletionStep(Network& net, int numWorkers) {
+    constexpr int STEPS = 2000;
+    std::vector<TrainingWorkspace> workspaces(numWorkers, TrainingWorkspace(TOPOLOGY));
+    MomentumOptimizer optimizer {&net, 0.9f};
+    auto start = std::chrono::steady_clock::now();
+    for (int step = 0; step < STEPS; step++) {
+        for (int w = 1; w < numWorkers; w++) {
+            workspaces[0].aggregate(workspaces[w]);
+        }
+        workspaces[0].batch(32);
+        optimizer.step(&net, workspaces[0], 0.0f);
+        workspaces[0].reset();
+    }
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+    std::cout << "Completion step, " << numWorkers << " workers, " << net.getParameters().size() * sizeof(float)
+              << " bytes of parameters: " << seconds.count() / STEPS * 1e6 << " us" << std::endl;
+}
+
+template <typename F>
+double nanosPerCall(F&& body) {
+    constexpr double MIN_SECONDS = 0.2;
+    long calls = 0;
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::duration<double> seconds {};
+    do {
+        for (int i = 0; i < 100; i++) {
+            body();
+        }
+        calls += 100;
+        seconds = std::chrono::steady_clock::now() - start;
+    } while (seconds.count() < MIN_SECONDS);
+    return seconds.count() / calls * 1e9;
+}
+
+template <typename F>
+double gflops(double flopsPerCall, F&& body) {
+    return flopsPerCall / nanosPerCall(body);
+}
+
+// GFLOP/s of every kernel set this CPU runs on a square hidden layer: 170 wide like today's nets,
+// 1024 for the wider ones, whose weights no longer fit in L2.
+void benchKernels(int width) {
+    const int NUM_INPUTS = width;
+    const int NUM_NEURONS = width;
+    Rng rng {2};
+    std::uniform_real_distribution<float> dis(-1.0f, 1.0f);
+    auto randomVector = [&](size_t size) {
+        std::vector<float> v(size);
+        for (float& x : v) {
+            x = dis(rng);
+        }
+        return v;
+    };
+    std::vector<float> weights = randomVector(NUM_NEURONS * NUM_INPUTS);
+    std::vector<float> biases = randomVector(NUM_NEURONS);
+    std::vector<float> gradient(NUM_NEURONS * NUM_INPUTS, 0.0f);
+    for (const NeuralKernels* kernels : supportedNeuralKernels()) {
+        for (int count : {1, 4, 32}) {
+            std::vector<float> inputs = randomVector(count * NUM_INPUTS);
+            std::vector<float> deltas = randomVector(count * NUM_NEURONS);
+            std::vector<float> outputs(count * std::max(NUM_INPUTS, NUM_NEURONS));
+            double flops = 2.0 * count * NUM_INPUTS * NUM_NEURONS;
+            double forward = gflops(flops, [&] {
+                kernels->forward(inputs.data(), count, weights.data(), biases.data(), NUM_INPUTS, NUM_NEURONS,
+                                 Epilogue::RELU, outputs.data());
+            });
+            double weightGradient = gflops(flops, [&] {
+                kernels->weightGradient(deltas.data(), inputs.data(), count, NUM_INPUTS, NUM_NEURONS, gradient.data());
+            });
+            double downstream = gflops(flops, [&] {
+                // Square, so the weights stand in for their own transpose.
+                kernels->downstream(weights.data(), deltas.data(), count, NUM_INPUTS, NUM_NEURONS, outputs.data());
+            });
+            // Half the neurons dead, as in a trained ReLU layer. Rated by the dense flops they stand in for.
+            std::vector<int> live;
+            for (int n = 0; n < NUM_NEURONS; n += 2) {
+                live.push_back(n);
+            }
+            double weightGradientLive = gflops(flops, [&] {
+                kernels->weightGradientLive(deltas.data(), inputs.data(), count, NUM_INPUTS, NUM_NEURONS,
+                                            live.data(), live.size(), gradient.data());
+            });
+            double downstreamLive = gflops(flops, [&] {
+                kernels->downstreamLive(weights.data(), deltas.data(), count, NUM_INPUTS, NUM_NEURONS,
+                                        live.data(), live.size(), outputs.data());
+            });
+            std::cout << kernels->name << " kernels, " << width << " wide, batch " << count << ": forward " << forward
+                      << ", weight gradient " << weightGradient << ", downstream " << downstream
+                      << ", half live " << weightGradientLive << " and " << downstreamLive << " GFLOP/s" << std::endl;
+        }
+        double axpy = gflops(2.0 * gradient.size(), [&] {
+            kernels->axpy(-1e-3f, weights.data(), gradient.data(), gradient.size());
+        });
+        double scaleAdd = gflops(2.0 * gradient.size(), [&] {
+            kernels->scaleAdd(0.5f, weights.data(), gradient.data(), gradient.size());
+        });
+        std::cout << kernels->name << " kernels, " << width << " wide: axpy " << axpy << ", scale add " << scaleAdd << " GFLOP/s" << std::endl;
+    }
+    std::cout << "Dispatched: " << neuralKernels().name << std::endl;
+}
+
+// Nanoseconds per call of the activations at the sizes training uses: one 32-way policy row with its
+// log-probabilities, a 256-row batch of them, a batch of the 5-neuron sigmoid head and the entropy's
+// log pass. The scalar set is libm.
+void benchActivations() {
+    Rng rng {3};
+    std::uniform_real_distribution<float> dis(-8.0f, 8.0f);
+    std::vector<float> logits(256 * 32);
+    for (float& x : logits) {
+        x = dis(rng);
+    }
+    std::vector<float> probabilities(logits.size()), logProbabilities(logits.size());
+    for (const NeuralKernels* kernels : supportedNeuralKernels()) {
+        double row = nanosPerCall([&] {
+            kernels->softmax(logits.data(), 1, 32, probabilities.data(), logProbabilities.data());
+        });
+        double batch = nanosPerCall([&] {
+            kernels->softmax(logits.data(), 256, 32, probabilities.data(), logProbabilities.data());
+        });
+        double sigmoid = nanosPerCall([&] {
+            kernels->sigmoid(logits.data(), 256 * 5, probabilities.data());
+        });
+        double log = nanosPerCall([&] {
+            kernels->log(probabilities.data(), 32, logProbabilities.data());
+        });
+        std::cout << kernels->name << " activations: softmax 32 " << row << " ns, softmax 256x32 " << batch
+                  << " ns, sigmoid 256x5 " << sigmoid << " ns, log 32 " << log << " ns" << std::endl;
+    }
+}
+
+// Microseconds per sample of a per-sample forward and backward pass through one square ReLU layer,
+// split across teams of 1, 2 and 4 threads. Below TEAM_MIN_WEIGHTS layers stay on one thread, so 256
+// shows what the check costs. The team only pays off with that many idle cores.
+void benchLayerThreads() {
+    std::cout << "Cores: " << std::thread::hardware_concurrency() << std::endl;
+    for (int width : {256, 1024, 2048, 4096}) {
+        std::vector<LayerSpecification> topology {
+            {width, Activation::LINEAR},
+            {width, Activation::RELU},
+            {32, Activation::SOFTMAX},
+        };
+        Rng rng {4};
+        NeuralNet net {topology, rng.split(1)};
+        std::uniform_real_distribution<float> dis(-1.0f, 1.0f);
+        std::vector<float> input(width), error(32);
+        for (float& x : input) {
+            x = dis(rng);
+        }
+        for (float& x : error) {
+            x = dis(rng);
+        }
+        std::cout << width << " wide, per sample:";
+        for (int threads : {1, 2, 4}) {
+            ThreadTeam team {threads};
+            TrainingWorkspace workspace {topology};
+            workspace.mInferenceWorkspace.mTeam = &team;
+            double fire = nanosPerCall([&] {
+                net.feedforward(input, workspace.mInferenceWorkspace);
+            });
+            double step = nanosPerCall([&] {
+                net.feedforward(input, workspace.mInferenceWorkspace);
+                net.backpropagate(error, workspace);
+            });
+            std::cout << " " << threads << " threads " << fire / 1000 << " us forward, " << step / 1000 << " us step;";
+        }
+        std::cout << std::endl;
+    }
+}
+
+int main() {
+    benchActivations();
+    benchKernels(170);
+    benchKernels(1024);
+    benchLayerThreads();
+    Rng rng {1};
+    NeuralNet net {TOPOLOGY, rng.split(1)};
+    for (int batchSize : {4, 16, 64}) {
+        benchTrainingStep(net, batchSize);
+    }
+    benchCompletionStep(net, 8);
+    std::cout << "Parameters: " << QuantizedNet(net).getParameterBytes() << " bytes int8, "
+              << (85 * 170 + 170 * 170 + 170 * 32 + 170 + 170 + 32) * sizeof(float) << " bytes fp32" << std::endl;
+    for (int batchSize : {1, 16, 256}) {
+        benchEvaluation(net, batchSize);
+    }
+    return 0;
+}
@@ -0,0 +1,725 @@
+#include <iostream>
+#include <cassert>
+#include <random>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include <memory>
+#include <numeric>
+#include <span>
+#include <thread>
+#include <filesystem>
+
+#include "neural.h"
+#include "static_net.h"
+#include "workspace.h"
+#include "rng.h"
+#include "kernels.h"
+#include "quantized_net.h"
+#include "optimizer.h"
+#include "thread_team.h"
+#include "checkpoint.h"
+
+std::vector<float> randomMatrix(int rows, int cols, Rng& rng) {
+    std::uniform_real_distribution<float> dis(-1.0f, 1.0f);
+    std::vector<float> m(rows * cols);
+    for (float& x : m) {
+        x = dis(rng);
+    }
+    return m;
+}
+
+// Batched passes sum every product in the same order as the per-sample ones, so they must agree exactly.
+void testBatchMatchesPerSample(const std::vector<LayerSpecification>& topology, int count) {
+    Rng rng {7};
+    NeuralNet net {topology, rng.split(1)};
+    int numInputs = topology.front().numNeurons;
+    int numOutputs = topology.back().numNeurons;
+    std::vector<float> inputs = randomMatrix(count, numInputs, rng);
+    std::vector<float> errors = randomMatrix(count, numOutputs, rng);
+
+    TrainingWorkspace single {topology};
+    std::vector<float> singleOutputs;
+    for (int r = 0; r < count; r++) {
+        std::vector<float> input(inputs.begin() + r * numInputs, inputs.begin() + (r + 1) * numInputs);
+        std::vector<float> error(errors.begin() + r * numOutputs, errors.begin() + (r + 1) * numOutputs);
+        net.feedforward(input, single.mInferenceWorkspace);
+        const std::vector<float>& output = single.getOutputs();
+        singleOutputs.insert(singleOutputs.end(), output.begin(), output.begin() + numOutputs);
+        net.backpropagate(error, single);
+    }
+
+    TrainingWorkspace batched {topology};
+    net.feedforward(inputs, count, batched.mBatchInferenceWorkspace);
+    const std::vector<float>& batchOutputs = batched.mBatchInferenceWorkspace.getOutputs();
+    for (int i = 0; i < count * numOutputs; i++) {
+        assert(batchOutputs[i] == singleOutputs[i]);
+    }
+    net.backpropagate(errors, count, batched);
+    assert(batched.mGradients == single.mGradients);
+
+    // A second, smaller batch reuses the grown buffers and keeps accumulating.
+    net.feedforward(inputs, 1, batched.mBatchInferenceWorkspace);
+    net.backpropagate(errors, 1, batched);
+    std::vector<float> input(inputs.begin(), inputs.begin() + numInputs);
+    std::vector<float> error(errors.begin(), errors.begin() + numOutputs);
+    net.feedforward(input, single.mInferenceWorkspace);
+    net.backpropagate(error, single);
+    assert(batched.mGradients == single.mGradients);
+}
+
+void testBatchedNeuralNet() {
+    std::vector<LayerSpecification> softmaxTopology {
+        {85, Activation::LINEAR},
+        {170, Activation::RELU},
+        {170, Activation::RELU},
+        {32, Activation::SOFTMAX},
+    };
+    std::vector<LayerSpecification> sigmoidTopology {
+        {85, Activation::LINEAR},
+        {37, Activation::SIGMOID},
+        {5, Activation::SIGMOID},
+    };
+    std::vector<LayerSpecification> criticTopology {
+        {85, Activation::LINEAR},
+        {85, Activation::RELU},
+        {1, Activation::LINEAR},
+    };
+    for (int count : {1, 4, 7, 64}) {
+        testBatchMatchesPerSample(softmaxTopology, count);
+        testBatchMatchesPerSample(sigmoidTopology, count);
+        testBatchMatchesPerSample(criticTopology, count);
+    }
+}
+
+// Split layers hand each thread whole sums, so a team must not change a single bit.
+void testThreadTeamMatchesSerial(const Network& net) {
+    std::vector<LayerSpecification> topology = net.getTopology();
+    Rng rng {11};
+    std::vector<float> inputs = randomMatrix(8, 85, rng);
+    std::vector<float> errors = randomMatrix(8, 32, rng);
+    for (int size : {2, 3}) {
+        ThreadTeam team {size};
+        TrainingWorkspace serial {topology};
+        TrainingWorkspace split {topology};
+        split.mInferenceWorkspace.mTeam = &team;
+        for (int r = 0; r < 8; r++) {
+            std::vector<float> input(inputs.begin() + r * 85, inputs.begin() + (r + 1) * 85);
+            std::vector<float> error(errors.begin() + r * 32, errors.begin() + (r + 1) * 32);
+            net.feedforward(input, serial.mInferenceWorkspace);
+            net.feedforward(input, split.mInferenceWorkspace);
+            assert(split.mInferenceWorkspace.getActivations() == serial.mInferenceWorkspace.getActivations());
+            net.backpropagate(error, serial);
+            net.backpropagate(error, split);
+            assert(split.mGradients == serial.mGradients);
+        }
+    }
+}
+
+void testThreadTeamMatchesSerial() {
+    using WideNet = StaticNet<Input<85>, Dense<1024, Relu>, Dense<1000, Relu>, Dense<150, Sigmoid>, Dense<32, Softmax>>;
+    Rng rng {11};
+    testThreadTeamMatchesSerial(NeuralNet {WideNet::topology(), rng.split(1)});
+    testThreadTeamMatchesSerial(*std::make_unique<WideNet>(rng.split(1)));
+
+    // Every block runs exactly once, also when several callers share the team.
+    ThreadTeam team {3};
+    std::vector<std::thread> callers;
+    std::vector<std::vector<int>> runs(4, std::vector<int>(1000));
+    for (std::vector<int>& counts : runs) {
+        callers.emplace_back([&team, &counts] {
+            for (int job = 0; job < 100; job++) {
+                team.parallelFor(10, [&counts, job](int block) { counts[job * 10 + block]++; });
+            }
+        });
+    }
+    for (std::thread& caller : callers) {
+        caller.join();
+    }
+    for (const std::vector<int>& counts : runs) {
+        assert(std::all_of(counts.begin(), counts.end(), [](int count) { return count == 1; }));
+    }
+    // A team destroyed before its workers first run still stops them.
+    for (int i = 0; i < 100; i++) {
+        ThreadTeam shortLived {4};
+    }
+}
+
+void assertClose(std::span<const float> actual, std::span<const float> expected) {
+    assert(actual.size() == expected.size());
+    for (size_t i = 0; i < actual.size(); i++) {
+        assert(std::abs(actual[i] - expected[i]) <= 1e-4f * std::max(1.0f, std::abs(expected[i])));
+    }
+}
+
+// Every kernel set this CPU runs agrees with the scalar loops up to rounding, on shapes that leave
+// partial vectors and partial tiles behind.
+void testKernelsMatchScalar() {
+    const NeuralKernels& scalar = scalarNeuralKernels();
+    Rng rng {11};
+    for (const NeuralKernels* kernels : supportedNeuralKernels()) {
+        for (int numInputs : {1, 5, 17, 85, 170}) {
+            for (int numNeurons : {1, 3, 32, 170}) {
+                for (int count : {1, 3, 4, 9}) {
+                    std::vector<float> weights = randomMatrix(numNeurons, numInputs, rng);
+                    std::vector<float> biases = randomMatrix(1, numNeurons, rng);
+                    std::vector<float> inputs = randomMatrix(count, numInputs, rng);
+                    std::vector<float> deltas = randomMatrix(count, numNeurons, rng);
+
+                    std::vector<float> expected(count * numNeurons), actual(count * numNeurons);
+                    scalar.forward(inputs.data(), count, weights.data(), biases.data(), numInputs, numNeurons,
+                                   Epilogue::NONE, expected.data());
+                    kernels->forward(inputs.data(), count, weights.data(), biases.data(), numInputs, numNeurons,
+                                     Epilogue::NONE, actual.data());
+                    assertClose(actual, expected);
+
+                    // The fused ReLU clamps the very sums the plain pass stores.
+                    std::vector<float> rectified(count * numNeurons);
+                    kernels->forward(inputs.data(), count, weights.data(), biases.data(), numInputs, numNeurons,
+                                     Epilogue::RELU, rectified.data());
+                    for (size_t k = 0; k < actual.size(); k++) {
+                        assert(rectified[k] == std::max(actual[k], 0.0f));
+                    }
+
+                    expected = randomMatrix(numNeurons, numInputs, rng);
+                    actual = expected;
+                    scalar.weightGradient(deltas.data(), inputs.data(), count, numInputs, numNeurons, expected.data());
+                    kernels->weightGradient(deltas.data(), inputs.data(), count, numInputs, numNeurons, actual.data());
+                    assertClose(actual, expected);
+
+                    // One past the end is a sentinel, partial stores must not touch it.
+                    expected.assign(count * numInputs + 1, -7.0f);
+                    actual = expected;
+                    scalar.downstream(weights.data(), deltas.data(), count, numInputs, numNeurons, expected.data());
+                    kernels->downstream(weights.data(), deltas.data(), count, numInputs, numNeurons, actual.data());
+                    assert(actual.back() == -7.0f);
+                    assertClose(actual, expected);
+
+                    // Over the odd neurons only, the live kernels give the dense results of deltas with
+                    // the even neurons zeroed, to the bit, and leave the even gradient rows alone.
+                    std::vector<int> live;
+                    for (int n = 1; n < numNeurons; n += 2) {
+                        live.push_back(n);
+                    }
+                    std::vector<float> zeroed = deltas;
+                    for (int r = 0; r < count; r++) {
+                        for (int n = 0; n < numNeurons; n += 2) {
+                            zeroed[r * numNeurons + n] = 0.0f;
+                        }
+                    }
+                    expected = randomMatrix(numNeurons, numInputs, rng);
+                    actual = expected;
+                    kernels->weightGradient(zeroed.data(), inputs.data(), count, numInputs, numNeurons, expected.data());
+                    kernels->weightGradientLive(deltas.data(), inputs.data(), count, numInputs, numNeurons,
+                                                live.data(), live.size(), actual.data());
+                    assert(actual == expected);
+                    expected.assign(count * numInputs + 1, -7.0f);
+                    actual = expected;
+                    kernels->downstream(weights.data(), zeroed.data(), count, numInputs, numNeurons, expected.data());
+                    kernels->downstreamLive(weights.data(), deltas.data(), count, numInputs, numNeurons,
+                                            live.data(), live.size(), actual.data());
+                    assert(actual == expected);
+                    scalar.downstreamLive(weights.data(), deltas.data(), count, numInputs, numNeurons,
+                                          live.data(), live.size(), expected.data());
+                    assertClose(actual, expected);
+                    // Ranges split anywhere give the bits of the whole product, with or without a live list.
+                    std::vector<float> whole = actual;
+                    int split = numInputs / 3;
+                    actual.assign(count * numInputs + 1, -7.0f);
+                    kernels->downstreamRange(weights.data(), deltas.data(), count, numInputs, numNeurons,
+                                             live.data(), live.size(), split, numInputs, actual.data());
+                    kernels->downstreamRange(weights.data(), deltas.data(), count, numInputs, numNeurons,
+                                             live.data(), live.size(), 0, split, actual.data());
+                    assert(actual == whole);
+                    kernels->downstream(weights.data(), deltas.data(), count, numInputs, numNeurons, whole.data());
+                    kernels->downstreamRange(weights.data(), deltas.data(), count, numInputs, numNeurons,
+                                             nullptr, numNeurons, 0, split, actual.data());
+                    kernels->downstreamRange(weights.data(), deltas.data(), count, numInputs, numNeurons,
+                                             nullptr, numNeurons, split, numInputs, actual.data());
+                    assert(actual == whole);
+                }
+            }
+            std::vector<float> x = randomMatrix(1, numInputs + 1, rng);
+            std::vector<float> expected = randomMatrix(1, numInputs + 1, rng);
+            std::vector<float> actual = expected;
+            scalar.axpy(-0.25f, x.data(), expected.data(), numInputs);
+            kernels->axpy(-0.25f, x.data(), actual.data(), numInputs);
+            assertClose(actual, expected);
+            scalar.scaleAdd(0.9f, x.data(), expected.data(), numInputs);
+            kernels->scaleAdd(0.9f, x.data(), actual.data(), numInputs);
+            assertClose(actual, expected);
+            assert(actual.back() == expected.back());
+        }
+    }
+    std::cout << "Neural kernels: " << neuralKernels().name << std::endl;
+}
+
+// exp and log stay within their documented error of libm, evaluated in double, and softmax and
+// sigmoid within a few roundings more. Rows and arrays are sized to leave partial vectors, with a
+// sentinel one past the end.
+void testFastMathAccuracy() {
+    Rng rng {12};
+    std::uniform_real_distribution<float> logitDis(-30.0f, 30.0f);
+    for (const NeuralKernels* kernels : supportedNeuralKernels()) {
+        std::vector<float> x;
+        for (float v = FAST_EXP_MIN; v <= FAST_EXP_MAX; v += 0.0137f) {
+            x.push_back(v);
+        }
+        std::vector<float> out(x.size() + 1, -7.0f);
+        kernels->exp(x.data(), x.size(), out.data());
+        assert(out.back() == -7.0f);
+        for (size_t i = 0; i < x.size(); i++) {
+            double expected = std::exp(double(x[i]));
+            assert(std::abs(out[i] - expected) <= FAST_EXP_MAX_ERROR * expected);
+        }
+
+        x.clear();
+        for (int e = -125; e <= 127; e++) {
+            for (float m = 1.0f; m < 2.0f; m += 0.0039f) {
+                x.push_back(std::ldexp(m, e));
+            }
+        }
+        out.assign(x.size() + 1, -7.0f);
+        kernels->log(x.data(), x.size(), out.data());
+        assert(out.back() == -7.0f);
+        for (size_t i = 0; i < x.size(); i++) {
+            double expected = std::log(double(x[i]));
+            assert(std::abs(out[i] - expected) <= FAST_LOG_MAX_ERROR * std::abs(expected));
+        }
+        std::vector<float> special {0.0f, -1.0f, INFINITY, NAN};
+        kernels->log(special.data(), special.size(), special.data());
+        assert(special[0] == -INFINITY && std::isnan(special[1]) && special[2] == INFINITY && std::isnan(special[3]));
+
+        for (int numNeurons : {1, 5, 17, 32}) {
+            int count = 3;
+            std::vector<float> logits(count * numNeurons);
+            for (float& l : logits) {
+                l = logitDis(rng);
+            }
+            std::vector<float> probabilities(logits.size() + 1, -7.0f), logProbabilities(logits.size() + 1, -7.0f);
+            kernels->softmax(logits.data(), count, numNeurons, probabilities.data(), logProbabilities.data());
+            assert(probabilities.back() == -7.0f && logProbabilities.back() == -7.0f);
+            for (int r = 0; r < count; r++) {
+                // Shifted in float like the kernels, whose rounding of logit - max is not the polynomial's.
+                const float* row = logits.data() + r * numNeurons;
+                float max = *std::max_element(row, row + numNeurons);
+                double sum = 0.0;
+                for (int n = 0; n < numNeurons; n++) {
+                    sum += std::exp(double(row[n] - max));
+                }
+                for (int n = 0; n < numNeurons; n++) {
+                    double logExpected = double(row[n] - max) - std::log(sum);
+                    double expected = std::exp(logExpected);
+                    assert(std::abs(probabilities[r * numNeurons + n] - expected) <= 1e-6 * expected);
+                    assert(std::abs(logProbabilities[r * numNeurons + n] - logExpected) <= 1e-5 * std::max(1.0, std::abs(logExpected)));
+                }
+            }
+        }
+
+        x.clear();
+        for (float v = -80.0f; v <= 80.0f; v += 0.031f) {
+            x.push_back(v);
+        }
+        out.assign(x.size() + 1, -7.0f);
+        kernels->sigmoid(x.data(), x.size(), out.data());
+        assert(out.back() == -7.0f);
+        for (size_t i = 0; i < x.size(); i++) {
+            double expected = 1.0 / (1.0 + std::exp(-double(x[i])));
+            assert(std::abs(out[i] - expected) <= 1e-6 * expected);
+        }
+    }
+}
+
+// Sparse one-hot inputs give the dense results up to rounding, and accumulate the same gradients.
+void testSparseInputs() {
+    constexpr int NUM_INPUTS = 85;
+    constexpr int ACTIVE_PER_SAMPLE = 10;
+    constexpr int COUNT = 6;
+    std::vector<LayerSpecification> topology {
+        {NUM_INPUTS, Activation::LINEAR},
+        {170, Activation::RELU},
+        {32, Activation::SOFTMAX},
+    };
+    Rng rng {13};
+    NeuralNet net {topology, rng.split(1)};
+    std::vector<int> activeInputs;
+    std::vector<float> inputs(COUNT * NUM_INPUTS, 0.0f);
+    for (int r = 0; r < COUNT; r++) {
+        // One active input out of every block of 8.5, like the card encoding.
+        for (int k = 0; k < ACTIVE_PER_SAMPLE; k++) {
+            int index = (k * NUM_INPUTS) / ACTIVE_PER_SAMPLE + (r + k) % 8;
+            activeInputs.push_back(index);
+            inputs[r * NUM_INPUTS + index] = 1.0f;
+        }
+    }
+    std::vector<float> errors = randomMatrix(COUNT, 32, rng);
+
+    TrainingWorkspace dense {topology};
+    net.feedforward(inputs, COUNT, dense.mBatchInferenceWorkspace);
+    net.backpropagate(errors, COUNT, dense);
+    TrainingWorkspace sparse {topology};
+    net.feedforward(activeInputs, ACTIVE_PER_SAMPLE, COUNT, sparse.mBatchInferenceWorkspace);
+    net.backpropagate(errors, COUNT, sparse);
+
+    std::vector<float> denseOutputs(dense.mBatchInferenceWorkspace.getOutputs().begin(),
+                                    dense.mBatchInferenceWorkspace.getOutputs().begin() + COUNT * 32);
+    std::vector<float> sparseOutputs(sparse.mBatchInferenceWorkspace.getOutputs().begin(),
+                                     sparse.mBatchInferenceWorkspace.getOutputs().begin() + COUNT * 32);
+    assertClose(sparseOutputs, denseOutputs);
+    const ParameterArena& sparseGradients = sparse.getGradients();
+    for (size_t l = 0; l < topology.size() - 1; l++) {
+        assertClose(sparseGradients.weights(l), dense.mGradients.weights(l));
+        assertClose(sparseGradients.biases(l), dense.mGradients.biases(l));
+    }
+    // Inactive inputs get no gradient at all.
+    for (int n = 0; n < 170; n++) {
+        for (int i = 0; i < NUM_INPUTS; i++) {
+            bool active = std::find(activeInputs.begin(), activeInputs.end(), i) != activeInputs.end();
+            assert(active || sparseGradients.weights(0)[n * NUM_INPUTS + i] == 0.0f);
+        }
+    }
+
+    bool threw = false;
+    try {
+        std::vector<int> outOfRange(ACTIVE_PER_SAMPLE, NUM_INPUTS);
+        net.feedforward(outOfRange, ACTIVE_PER_SAMPLE, 1, sparse.mBatchInferenceWorkspace);
+    } catch (const std::out_of_range&) {
+        threw = true;
+    }
+    assert(threw);
+}
+
+// A sparse batch gives the same bits as its samples one at a time, the pending input-major gradient
+// of several passes folds in once, and the input-major weights follow every write to the parameters.
+void testSparseInputMajor() {
+    constexpr int NUM_INPUTS = 85;
+    constexpr int ACTIVE_PER_SAMPLE = 10;
+    constexpr int COUNT = 32;
+    std::vector<LayerSpecification> topology {
+        {NUM_INPUTS, Activation::LINEAR},
+        {170, Activation::RELU},
+        {32, Activation::SOFTMAX},
+    };
+    Rng rng {17};
+    NeuralNet net {topology, rng.split(1)};
+    std::vector<int> activeInputs;
+    std::vector<float> inputs(COUNT * NUM_INPUTS, 0.0f);
+    for (int r = 0; r < COUNT; r++) {
+        for (int k = 0; k < ACTIVE_PER_SAMPLE; k++) {
+            int index = (k * NUM_INPUTS) / ACTIVE_PER_SAMPLE + (r + k) % 8;
+            activeInputs.push_back(index);
+            inputs[r * NUM_INPUTS + index] = 1.0f;
+        }
+    }
+    std::vector<float> errors = randomMatrix(COUNT, 32, rng);
+
+    TrainingWorkspace batched {topology};
+    net.feedforward(activeInputs, ACTIVE_PER_SAMPLE, COUNT, batched.mBatchInferenceWorkspace);
+    net.backpropagate(errors, COUNT, batched);
+    TrainingWorkspace single {topology};
+    for (int r = 0; r < COUNT; r++) {
+        std::vector<int> sampleInputs(activeInputs.begin() + r * ACTIVE_PER_SAMPLE,
+                                      activeInputs.begin() + (r + 1) * ACTIVE_PER_SAMPLE);
+        std::vector<float> sampleErrors(errors.begin() + r * 32, errors.begin() + (r + 1) * 32);
+        net.feedforward(sampleInputs, ACTIVE_PER_SAMPLE, 1, single.mBatchInferenceWorkspace);
+        net.backpropagate(sampleErrors, 1, single);
+        const std::vector<float>& activations = single.mBatchInferenceWorkspace.getActivations()[1];
+        for (int n = 0; n < 170; n++) {
+            assert(activations[n] == batched.mBatchInferenceWorkspace.getActivations()[1][r * 170 + n]);
+        }
+    }
+    assert(batched.getGradients() == single.getGradients());
+
+    // After an update, and after a write straight into the arena, the sparse pass still matches the
+    // dense one rather than the weights it last copied.
+    auto assertMatchesDense = [&] {
+        BatchInferenceWorkspace sparse {topology};
+        BatchInferenceWorkspace dense {topology};
+        net.feedforward(activeInputs, ACTIVE_PER_SAMPLE, COUNT, sparse);
+        net.feedforward(inputs, COUNT, dense);
+        assertClose(sparse.getActivations()[1], dense.getActivations()[1]);
+    };
+    net.update(0.5f, batched.getGradients());
+    assertMatchesDense();
+    net.getParameters().weights(0)[activeInputs[0]] += 1.0f;
+    assertMatchesDense();
+}
+
+// A StaticNet is the NeuralNet of its topology from the same stream, so through the shared Network
+// interface every pass and update must agree exactly.
+template <typename Net>
+void testStaticNetMatchesNeuralNet() {
+    constexpr int COUNT = 5;
+    constexpr int ACTIVE_PER_SAMPLE = 4;
+    std::vector<LayerSpecification> topology = Net::topology();
+    Rng rng {17};
+    std::unique_ptr<Network> nets[] = {
+        std::make_unique<NeuralNet>(topology, rng.split(1)),
+        std::make_unique<Net>(rng.split(1)),
+    };
+    assert(nets[1]->getTopology() == topology);
+    assert(nets[0]->getLayerWeightNormsSquared() == nets[1]->getLayerWeightNormsSquared());
+
+    std::vector<float> inputs = randomMatrix(COUNT, Net::NUM_INPUTS, rng);
+    std::vector<float> errors = randomMatrix(COUNT, Net::NUM_OUTPUTS, rng);
+    std::vector<int> activeInputs;
+    for (int k = 0; k < COUNT * ACTIVE_PER_SAMPLE; k++) {
+        activeInputs.push_back((k * 7) % Net::NUM_INPUTS);
+    }
+    std::vector<float> input(inputs.begin(), inputs.begin() + Net::NUM_INPUTS);
+    std::vector<float> error(errors.begin(), errors.begin() + Net::NUM_OUTPUTS);
+
+    std::vector<std::unique_ptr<TrainingWorkspace>> workspaces;
+    for (std::unique_ptr<Network>& net : nets) {
+        workspaces.push_back(std::make_unique<TrainingWorkspace>(topology));
+        TrainingWorkspace& workspace = *workspaces.back();
+        net->feedforward(input, workspace.mInferenceWorkspace);
+        net->backpropagate(error, workspace);
+        net->feedforward(inputs, COUNT, workspace.mBatchInferenceWorkspace);
+        net->backpropagate(errors, COUNT, workspace);
+        net->feedforward(activeInputs, ACTIVE_PER_SAMPLE, COUNT, workspace.mBatchInferenceWorkspace);
+        net->backpropagate(errors, COUNT, workspace);
+        net->update(0.1f, workspace.getGradients());
+        net->feedforward(inputs, COUNT, workspace.mBatchInferenceWorkspace);
+    }
+    assert(workspaces[0]->getOutputs() == workspaces[1]->getOutputs());
+    assert(workspaces[0]->mBatchInferenceWorkspace.getOutputs() == workspaces[1]->mBatchInferenceWorkspace.getOutputs());
+    assert(workspaces[0]->mGradients == workspaces[1]->mGradients);
+    assert(nets[0]->getParameters() == nets[1]->getParameters());
+}
+
+void testStaticNet() {
+    testStaticNetMatchesNeuralNet<StaticNet<Input<85>, Dense<170, Relu>, Dense<170, Relu>, Dense<32, Softmax>>>();
+    testStaticNetMatchesNeuralNet<StaticNet<Input<85>, Dense<37, Sigmoid>, Dense<5, Sigmoid>>>();
+    testStaticNetMatchesNeuralNet<StaticNet<Input<85>, Dense<85, Relu>, Dense<1, Linear>>>();
+}
+
+// Every block starts on a cache line and the padding between blocks stays zero through a training
+// step, so whole-arena passes never leak into it.
+void testParameterArena() {
+    std::vector<LayerSpecification> topology {
+        {85, Activation::LINEAR},
+        {37, Activation::RELU},
+        {5, Activation::SIGMOID},
+    };
+    Rng rng {23};
+    NeuralNet net {topology, rng.split(1)};
+    ParameterArena& parameters = net.getParameters();
+    assert(parameters.getNumLayers() == 2);
+    assert(parameters.weights(0).size() == 85 * 37 && parameters.biases(1).size() == 5);
+    for (int l = 0; l < parameters.getNumLayers(); l++) {
+        for (std::span<float> block : {parameters.weights(l), parameters.biases(l)}) {
+            assert(reinterpret_cast<uintptr_t>(block.data()) % ARENA_ALIGNMENT == 0);
+        }
+    }
+    assert(parameters.size() * sizeof(float) % ARENA_ALIGNMENT == 0);
+
+    TrainingWorkspace workspace {topology}, other {topology};
+    assert(workspace.mGradients.hasLayoutOf(parameters));
+    std::vector<float> inputs = randomMatrix(4, 85, rng);
+    std::vector<float> errors = randomMatrix(4, 5, rng);
+    for (TrainingWorkspace* w : {&workspace, &other}) {
+        net.feedforward(inputs, 4, w->mBatchInferenceWorkspace);
+        net.backpropagate(errors, 4, *w);
+    }
+    workspace.aggregate(other);
+    workspace.batch(8);
+    ParameterArena before = parameters;
+    assert(before == parameters && before.data() != parameters.data());
+    MomentumOptimizer optimizer {&net, 0.9f};
+    optimizer.step(&net, workspace, 0.1f);
+    assert(!(before == parameters));
+
+    // Blanking every block must leave nothing behind.
+    for (ParameterArena arena : {parameters, workspace.mGradients}) {
+        for (int l = 0; l < arena.getNumLayers(); l++) {
+            std::fill(arena.weights(l).begin(), arena.weights(l).end(), 0.0f);
+            std::fill(arena.biases(l).begin(), arena.biases(l).end(), 0.0f);
+        }
+        assert(arena == ParameterArena(topology));
+    }
+
+    workspace.reset();
+    assert(workspace.getLayerGradientNormsSquared() == std::vector<double>(2, 0.0));
+}
+
+// A loaded checkpoint restores parameters, optimizer state and RNG positions bit for bit, and a
+// checkpoint of another layout is rejected without touching anything.
+void testCheckpoint() {
+    std::string path = (std::filesystem::temp_directory_path() / "neural_test_checkpoint.ckpt").string();
+    std::vector<LayerSpecification> topology {
+        {85, Activation::LINEAR},
+        {37, Activation::RELU},
+        {5, Activation::SIGMOID},
+    };
+    Rng rng {29};
+    NeuralNet net {topology, rng.split(1)};
+    MomentumOptimizer optimizer {&net, 0.9f};
+    TrainingWorkspace workspace {topology};
+    net.feedforward(randomMatrix(4, 85, rng), 4, workspace.mBatchInferenceWorkspace);
+    net.backpropagate(randomMatrix(4, 5, rng), 4, workspace);
+    workspace.batch(4);
+    optimizer.step(&net, workspace, 0.1f);
+    Rng stream = rng.split(2);
+    stream.discard(1000);
+
+    CheckpointContents contents {1234, {&net.getParameters(), optimizer.getState(), nullptr}, {&stream}, {}};
+    contents.counters = {7, 700, 1.5, 2.5, 3.5};
+    saveCheckpoint(path, contents);
+    ParameterArena parameters = net.getParameters();
+    ParameterArena velocity = *optimizer.getState();
+    uint64_t next = stream();
+
+    NeuralNet other {topology, rng.split(3)};
+    MomentumOptimizer otherOptimizer {&other, 0.9f};
+    Rng otherStream {1};
+    CheckpointContents loaded {1234, {&other.getParameters(), otherOptimizer.getState(), nullptr}, {&otherStream}, {}};
+    CheckpointCounters counters = loadCheckpoint(path, loaded);
+    assert(other.getParameters() == parameters && *otherOptimizer.getState() == velocity);
+    assert(otherStream() == next);
+    assert(counters.numBatches == 7 && counters.iterations == 700 && counters.trainingSeconds == 3.5);
+
+    NeuralNet wider {{{85, Activation::LINEAR}, {38, Activation::RELU}, {5, Activation::SIGMOID}}, rng.split(4)};
+    ParameterArena untouched = wider.getParameters();
+    for (CheckpointContents mismatched : {CheckpointContents {1234, {&wider.getParameters(), nullptr, nullptr}, {&otherStream}, {}},
+                                          CheckpointContents {4321, loaded.arenas, loaded.rngs, {}}}) {
+        bool threw = false;
+        try {
+            loadCheckpoint(path, mismatched);
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+        assert(threw);
+    }
+    assert(wider.getParameters() == untouched);
+    std::filesystem::remove(path);
+}
+
+// Every quantized kernel set gives the scalar products bit for bit, also at the extremes of both
+// operands, and dequantizes them the same up to rounding.
+void testQuantizedKernelsMatchScalar() {
+    const QuantizedKernels& scalar = *supportedQuantizedKernels().front();
+    Rng rng {13};
+    std::uniform_int_distribution<int> activation(0, QUANTIZED_ACTIVATION_MAX);
+    std::uniform_int_distribution<int> weight(-127, 127);
+    for (const QuantizedKernels* kernels : supportedQuantizedKernels()) {
+        for (int numInputs : {QUANTIZED_ALIGNMENT, 3 * QUANTIZED_ALIGNMENT}) {
+            for (int numNeurons : {1, 3, 5, 17, 32}) {
+                for (int count : {1, 3}) {
+                    std::vector<uint8_t> inputs(count * numInputs);
+                    std::vector<int8_t> weights(numNeurons * numInputs);
+                    for (uint8_t& x : inputs) {
+                        x = activation(rng);
+                    }
+                    for (int8_t& w : weights) {
+                        w = weight(rng);
+                    }
+                    std::fill_n(inputs.begin(), numInputs, QUANTIZED_ACTIVATION_MAX);
+                    std::fill_n(weights.begin(), numInputs, -127);
+                    std::vector<int32_t> expected(count * numNeurons), actual(count * numNeurons);
+                    scalar.product(inputs.data(), count, weights.data(), numInputs, numNeurons, expected.data());
+                    kernels->product(inputs.data(), count, weights.data(), numInputs, numNeurons, actual.data());
+                    assert(actual == expected);
+
+                    std::vector<float> rowScales = randomMatrix(1, count, rng);
+                    std::vector<float> scales = randomMatrix(1, numNeurons, rng);
+                    std::vector<float> biases = randomMatrix(1, numNeurons, rng);
+                    for (Epilogue epilogue : {Epilogue::NONE, Epilogue::RELU}) {
+                        // One past the end is a sentinel, partial stores must not touch it.
+                        std::vector<float> scalarOutputs(count * numNeurons + 1, -7.0f);
+                        std::vector<float> outputs = scalarOutputs;
+                        scalar.dequantize(expected.data(), count, numNeurons, rowScales.data(), scales.data(),
+                                          biases.data(), epilogue, scalarOutputs.data());
+                        kernels->dequantize(expected.data(), count, numNeurons, rowScales.data(), scales.data(),
+                                            biases.data(), epilogue, outputs.data());
+                        assert(outputs.back() == -7.0f);
+                        assertClose(outputs, scalarOutputs);
+                    }
+                }
+            }
+        }
+    }
+    std::cout << "Quantized kernels: " << quantizedKernels().name << std::endl;
+}
+
+// The int8 copy stays close to the fp32 net and almost always picks the same greedy action.
+void testQuantizedNet() {
+    constexpr int COUNT = 500;
+    constexpr int ACTIVE_PER_SAMPLE = 10;
+    std::vector<LayerSpecification> topologies[] = {
+        {{85, Activation::LINEAR}, {170, Activation::RELU}, {170, Activation::RELU}, {32, Activation::SOFTMAX}},
+        {{85, Activation::LINEAR}, {170, Activation::RELU}, {170, Activation::RELU}, {5, Activation::SIGMOID}},
+    };
+    Rng rng {19};
+    std::uniform_int_distribution<int> index(0, 84);
+    for (const std::vector<LayerSpecification>& topology : topologies) {
+        NeuralNet net(topology, rng.split(1));
+        QuantizedNet quantized(net);
+        int numOutputs = topology.back().numNeurons;
+        assert(quantized.getNumOutputs() == numOutputs);
+        assert(quantized.getParameterBytes() < (85 * 170 + 170 * 170 + 170 * numOutputs) * sizeof(float) / 3);
+
+        std::vector<int> activeInputs(COUNT * ACTIVE_PER_SAMPLE);
+        for (int& i : activeInputs) {
+            i = index(rng);
+        }
+        std::iota(activeInputs.begin(), activeInputs.begin() + ACTIVE_PER_SAMPLE, 0); // Distinct, as in a hand.
+        BatchInferenceWorkspace workspace(topology);
+        net.feedforward(activeInputs, ACTIVE_PER_SAMPLE, COUNT, workspace);
+        std::vector<float> outputs;
+        quantized.feedforward(activeInputs, ACTIVE_PER_SAMPLE, COUNT, outputs);
+        assert(outputs.size() == size_t(COUNT * numOutputs));
+        int agreements = 0;
+        for (int r = 0; r < COUNT; r++) {
+            const float* expected = workspace.getOutputs().data() + r * numOutputs;
+            const float* actual = outputs.data() + r * numOutputs;
+            for (int n = 0; n < numOutputs; n++) {
+                assert(std::abs(actual[n] - expected[n]) < 0.02f);
+            }
+            agreements += std::max_element(actual, actual + numOutputs) - actual
+                          == std::max_element(expected, expected + numOutputs) - expected;
+        }
+        assert(agreements > COUNT * 9 / 10);
+
+        // A dense one-hot row matches its sparse form up to rounding of the input scale.
+        std::vector<float> input(85, 0.0f), dense;
+        for (int k = 0; k < ACTIVE_PER_SAMPLE; k++) {
+            input[activeInputs[k]] = 1.0f;
+        }
+        quantized.feedforward(input, dense);
+        for (int n = 0; n < numOutputs; n++) {
+            assert(std::abs(dense[n] - outputs[n]) < 1e-4f);
+        }
+    }
+
+    // A LINEAR hidden layer can go negative, which the unsigned activations can not hold.
+    NeuralNet linear({{85, Activation::LINEAR}, {10, Activation::LINEAR}, {5, Activation::SIGMOID}}, rng);
+    bool threw = false;
+    try {
+        QuantizedNet quantized(linear);
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+}
+
+void run_tests() {
+    testParameterArena();
+    testCheckpoint();
+    testQuantizedKernelsMatchScalar();
+    testQuantizedNet();
+    testSparseInputs();
+    testSparseInputMajor();
+    testStaticNet();
+    testKernelsMatchScalar();
+    testFastMathAccuracy();
+    testBatchedNeuralNet();
+    testThreadTeamMatchesSerial();
+    std::cout << "All neural tests passed!" << std::endl;
+}
+
+int main() {
+    run_tests();
+    return 0;
+}
@@ -11,20 +11,22 @@ enum OptimizerType {
 class Optimizer {
 public:
     virtual ~Optimizer() = default;
-    virtual void step(NeuralNet* net, TrainingWorkspace& trainer, float learningRate) = 0;
+    virtual void step(Network* net, TrainingWorkspace& trainer, float learningRate) = 0;
+    // State carried from step to step, laid out like the net's parameters, or null if there is none.
+    virtual ParameterArena* getState() { return nullptr; }
 };
 
 class SDGOptimizer : public Optimizer {
-    virtual void step(NeuralNet* net, TrainingWorkspace& trainer, float learningRate) override;
+    virtual void step(Network* net, TrainingWorkspace& trainer, float learningRate) override;
 };
 
 class MomentumOptimizer : public Optimizer {
 public:
-    MomentumOptimizer(NeuralNet* net, float beta);
-    virtual void step(NeuralNet* net, TrainingWorkspace& trainer, float learningRate) override;
+    MomentumOptimizer(Network* net, float beta);
+    virtual void step(Network* net, TrainingWorkspace& trainer, float learningRate) override;
+    ParameterArena* getState() override { return &mVelocity; }
 
 private:
     float mBeta;
-    std::vector<std::vector<float>> mWeightVelocity;
-    std::vector<std::vector<float>> mBiasVelocity;
+    ParameterArena mVelocity;
 };
@@ -0,0 +1,163 @@
+#include "parameter_arena.h"
+
+#include "neural.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+constexpr size_t FLOATS_PER_LINE = ARENA_ALIGNMENT / sizeof(float);
+
+size_t roundUp(size_t value, size_t multiple) {
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+} // namespace
+
+ParameterArena::ParameterArena(const std::vector<LayerSpecification>& topology) {
+    for (size_t l = 1; l < topology.size(); l++) {
+        Block block;
+        block.numWeights = size_t(topology[l - 1].numNeurons) * topology[l].numNeurons;
+        block.numBiases = topology[l].numNeurons;
+        block.weightOffset = mSize;
+        block.biasOffset = block.weightOffset + roundUp(block.numWeights, FLOATS_PER_LINE);
+        mSize = block.biasOffset + roundUp(block.numBiases, FLOATS_PER_LINE);
+        mBlocks.push_back(block);
+    }
+    mData.reset(allocate(mSize));
+}
+
+ParameterArena::ParameterArena(const ParameterArena& other)
+        : mBlocks(other.mBlocks),
+          mSize(other.mSize),
+          mData(allocate(other.mSize)) {
+    std::copy_n(other.data(), mSize, data());
+}
+
+ParameterArena& ParameterArena::operator=(const ParameterArena& other) {
+    if (this != &other) {
+        if (!hasLayoutOf(other)) {
+            mData.reset(allocate(other.mSize));
+            mBlocks = other.mBlocks;
+            mSize = other.mSize;
+        }
+        std::copy_n(other.data(), mSize, data());
+    }
+    return *this;
+}
+
+ParameterArena::ParameterArena(ParameterArena&& other) noexcept
+        : mBlocks(std::move(other.mBlocks)),
+          mSize(std::exchange(other.mSize, 0)),
+          mData(std::move(other.mData)) {
+    other.mBlocks.clear();
+}
+
+ParameterArena& ParameterArena::operator=(ParameterArena&& other) noexcept {
+    mBlocks = std::move(other.mBlocks);
+    other.mBlocks.clear();
+    mSize = std::exchange(other.mSize, 0);
+    mData = std::move(other.mData);
+    mVersion++;
+    return *this;
+}
+
+int ParameterArena::getNumLayers() const {
+    return mBlocks.size();
+}
+
+std::span<float> ParameterArena::weights(int layer) {
+    const Block& block = mBlocks.at(layer);
+    return {data() + block.weightOffset, block.numWeights};
+}
+
+std::span<const float> ParameterArena::weights(int layer) const {
+    const Block& block = mBlocks.at(layer);
+    return {data() + block.weightOffset, block.numWeights};
+}
+
+std::span<float> ParameterArena::biases(int layer) {
+    const Block& block = mBlocks.at(layer);
+    return {data() + block.biasOffset, block.numBiases};
+}
+
+std::span<const float> ParameterArena::biases(int layer) const {
+    const Block& block = mBlocks.at(layer);
+    return {data() + block.biasOffset, block.numBiases};
+}
+
+float* ParameterArena::data() {
+    mVersion++;
+    return mData.get();
+}
+
+const float* ParameterArena::data() const {
+    return mData.get();
+}
+
+uint64_t ParameterArena::getVersion() const {
+    return mVersion;
+}
+
+size_t ParameterArena::size() const {
+    return mSize;
+}
+
+void ParameterArena::zero() {
+    std::fill_n(data(), mSize, 0.0f);
+}
+
+bool ParameterArena::operator==(const ParameterArena& other) const {
+    return hasLayoutOf(other) && (mSize == 0 || std::memcmp(data(), other.data(), mSize * sizeof(float)) == 0);
+}
+
+bool ParameterArena::hasLayoutOf(const ParameterArena& other) const {
+    return mBlocks == other.mBlocks;
+}
+
+std::vector<double> ParameterArena::getLayerNormsSquared() const {
+    std::vector<double> ret;
+    for (int l = 0; l < getNumLayers(); l++) {
+        double sum = 0.0;
+        for (float b : biases(l)) {
+            sum += b * b;
+        }
+        for (float w : weights(l)) {
+            sum += w * w;
+        }
+        ret.push_back(sum);
+    }
+    return ret;
+}
+
+void ParameterArena::Free::operator()(float* data) const {
+    std::free(data);
+}
+
+float* ParameterArena::allocate(size_t size) {
+    if (size == 0) {
+        return nullptr;
+    }
+    size_t bytes = roundUp(size * sizeof(float), ARENA_ALIGNMENT);
+    size_t alignment = bytes >= HUGE_PAGE_SIZE ? HUGE_PAGE_SIZE : ARENA_ALIGNMENT;
+    bytes = roundUp(bytes, alignment);
+    void* data = std::aligned_alloc(alignment, bytes);
+    if (data == nullptr) {
+        throw std::bad_alloc();
+    }
+#ifdef __linux__
+    if (alignment == HUGE_PAGE_SIZE) {
+        madvise(data, bytes, MADV_HUGEPAGE); // Only advice, small pages still work.
+    }
+#endif
+    std::memset(data, 0, bytes);
+    return static_cast<float*>(data);
+}
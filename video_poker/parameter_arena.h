@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+struct LayerSpecification;
+
+// Every block of an arena starts on a cache line, as does the buffer itself.
+constexpr size_t ARENA_ALIGNMENT = 64;
+// Arenas at least this large are aligned to it and advised onto transparent huge pages.
+constexpr size_t HUGE_PAGE_SIZE = 2 << 20;
+
+// One zero-initialized float buffer holding the weights and biases of every layer of a topology,
+// each in its own block padded to a multiple of ARENA_ALIGNMENT bytes. Nets keep their parameters in
+// one, workspaces their gradients and the optimizers their state. Arenas of the same topology share
+// a layout, so whole-model operations are one pass over data() and a checkpoint is one memcpy. The
+// padding is zero and stays zero under any elementwise operation between arenas.
+class ParameterArena {
+public:
+    ParameterArena() = default;
+    explicit ParameterArena(const std::vector<LayerSpecification>& topology);
+    ParameterArena(const ParameterArena& other);
+    ParameterArena& operator=(const ParameterArena& other);
+    ParameterArena(ParameterArena&& other) noexcept;
+    ParameterArena& operator=(ParameterArena&& other) noexcept;
+
+    int getNumLayers() const;
+    // Row-major numNeurons x numInputs weights and the biases of layer l. Throws std::out_of_range.
+    std::span<float> weights(int layer);
+    std::span<const float> weights(int layer) const;
+    std::span<float> biases(int layer);
+    std::span<const float> biases(int layer) const;
+    // All size() floats, padding included.
+    float* data();
+    const float* data() const;
+    // Changes whenever the contents may have: every non-const accessor and every assignment bumps it,
+    // so anything derived from an arena can tell when it is stale. A write through a span or pointer
+    // kept from an earlier accessor call is not seen, so writers take a fresh one.
+    uint64_t getVersion() const;
+    size_t size() const;
+    void zero();
+    // Same layout and the same bits, padding included.
+    bool operator==(const ParameterArena& other) const;
+    bool hasLayoutOf(const ParameterArena& other) const;
+    // Sum of squares of each layer's biases and weights.
+    std::vector<double> getLayerNormsSquared() const;
+
+private:
+    struct Block {
+        size_t weightOffset;
+        size_t numWeights;
+        size_t biasOffset;
+        size_t numBiases;
+
+        bool operator==(const Block& other) const = default;
+    };
+    struct Free {
+        void operator()(float* data) const;
+    };
+
+    std::vector<Block> mBlocks;
+    size_t mSize = 0;
+    std::unique_ptr<float[], Free> mData;
+    uint64_t mVersion = 1;
+
+    static float* allocate(size_t size);
+};
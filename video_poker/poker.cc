@@ -1,24 +1,40 @@
 #include "poker.h"
+#include "evaluator.h"
+#include "stratified_dealer.h"
 
 #include <algorithm>
 #include <array>
 #include <stdexcept>
 
-//Card::Card(Suit suit, int rank) : suit(suit), rank(rank) {}
-
 bool operator==(const Card& lhs, const Card& rhs) {
-    return lhs.suit == rhs.suit && lhs.rank == rhs.rank;
+    return lhs.index == rhs.index;
 }
 
 bool operator!=(const Card& lhs, const Card& rhs) {
     return !(lhs == rhs);
 }
 
+ExchangeMask toExchangeMask(const std::vector<bool>& exchanges) {
+    ExchangeMask mask = 0;
+    for (size_t i = 0; i < exchanges.size(); i++) {
+        mask |= exchanges[i] << i;
+    }
+    return mask;
+}
+
+std::vector<bool> toExchangeVector(ExchangeMask exchanges) {
+    std::vector<bool> ret(5);
+    for (int i = 0; i < 5; i++) {
+        ret[i] = (exchanges >> i) & 1;
+    }
+    return ret;
+}
+
 std::ostream& operator<<(std::ostream& os, const Card& card) {
-    if (card.rank >= 2 && card.rank <= 9) {
-        os << card.rank;
+    if (card.rank() >= 2 && card.rank() <= 9) {
+        os << card.rank();
     } else {
-        switch (card.rank) {
+        switch (card.rank()) {
             case 10:
                 os << "T";
                 break;
@@ -36,7 +52,7 @@ std::ostream& operator<<(std::ostream& os, const Card& card) {
                 break;
         }
     }
-    switch (card.suit) {
+    switch (card.suit()) {
         case CLUB:
             os << "♣"; // \u2663
             break;
@@ -53,25 +69,51 @@ std::ostream& operator<<(std::ostream& os, const Card& card) {
     return os;
 }
 
-Deck::Deck(std::mt19937& rng) : mRandomGenerator(rng) {
-    mDeck.reserve(52);
+Deck::Deck(Rng& rng, ShuffleMode mode) : mRandomGenerator(rng), mMode(mode) {
+    int i = 0;
     for (int s = 0; s < 4; s++) {
         for (int r = 2 ; r <= 14; r++) {
-            mDeck.emplace_back(Card {static_cast<Suit>(s), r});
+            mDeck[i++] = Card {static_cast<Suit>(s), r};
         }
     }
 }
 
 void Deck::shuffle() {
-    std::shuffle(mDeck.begin(), mDeck.end(), mRandomGenerator);
+    if (mMode == ShuffleMode::FULL) {
+        std::shuffle(mDeck.begin(), mDeck.end(), mRandomGenerator);
+    } else {
+        mDrawRandom = true;
+    }
     mIndex = 0;
 }
 
 Card Deck::draw() {
-    // TODO: implement draw
+    if (mDrawRandom) {
+        std::uniform_int_distribution<int> remaining {mIndex, int(mDeck.size()) - 1};
+        std::swap(mDeck.at(mIndex), mDeck[remaining(mRandomGenerator)]);
+    }
     return mDeck.at(mIndex++);
 }
 
+void Deck::redraw(int position) {
+    if (mMode == ShuffleMode::FULL) {
+        std::shuffle(mDeck.begin() + position, mDeck.end(), mRandomGenerator);
+    }
+    mIndex = position;
+}
+
+void Deck::shuffleRest(const Hand& dealt) {
+    for (int i = 0; i < 5; i++) {
+        std::swap(mDeck[i], *std::find(mDeck.begin() + i, mDeck.end(), dealt[i]));
+    }
+    if (mMode == ShuffleMode::FULL) {
+        std::shuffle(mDeck.begin() + 5, mDeck.end(), mRandomGenerator);
+    } else {
+        mDrawRandom = true;
+    }
+    mIndex = 5;
+}
+
 bool Deck::operator==(const Deck& other) const {
     return mDeck == other.mDeck && mIndex == other.mIndex;
 }
@@ -88,6 +130,10 @@ const Card& Hand::operator[](int index) const {
     return mHand[index];
 }
 
+uint64_t Hand::mask() const {
+    return mHand[0].mask() | mHand[1].mask() | mHand[2].mask() | mHand[3].mask() | mHand[4].mask();
+}
+
 std::ostream& operator<<(std::ostream& os, const Hand& hand) {
     for (int i = 0; i < 5; i++) {
         os << hand[i] << " ";
@@ -95,10 +141,33 @@ std::ostream& operator<<(std::ostream& os, const Hand& hand) {
     return os;
 }
 
+void encodeHand(const Hand& hand, float* out) {
+    for (int i = 0; i < 5; i++) {
+        out[(i*ENCODED_CARD_SIZE)+hand[i].suit()] = 1.0f;
+        out[(i*ENCODED_CARD_SIZE)+4+(hand[i].rank()-2)] = 1.0f;
+    }
+}
+
+void encodeHandIndices(const Hand& hand, int* out) {
+    for (int i = 0; i < 5; i++) {
+        out[2*i] = (i*ENCODED_CARD_SIZE)+hand[i].suit();
+        out[2*i+1] = (i*ENCODED_CARD_SIZE)+4+(hand[i].rank()-2);
+    }
+}
+
+VideoPoker::VideoPoker(Rng& rng, ShuffleMode mode, GameVariant variant)
+        : mTables(&getGameTables(variant)),
+          mDeck(rng, mode),
+          mRandomGenerator(rng) {}
 
 const Hand& VideoPoker::deal() {
     if (mInProgress) throw std::runtime_error("Deal called while hand already in progress");
     mInProgress = true;
+    if (mDealer != nullptr) {
+        mWeight = mDealer->deal(mHand, mRandomGenerator);
+        mDeck.shuffleRest(mHand);
+        return mHand;
+    }
     mDeck.shuffle();
     for (int i = 0; i < 5; i++) {
         mHand[i] = mDeck.draw();
@@ -106,90 +175,52 @@ const Hand& VideoPoker::deal() {
     return mHand;
 }
 
-const Hand& VideoPoker::exchange(const std::vector<bool>& ex) {
+void VideoPoker::setDealer(const StratifiedDealer* dealer) {
+    mDealer = dealer;
+    mWeight = 1.0f;
+}
+
+float VideoPoker::getWeight() const {
+    return mWeight;
+}
+
+const Hand& VideoPoker::exchange(ExchangeMask ex) {
     if (!mInProgress) throw std::runtime_error("Exchange called while and not in progress.");
     mInProgress = false;
-    if (ex[0]) mHand[0] = mDeck.draw();
-    if (ex[1]) mHand[1] = mDeck.draw();
-    if (ex[2]) mHand[2] = mDeck.draw();
-    if (ex[3]) mHand[3] = mDeck.draw();
-    if (ex[4]) mHand[4] = mDeck.draw();
+    for (int i = 0; i < 5; i++) {
+        if ((ex >> i) & 1) mHand[i] = mDeck.draw();
+    }
     return mHand;
 }
 
-PokerHand VideoPoker::getHandType(const Hand& hand) {
+const Hand& VideoPoker::exchange(const std::vector<bool>& ex) {
+    return exchange(toExchangeMask(ex));
+}
 
-    bool hasFlush = true;
-    Suit firstSuit = hand[0].suit;
-    std::array<int, 13> counts{};
-    for (int i=0; i < 5; i++) {
-        if (hand[i].suit != firstSuit) hasFlush = false;
-        counts[hand[i].rank-2]++;
-    }
-
-    bool hasPair = false;
-    bool hasTwoPair = false;
-    bool hasThree = false;
-    bool hasStraight = false;
-    bool hasFour = false;
-    bool hasHighPair = false;
-    int cardsToStraight = 0;
-    int cardsSeen = 0;
-    for (int i=0; i<13; i++) {
-        int n = counts[i];
-        if (n == 1) {
-            cardsToStraight += 1;
-        } else {
-            cardsToStraight = 0;
-        }
-        if (cardsToStraight == 5) hasStraight = true;
-        if (n == 4) hasFour = true;
-        if (n == 3) hasThree = true;
-        if (n == 2) {
-            if (hasPair) hasTwoPair = true;
-            hasPair = true;
-            if (i >= 9) hasHighPair = true;
-        }
-        cardsSeen += n;
-        if (cardsToStraight == 4 && i == 3 && counts[12] == 1) {
-            // Special case, ace low straight.
-            hasStraight = true;
-            break;
+const std::vector<Hand>& VideoPoker::exchange(ExchangeMask ex, int numPlays) {
+    if (!mInProgress) throw std::runtime_error("Exchange called while and not in progress.");
+    mInProgress = false;
+    Hand dealt = mHand;
+    mPlays.clear();
+    for (int p = 0; p < numPlays; p++) {
+        mDeck.redraw(5);
+        mHand = dealt;
+        for (int i = 0; i < 5; i++) {
+            if ((ex >> i) & 1) mHand[i] = mDeck.draw();
         }
+        mPlays.push_back(mHand);
     }
+    return mPlays;
+}
 
-    if (hasFlush && hasStraight) {
-        if (counts[8] == 1 && counts[12] == 1) return PokerHand::ROYAL_FLUSH;
-        else return PokerHand::STRAIGHT_FLUSH;
-    }
-    if (hasFlush) return PokerHand::FLUSH;
-    if (hasStraight) return PokerHand::STRAIGHT;
-    if (hasFour) return PokerHand::FOUR_OF_A_KIND;
-    if (hasThree) {
-        if (hasPair) return PokerHand::FULL_HOUSE;
-        else return PokerHand::THREE_OF_A_KIND;
-    }
-    if (hasTwoPair) return PokerHand::TWO_PAIR;
-    if (hasHighPair) return PokerHand::HIGH_PAIR;
-    if (hasPair) return PokerHand::PAIR;
-    return PokerHand::HIGH_CARD;
-}
-
-int VideoPoker::score(PokerHand handType) {
-    switch(handType) {
-        // case PokerHand::ROYAL_FLUSH: return 800;
-        case PokerHand::ROYAL_FLUSH: return 12;
-        // case PokerHand::STRAIGHT_FLUSH: return 40;
-        case PokerHand::STRAIGHT_FLUSH: return 12;
-        case PokerHand::FOUR_OF_A_KIND: return 20;
-        case PokerHand::FULL_HOUSE: return 9;
-        case PokerHand::FLUSH: return 6;
-        case PokerHand::STRAIGHT: return 5;
-        case PokerHand::THREE_OF_A_KIND: return 3;
-        case PokerHand::TWO_PAIR: return 2;
-        case PokerHand::HIGH_PAIR: return 1;
-        case PokerHand::PAIR: return 0;
-        case PokerHand::HIGH_CARD: return 0;
-        default: throw std::runtime_error("Invalid Hand");
-    }
-}
\ No newline at end of file
+PokerHand VideoPoker::getHandType(const Hand& hand) {
+    return evaluateHand(hand.mask(), *mTables);
+}
+
+void VideoPoker::getHandTypes(const std::vector<Hand>& hands, std::vector<PokerHand>& out) {
+    evaluateHands(hands, out, *mTables);
+}
+
+int VideoPoker::score(PokerHand handType) const {
+    return mTables->paytable[handType];
+}
@@ -2,9 +2,12 @@
 
 #include <vector>
 #include <array>
+#include <cstdint>
 #include <ostream>
 #include <random>
 
+#include "rng.h"
+
 enum Suit {
     CLUB,
     DIAMOND,
@@ -23,30 +26,86 @@ enum PokerHand {
     FULL_HOUSE,
     FOUR_OF_A_KIND,
     STRAIGHT_FLUSH,
+    // Wild card hands, only dealt by variants with a wild rank.
+    FIVE_OF_A_KIND,
+    WILD_ROYAL_FLUSH,
+    FOUR_DEUCES,
     ROYAL_FLUSH
 };
 
+constexpr int NUM_POKER_HANDS = ROYAL_FLUSH + 1;
+
+// Rule sets the engine can be built for, see variants.h.
+enum class GameVariant {
+    NO_ROYAL,
+    JACKS_OR_BETTER,
+    DEUCES_WILD
+};
+
+constexpr GameVariant DEFAULT_VARIANT = GameVariant::NO_ROYAL;
+
+struct GameTables;
+class StratifiedDealer;
+
+// A card packed into its 6-bit deck index, (rank - 2) * 4 + suit. Bit `index` of a 64-bit hand mask
+// is the card's position in the mask, so each rank owns one nibble.
 struct Card {
-    Suit suit;
-    int rank;
+    uint8_t index = 0;
+
+    constexpr Card() = default;
+    constexpr Card(Suit suit, int rank) : index(static_cast<uint8_t>((rank - 2) * 4 + suit)) {}
+    static constexpr Card fromIndex(int index) {
+        Card c;
+        c.index = static_cast<uint8_t>(index);
+        return c;
+    }
+    constexpr Suit suit() const { return static_cast<Suit>(index & 3); }
+    constexpr int rank() const { return (index >> 2) + 2; }
+    constexpr uint64_t mask() const { return 1ULL << index; }
 };
 
+// Exchange decision for a hand: bit i set means card i is replaced on the draw. The value doubles as
+// the index of the matching output in a 32-way policy.
+using ExchangeMask = uint8_t;
+
+// Adapters for the older std::vector<bool> action representation.
+ExchangeMask toExchangeMask(const std::vector<bool>& exchanges);
+std::vector<bool> toExchangeVector(ExchangeMask exchanges);
+
 std::ostream& operator<<(std::ostream& os, const Card& card);
 bool operator==(const Card& lhs, const Card& rhs);
 bool operator!=(const Card& lhs, const Card& rhs);
 
+enum class ShuffleMode {
+    // std::shuffle over the whole deck on every shuffle().
+    FULL,
+    // Lazy Fisher-Yates: shuffle() only rewinds, and each draw() swaps a uniformly chosen card from
+    // the undrawn remainder into place. The deck stays a valid permutation between hands, and a hand
+    // only pays for the cards it actually draws.
+    PARTIAL
+};
+
+class Hand;
+
 class Deck {
 public:
-    Deck(std::mt19937& rng);
+    Deck(Rng& rng, ShuffleMode mode = ShuffleMode::FULL);
     void shuffle();
     Card draw();
+    // Returns every card after the first `position` drawn to the deck, so the rest of the hand can be
+    // drawn again independently of earlier draws.
+    void redraw(int position);
+    // Shuffles with the cards of dealt already drawn, so later draws come from the other 47.
+    void shuffleRest(const Hand& dealt);
     bool operator==(const Deck& other) const;
     bool operator!=(const Deck& other) const;
 
 private:
-    std::mt19937& mRandomGenerator;
-    std::vector<Card> mDeck;
+    Rng& mRandomGenerator;
+    std::array<Card, 52> mDeck;
     int mIndex = 0;
+    ShuffleMode mMode;
+    bool mDrawRandom = false; // Set once a PARTIAL shuffle is pending.
 };
 
 class Hand {
@@ -55,22 +114,47 @@ public:
     Hand(std::array<Card, 5> h) : mHand(h) {};
     Card& operator[](int index);
     const Card& operator[](int index) const;
+    uint64_t mask() const;
 private:
     std::array<Card, 5> mHand;
 };
 
 std::ostream& operator<<(std::ostream& os, const Hand& hand);
 
+// One-hot network encoding of a hand: per card, 4 suit inputs followed by 13 rank inputs.
+constexpr int ENCODED_CARD_SIZE = 17;
+constexpr int ENCODED_HAND_SIZE = 5 * ENCODED_CARD_SIZE;
+// Inputs set to 1 per hand, a suit and a rank per card.
+constexpr int ENCODED_ACTIVE_INPUTS = 10;
+// Sets the 10 active inputs, out must point at ENCODED_HAND_SIZE zeroed floats.
+void encodeHand(const Hand& hand, float* out);
+// Sparse form of encodeHand, writes the indices of the ENCODED_ACTIVE_INPUTS active inputs.
+void encodeHandIndices(const Hand& hand, int* out);
+
 class VideoPoker {
 public:
-    VideoPoker(std::mt19937& rng) : mDeck(rng) {}
+    VideoPoker(Rng& rng, ShuffleMode mode = ShuffleMode::PARTIAL, GameVariant variant = DEFAULT_VARIANT);
     const Hand& deal();
+    const Hand& exchange(ExchangeMask ex);
     const Hand& exchange(const std::vector<bool>& ex);
+    // Multi-play: the dealt hand and decision are drawn to against numPlays independent completions of
+    // the remaining 47 cards. Returns the final hand of every play.
+    const std::vector<Hand>& exchange(ExchangeMask ex, int numPlays);
+    // Deals from dealer's proposal instead of uniformly. nullptr restores ordinary dealing.
+    void setDealer(const StratifiedDealer* dealer);
+    // Importance weight of the current deal, 1 for ordinary dealing.
+    float getWeight() const;
     PokerHand getHandType(const Hand& hand);
-    int score(PokerHand handType);
+    void getHandTypes(const std::vector<Hand>& hands, std::vector<PokerHand>& out);
+    int score(PokerHand handType) const;
 
 private:
+    const GameTables* mTables;
     Deck mDeck;
     Hand mHand;
+    std::vector<Hand> mPlays;
     bool mInProgress = false;
+    Rng& mRandomGenerator;
+    const StratifiedDealer* mDealer = nullptr;
+    float mWeight = 1.0f;
 };
@@ -0,0 +1,135 @@
+#include "poker_batch.h"
+
+#include "poker.h"
+#include "evaluator.h"
+
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <cassert>
+
+VideoPokerBatch::VideoPokerBatch(int size, Rng& rng, GameVariant variant)
+        : mSize(size),
+          mRandomGenerator(rng),
+          mTables(getGameTables(variant)),
+          mDecks(size * 52),
+          mNextCard(size, 0),
+          mCards(size * 5),
+          mMasks(size, 0),
+          mHandTypes(size, HIGH_CARD),
+          mScores(size, 0),
+          mInputs(size * ENCODED_HAND_SIZE, 0.0f),
+          mActiveInputs(size * ENCODED_ACTIVE_INPUTS, 0),
+          mRandomWords(size * 5),
+          mWeights(size, 1.0f) {
+    for (int b = 0; b < size; b++) {
+        for (int c = 0; c < 52; c++) {
+            mDecks[b*52+c] = Card::fromIndex(c);
+        }
+    }
+}
+
+int VideoPokerBatch::size() const {
+    return mSize;
+}
+
+void VideoPokerBatch::setDealer(const StratifiedDealer* dealer) {
+    mDealer = dealer;
+    std::fill(mWeights.begin(), mWeights.end(), 1.0f);
+}
+
+const std::vector<float>& VideoPokerBatch::getWeights() const {
+    return mWeights;
+}
+
+Card VideoPokerBatch::drawCard(int slot, uint32_t randomWord) {
+    Card* deck = &mDecks[slot*52];
+    int next = mNextCard[slot]++;
+    int pick = next + boundedRandom(randomWord, 52 - next, mRandomGenerator);
+    std::swap(deck[next], deck[pick]);
+    return deck[next];
+}
+
+const std::vector<float>& VideoPokerBatch::deal() {
+    if (mDealer != nullptr) {
+        for (int b = 0; b < mSize; b++) {
+            Hand hand;
+            mWeights[b] = mDealer->deal(hand, mRandomGenerator);
+            // Move the dealt cards to the top of the slot's deck, the rest stay undrawn.
+            Card* deck = &mDecks[b*52];
+            for (int i = 0; i < 5; i++) {
+                std::swap(deck[i], *std::find(deck + i, deck + 52, hand[i]));
+                mCards[b*5+i] = hand[i];
+            }
+            mNextCard[b] = 5;
+        }
+    } else {
+        std::fill(mNextCard.begin(), mNextCard.end(), 0);
+        mRandomGenerator.generate(mRandomWords.data(), mRandomWords.size());
+        for (int b = 0; b < mSize; b++) {
+            for (int i = 0; i < 5; i++) {
+                mCards[b*5+i] = drawCard(b, mRandomWords[b*5+i]);
+            }
+        }
+    }
+    std::fill(mInputs.begin(), mInputs.end(), 0.0f);
+    for (int b = 0; b < mSize; b++) {
+        Hand hand = getHand(b);
+        encodeHand(hand, &mInputs[b*ENCODED_HAND_SIZE]);
+        encodeHandIndices(hand, &mActiveInputs[b*ENCODED_ACTIVE_INPUTS]);
+    }
+    return mInputs;
+}
+
+const std::vector<int>& VideoPokerBatch::exchange(const std::vector<ExchangeMask>& exchanges, int numPlays) {
+    assert(int(exchanges.size()) == mSize);
+    std::fill(mScores.begin(), mScores.end(), 0);
+    for (int p = 0; p < numPlays; p++) {
+        // Every play draws from the cards after the dealt five. Held cards are never overwritten.
+        std::fill(mNextCard.begin(), mNextCard.end(), 5);
+        mRandomGenerator.generate(mRandomWords.data(), mRandomWords.size());
+        for (int b = 0; b < mSize; b++) {
+            for (int i = 0; i < 5; i++) {
+                if ((exchanges[b] >> i) & 1) mCards[b*5+i] = drawCard(b, mRandomWords[b*5+i]);
+            }
+        }
+        for (int b = 0; b < mSize; b++) {
+            const Card* hand = &mCards[b*5];
+            mMasks[b] = hand[0].mask() | hand[1].mask() | hand[2].mask() | hand[3].mask() | hand[4].mask();
+        }
+        evaluateHands(mMasks, mHandTypes, mTables);
+        for (int b = 0; b < mSize; b++) {
+            mScores[b] += mTables.paytable[mHandTypes[b]];
+        }
+    }
+    return mScores;
+}
+
+int VideoPokerBatch::exchange(int slot, ExchangeMask exchange, int numPlays) {
+    mScores[slot] = 0;
+    for (int p = 0; p < numPlays; p++) {
+        mNextCard[slot] = 5;
+        for (int i = 0; i < 5; i++) {
+            if ((exchange >> i) & 1) mCards[slot*5+i] = drawCard(slot, mRandomGenerator());
+        }
+        mHandTypes[slot] = evaluateHand(getHand(slot).mask(), mTables);
+        mScores[slot] += mTables.paytable[mHandTypes[slot]];
+    }
+    return mScores[slot];
+}
+
+Hand VideoPokerBatch::getHand(int slot) const {
+    return Hand {{mCards[slot*5], mCards[slot*5+1], mCards[slot*5+2], mCards[slot*5+3], mCards[slot*5+4]}};
+}
+
+const std::vector<float>& VideoPokerBatch::getInputs() const {
+    return mInputs;
+}
+
+const std::vector<int>& VideoPokerBatch::getActiveInputs() const {
+    return mActiveInputs;
+}
+
+const std::vector<int>& VideoPokerBatch::getScores() const {
+    return mScores;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "poker.h"
+#include "rng.h"
+#include "stratified_dealer.h"
+
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <random>
+
+// N independent games of VideoPoker stepped together.
+//
+// Decks, dealt cards, card masks and exchange decisions are kept as structure-of-arrays buffers so the
+// lazy shuffle, the hand evaluator and the one-hot encoder each run as one tight loop over the batch.
+// Every deck is dealt with the same partial Fisher-Yates as ShuffleMode::PARTIAL, so a slot only
+// draws the cards it uses, and the random words for a whole batch are generated in one bulk call.
+class VideoPokerBatch {
+public:
+    VideoPokerBatch(int size, Rng& rng, GameVariant variant = DEFAULT_VARIANT);
+    int size() const;
+    // Deals a new hand into every slot. Returns the encoded hands, size() rows of ENCODED_HAND_SIZE.
+    const std::vector<float>& deal();
+    // Deals from dealer's proposal instead of uniformly. nullptr restores ordinary dealing.
+    void setDealer(const StratifiedDealer* dealer);
+    // Importance weight of every slot's current deal, all 1 for ordinary dealing.
+    const std::vector<float>& getWeights() const;
+    // Draws replacements for every slot and scores the resulting hands. With numPlays > 1 each slot is
+    // drawn to numPlays times from independent completions of its deck and scores the total payout.
+    const std::vector<int>& exchange(const std::vector<ExchangeMask>& exchanges, int numPlays = 1);
+    // Single-slot variant for callers that interleave decisions with play. Returns the slot's score.
+    int exchange(int slot, ExchangeMask exchange, int numPlays = 1);
+    // The dealt hand before exchange, the last play's final hand after.
+    Hand getHand(int slot) const;
+    const std::vector<float>& getInputs() const;
+    // Sparse form of getInputs, size() rows of ENCODED_ACTIVE_INPUTS indices.
+    const std::vector<int>& getActiveInputs() const;
+    const std::vector<int>& getScores() const;
+
+private:
+    int mSize;
+    Rng& mRandomGenerator;
+    const GameTables& mTables;
+    std::vector<Card> mDecks;       // size() decks of 52 cards.
+    std::vector<uint8_t> mNextCard; // Next undrawn position in each deck.
+    std::vector<Card> mCards;       // size() hands of 5 cards.
+    std::vector<uint64_t> mMasks;
+    std::vector<PokerHand> mHandTypes;
+    std::vector<int> mScores;
+    std::vector<float> mInputs;
+    std::vector<int> mActiveInputs;
+    std::vector<uint32_t> mRandomWords; // Pre-generated for up to 5 draws per slot.
+    const StratifiedDealer* mDealer = nullptr;
+    std::vector<float> mWeights;
+
+    Card drawCard(int slot, uint32_t randomWord);
+};
@@ -0,0 +1,126 @@
+#include <iostream>
+#include <chrono>
+#include <array>
+#include <vector>
+#include <thread>
+#include <filesystem>
+
+#include "poker.h"
+#include "evaluator.h"
+#include "ev_solver.h"
+#include "ev_cache.h"
+#include "rng.h"
+
+std::vector<Hand> allHands() {
+    std::array<Card, 52> cards;
+    for (int i = 0; i < 52; i++) {
+        cards[i] = Card::fromIndex(i);
+    }
+    std::vector<Hand> hands;
+    hands.reserve(2598960);
+    for (int a = 0; a < 52; a++)
+    for (int b = a+1; b < 52; b++)
+    for (int c = b+1; c < 52; c++)
+    for (int d = c+1; d < 52; d++)
+    for (int e = d+1; e < 52; e++) {
+        hands.push_back(Hand {{cards[a], cards[b], cards[c], cards[d], cards[e]}});
+    }
+    return hands;
+}
+
+template <typename F>
+void report(const std::string& name, size_t numHands, F&& body) {
+    auto start = std::chrono::steady_clock::now();
+    long checksum = body();
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+    std::cout << name << ": " << numHands / seconds.count() / 1e6 << " M hands/sec"
+              << " (checksum " << checksum << ")" << std::endl;
+}
+
+void benchHandEvaluators() {
+    std::vector<Hand> hands = allHands();
+    std::vector<uint64_t> masks;
+    masks.reserve(hands.size());
+    for (const Hand& h : hands) {
+        masks.push_back(h.mask());
+    }
+    std::vector<PokerHand> out;
+
+    report("Reference evaluator", hands.size(), [&]() {
+        long sum = 0;
+        for (const Hand& h : hands) sum += evaluateHandReference(h);
+        return sum;
+    });
+    report("Table evaluator (Hand)", hands.size(), [&]() {
+        long sum = 0;
+        for (const Hand& h : hands) sum += evaluateHand(h);
+        return sum;
+    });
+    report("Table evaluator (batch of masks)", hands.size(), [&]() {
+        evaluateHands(masks, out);
+        long sum = 0;
+        for (PokerHand p : out) sum += p;
+        return sum;
+    });
+}
+
+void benchEvSolver() {
+    auto start = std::chrono::steady_clock::now();
+    EvSolver solver;
+    std::chrono::duration<double> buildSeconds = std::chrono::steady_clock::now() - start;
+    std::cout << "EV solver tables built in " << buildSeconds.count() << " s" << std::endl;
+
+    Rng rng {1};
+    VideoPoker vp {rng};
+    std::vector<Hand> hands;
+    for (int i = 0; i < 100000; i++) {
+        hands.push_back(vp.deal());
+        vp.exchange(ExchangeMask {0});
+    }
+    std::vector<HoldValues> values;
+    for (int threads : {1, int(std::thread::hardware_concurrency())}) {
+        start = std::chrono::steady_clock::now();
+        solver.solve(hands, values, threads);
+        std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+        std::cout << "EV solve, " << threads << " threads: " << seconds.count() / hands.size() * 1e6
+                  << " us/deal" << std::endl;
+    }
+
+    start = std::chrono::steady_clock::now();
+    HoldValues exact = solver.solveByEnumeration(hands[0]);
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+    std::cout << "EV by enumeration: " << seconds.count() * 1e3 << " ms/deal (best "
+              << exact[EvSolver::bestExchange(exact)] << ")" << std::endl;
+}
+
+void benchEvCache() {
+    std::string path = (std::filesystem::temp_directory_path() / "poker_bench_ev_cache.bin").string();
+    auto start = std::chrono::steady_clock::now();
+    EvCache::build(path, EvSolver {});
+    std::chrono::duration<double> buildSeconds = std::chrono::steady_clock::now() - start;
+    std::cout << "EV cache built in " << buildSeconds.count() << " s" << std::endl;
+
+    EvCache cache {path, getGameTables(DEFAULT_VARIANT)};
+    Rng rng {1};
+    VideoPoker vp {rng};
+    std::vector<Hand> hands;
+    for (int i = 0; i < 100000; i++) {
+        hands.push_back(vp.deal());
+        vp.exchange(ExchangeMask {0});
+    }
+    double sink = 0.0;
+    start = std::chrono::steady_clock::now();
+    for (const Hand& hand : hands) {
+        sink += cache.holdValues(hand)[0];
+    }
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+    std::cout << "EV cache lookup: " << seconds.count() / hands.size() * 1e6 << " us/deal (" << sink << ")" << std::endl;
+    std::filesystem::remove(path);
+}
+
+int main() {
+    benchHandEvaluators();
+    benchEvSolver();
+    benchEvCache();
+    return 0;
+}
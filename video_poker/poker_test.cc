@@ -2,24 +2,41 @@
 #include <cassert>
 #include <sstream>
 #include <random>
+#include <array>
+#include <vector>
+#include <cmath>
+#include <bit>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <cstddef>
+#include <stdexcept>
 
 #include "poker.h"
+#include "evaluator.h"
+#include "poker_batch.h"
+#include "rng.h"
+#include "ev_solver.h"
+#include "canonical.h"
+#include "ev_cache.h"
+#include "stratified_dealer.h"
+#include "deal_corpus.h"
 
 
 void testDraw() {
-    std::mt19937 rng {1};
+    Rng rng {1};
     Deck d {rng};
     Card c1 = d.draw();
-    assert(c1.suit == Suit::CLUB);
-    assert(c1.rank == 2);
+    assert(c1.suit() == Suit::CLUB);
+    assert(c1.rank() == 2);
     Card c2 = d.draw();
-    assert(c2.suit == Suit::CLUB);
-    assert(c2.rank == 3);
+    assert(c2.suit() == Suit::CLUB);
+    assert(c2.rank() == 3);
 }
 
 void testShuffle() {
-    std::mt19937 rng1 {1};
-    std::mt19937 rng2 {2};
+    Rng rng1 {1};
+    Rng rng2 {2};
     Deck d {rng1};
     Deck d2 {rng2};
     d2.shuffle();
@@ -36,7 +53,7 @@ void testCardOstream() {
 }
 
 void testVideoPokerHand() {
-    std::mt19937 rng {1};
+    Rng rng {1};
     VideoPoker vp {rng};
     const Hand& hand = vp.deal();
     std::cout << hand << std::endl;
@@ -45,7 +62,7 @@ void testVideoPokerHand() {
 }
 
 void testHands() {
-    std::mt19937 rng {1};
+    Rng rng {1};
     VideoPoker vp {rng};
     Hand max_hand;
     int max_value = 0;
@@ -67,7 +84,7 @@ void testHands() {
 }
 
 void test_scoring() {
-    std::mt19937 rng {1};
+    Rng rng {1};
     VideoPoker vp {rng};
     int total = 0;
     for (int i = 0; i < 1000; i++) {
@@ -82,7 +99,7 @@ void test_scoring() {
 }
 
 void test_royal_flush() {
-    std::mt19937 rng {1};
+    Rng rng {1};
     VideoPoker vp {rng};
     Hand h;
     h[0] = {Suit::CLUB, 10};
@@ -93,6 +110,577 @@ void test_royal_flush() {
     std::cout << vp.getHandType(h) << std::endl;
 }
 
+void testEvaluatorExhaustive() {
+    std::array<Card, 52> cards;
+    for (int i = 0; i < 52; i++) {
+        cards[i] = Card::fromIndex(i);
+    }
+    std::array<int, ROYAL_FLUSH+1> counts {};
+    std::vector<Hand> hands;
+    for (int a = 0; a < 52; a++)
+    for (int b = a+1; b < 52; b++)
+    for (int c = b+1; c < 52; c++)
+    for (int d = c+1; d < 52; d++)
+    for (int e = d+1; e < 52; e++) {
+        Hand h {{cards[a], cards[b], cards[c], cards[d], cards[e]}};
+        PokerHand expected = evaluateHandReference(h);
+        assert(evaluateHand(h) == expected);
+        counts[expected]++;
+        if (hands.size() < 1000) hands.push_back(h);
+    }
+    assert(counts[ROYAL_FLUSH] == 4);
+    assert(counts[STRAIGHT_FLUSH] == 36);
+    assert(counts[FOUR_OF_A_KIND] == 624);
+    assert(counts[FULL_HOUSE] == 3744);
+    assert(counts[FLUSH] == 5108);
+    assert(counts[STRAIGHT] == 10200);
+    assert(counts[THREE_OF_A_KIND] == 54912);
+    assert(counts[TWO_PAIR] == 123552);
+    assert(counts[HIGH_PAIR] + counts[PAIR] == 1098240);
+    assert(counts[HIGH_CARD] == 1302540);
+
+    std::vector<PokerHand> batch;
+    evaluateHands(hands, batch);
+    assert(batch.size() == hands.size());
+    for (size_t i = 0; i < hands.size(); i++) {
+        assert(batch[i] == evaluateHandReference(hands[i]));
+    }
+}
+
+// Deuces Wild by brute force: every deuce tries every rank, in the naturals' suit when they share one.
+PokerHand deucesWildReference(const Hand& hand) {
+    std::vector<std::pair<int, int>> naturals;
+    int wild = 0;
+    for (int i = 0; i < 5; i++) {
+        if (hand[i].rank() == 2) wild++;
+        else naturals.push_back({hand[i].rank(), hand[i].suit()});
+    }
+    if (wild == 4) return FOUR_DEUCES;
+    bool suited = std::all_of(naturals.begin(), naturals.end(), [&](auto c) { return c.second == naturals[0].second; });
+    int wildSuit = suited ? naturals[0].second : (naturals[0].second + 1) % 4;
+    PokerHand best = HIGH_CARD;
+    int combinations = 1;
+    for (int w = 0; w < wild; w++) combinations *= 13;
+    for (int combo = 0; combo < combinations; combo++) {
+        std::vector<std::pair<int, int>> cards = naturals;
+        for (int w = 0, c = combo; w < wild; w++, c /= 13) {
+            cards.push_back({2 + c % 13, wildSuit});
+        }
+        std::array<int, 15> counts {};
+        bool flush = true;
+        for (auto [rank, suit] : cards) {
+            counts[rank]++;
+            flush = flush && suit == cards[0].second;
+        }
+        std::vector<int> sorted;
+        for (int r = 2; r <= 14; r++) {
+            for (int n = 0; n < counts[r]; n++) sorted.push_back(r);
+        }
+        bool distinct = std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end();
+        bool wheel = sorted == std::vector<int> {2, 3, 4, 5, 14};
+        bool straight = distinct && (sorted[4] - sorted[0] == 4 || wheel);
+        int largest = *std::max_element(counts.begin(), counts.end());
+        int pairs = std::count(counts.begin(), counts.end(), 2);
+        PokerHand hand = HIGH_CARD;
+        if (straight && flush && sorted[0] == 10) hand = wild == 0 ? ROYAL_FLUSH : WILD_ROYAL_FLUSH;
+        else if (largest == 5) hand = FIVE_OF_A_KIND;
+        else if (straight && flush) hand = STRAIGHT_FLUSH;
+        else if (largest == 4) hand = FOUR_OF_A_KIND;
+        else if (largest == 3 && pairs == 1) hand = FULL_HOUSE;
+        else if (flush) hand = FLUSH;
+        else if (straight) hand = STRAIGHT;
+        else if (largest == 3) hand = THREE_OF_A_KIND;
+        else if (pairs == 2) hand = TWO_PAIR;
+        else if (pairs == 1) hand = PAIR;
+        best = std::max(best, hand);
+    }
+    return best;
+}
+
+void testDeucesWildExhaustive() {
+    const GameTables& tables = getGameTables(GameVariant::DEUCES_WILD);
+    std::array<int, NUM_POKER_HANDS> counts {};
+    for (int a = 0; a < 52; a++)
+    for (int b = a+1; b < 52; b++)
+    for (int c = b+1; c < 52; c++)
+    for (int d = c+1; d < 52; d++)
+    for (int e = d+1; e < 52; e++) {
+        Hand h {{Card::fromIndex(a), Card::fromIndex(b), Card::fromIndex(c), Card::fromIndex(d), Card::fromIndex(e)}};
+        PokerHand expected = deucesWildReference(h);
+        assert(evaluateHand(h.mask(), tables) == expected);
+        counts[expected]++;
+    }
+    assert(counts[ROYAL_FLUSH] == 4);
+    assert(counts[FOUR_DEUCES] == 48);
+    assert(counts[WILD_ROYAL_FLUSH] == 480);
+    assert(counts[FIVE_OF_A_KIND] == 624);
+    assert(counts[STRAIGHT_FLUSH] == 2068);
+    assert(counts[FOUR_OF_A_KIND] == 31552);
+    assert(counts[FULL_HOUSE] == 12672);
+    assert(counts[FLUSH] == 14472);
+    assert(counts[STRAIGHT] == 62232);
+    assert(counts[THREE_OF_A_KIND] == 355080);
+    assert(counts[TWO_PAIR] == 95040);
+    assert(counts[PAIR] == 1225008);
+    assert(counts[HIGH_CARD] == 799680);
+}
+
+// Optimal play returns the published 99.5439% for 9/6 Jacks or Better and 100.7620% for full-pay
+// Deuces Wild.
+void testVariantReturns() {
+    std::vector<CanonicalClass> classes = canonicalClasses();
+    std::vector<Hand> hands;
+    for (const CanonicalClass& c : classes) {
+        hands.push_back(c.hand);
+    }
+    for (auto [variant, expected] : {std::pair {GameVariant::JACKS_OR_BETTER, 0.995439},
+                                     std::pair {GameVariant::DEUCES_WILD, 1.007620}}) {
+        EvSolver solver {getGameTables(variant)};
+        std::vector<HoldValues> values;
+        solver.solve(hands, values, 4);
+        double total = 0.0;
+        for (size_t i = 0; i < classes.size(); i++) {
+            total += values[i][EvSolver::bestExchange(values[i])] * classes[i].multiplicity;
+        }
+        assert(std::abs(total / NUM_HANDS - expected) < 5e-7);
+    }
+}
+
+void testPackedCards() {
+    Card c {HEART, 12};
+    assert(c.suit() == HEART);
+    assert(c.rank() == 12);
+    assert(Card::fromIndex(c.index) == c);
+    Hand h {{Card{CLUB, 2}, Card{SPADE, 14}, Card{HEART, 10}, Card{CLUB, 4}, Card{DIAMOND, 8}}};
+    assert(h.mask() == ((1ULL << 0) | (1ULL << 51) | (1ULL << 34) | (1ULL << 8) | (1ULL << 25)));
+
+    std::vector<bool> exchanges {true, false, true, true, false};
+    assert(toExchangeMask(exchanges) == 0b01101);
+    assert(toExchangeVector(0b01101) == exchanges);
+    Rng rng {1};
+    VideoPoker vp {rng};
+    Hand dealt = vp.deal();
+    Hand drawn = vp.exchange(ExchangeMask {0b10010});
+    assert(dealt[0] == drawn[0] && dealt[2] == drawn[2] && dealt[3] == drawn[3]);
+    assert(dealt[1] != drawn[1] && dealt[4] != drawn[4]);
+}
+
+// Upper tail critical value of the chi-square distribution at p ~= 0.0005 (Wilson-Hilferty).
+double chiSquareCritical(int df) {
+    double z = 3.29;
+    double k = 2.0 / (9.0 * df);
+    return df * std::pow(1.0 - k + z * std::sqrt(k), 3);
+}
+
+// Checks that both shuffle modes deal every card uniformly into each of the 10 positions a hand can
+// use, that positions within a hand behave like sampling without replacement, and that consecutive
+// hands are independent.
+void testShuffleDistribution(ShuffleMode mode) {
+    constexpr int HANDS = 200000;
+    Rng rng {7};
+    Deck d {rng, mode};
+    std::vector<std::array<int, 52>> positionCounts(10);
+    std::vector<int> rankPairCounts(13 * 13, 0);
+    std::vector<int> consecutiveCounts(52 * 52, 0);
+    int previousFirst = -1;
+    for (int h = 0; h < HANDS; h++) {
+        d.shuffle();
+        std::array<Card, 10> cards;
+        for (int i = 0; i < 10; i++) {
+            cards[i] = d.draw();
+            positionCounts[i][cards[i].index]++;
+        }
+        rankPairCounts[(cards[0].rank()-2) * 13 + (cards[7].rank()-2)]++;
+        if (previousFirst >= 0) {
+            consecutiveCounts[previousFirst * 52 + cards[0].index]++;
+        }
+        previousFirst = cards[0].index;
+    }
+
+    for (const auto& counts : positionCounts) {
+        double chi = 0.0;
+        double expected = HANDS / 52.0;
+        for (int c : counts) chi += (c - expected) * (c - expected) / expected;
+        assert(chi < chiSquareCritical(51));
+    }
+
+    double chi = 0.0;
+    for (int a = 0; a < 13; a++) {
+        for (int b = 0; b < 13; b++) {
+            double expected = HANDS * (4.0 / 52.0) * ((a == b ? 3.0 : 4.0) / 51.0);
+            double c = rankPairCounts[a * 13 + b];
+            chi += (c - expected) * (c - expected) / expected;
+        }
+    }
+    assert(chi < chiSquareCritical(13 * 13 - 1));
+
+    chi = 0.0;
+    double expected = (HANDS - 1) / (52.0 * 52.0);
+    for (int c : consecutiveCounts) chi += (c - expected) * (c - expected) / expected;
+    assert(chi < chiSquareCritical(52 * 52 - 1));
+}
+
+void testPartialShuffleRngCalls() {
+    Rng rng {3};
+    VideoPoker vp {rng, ShuffleMode::PARTIAL};
+    for (int h = 0; h < 1000; h++) {
+        Rng before = rng;
+        vp.deal();
+        vp.exchange(ExchangeMask {0b11111});
+        int calls = 0;
+        while (before != rng) {
+            before();
+            calls++;
+        }
+        assert(calls <= 10);
+    }
+}
+
+void testVideoPokerBatch() {
+    Rng rng {5};
+    VideoPokerBatch games {16, rng};
+    for (int round = 0; round < 100; round++) {
+        const std::vector<float>& inputs = games.deal();
+        std::vector<Hand> dealt;
+        std::vector<ExchangeMask> exchanges;
+        for (int b = 0; b < games.size(); b++) {
+            Hand h = games.getHand(b);
+            assert(std::popcount(h.mask()) == 5);
+            std::vector<float> encoded(ENCODED_HAND_SIZE, 0.0f);
+            encodeHand(h, encoded.data());
+            assert(std::equal(encoded.begin(), encoded.end(), inputs.begin() + b*ENCODED_HAND_SIZE));
+            // The sparse encoding names exactly the inputs set to 1.
+            std::array<int, ENCODED_ACTIVE_INPUTS> active;
+            encodeHandIndices(h, active.data());
+            assert(std::equal(active.begin(), active.end(), games.getActiveInputs().begin() + b*ENCODED_ACTIVE_INPUTS));
+            std::vector<float> expanded(ENCODED_HAND_SIZE, 0.0f);
+            for (int index : active) {
+                expanded[index] += 1.0f;
+            }
+            assert(expanded == encoded);
+            dealt.push_back(h);
+            exchanges.push_back((round + b) % 32);
+        }
+        const std::vector<int>& scores = games.exchange(exchanges);
+        for (int b = 0; b < games.size(); b++) {
+            Hand h = games.getHand(b);
+            for (int i = 0; i < 5; i++) {
+                bool kept = !((exchanges[b] >> i) & 1);
+                assert(kept == (h[i] == dealt[b][i]));
+                if (!kept) assert((dealt[b].mask() & h[i].mask()) == 0);
+            }
+            assert(scores[b] == getGameTables(DEFAULT_VARIANT).paytable[evaluateHand(h)]);
+        }
+    }
+}
+
+void testMultiPlay() {
+    Rng rng {21};
+    for (ShuffleMode mode : {ShuffleMode::FULL, ShuffleMode::PARTIAL}) {
+        VideoPoker vp {rng, mode};
+        for (int round = 0; round < 200; round++) {
+            Hand dealt = vp.deal();
+            ExchangeMask ex = round % 32;
+            const std::vector<Hand>& plays = vp.exchange(ex, 5);
+            assert(plays.size() == 5);
+            for (const Hand& h : plays) {
+                assert(std::popcount(h.mask()) == 5);
+                for (int i = 0; i < 5; i++) {
+                    bool kept = !((ex >> i) & 1);
+                    assert(kept == (h[i] == dealt[i]));
+                    if (!kept) assert((dealt.mask() & h[i].mask()) == 0);
+                }
+            }
+        }
+    }
+
+    VideoPokerBatch games {8, rng};
+    const GameTables& tables = getGameTables(DEFAULT_VARIANT);
+    for (int round = 0; round < 100; round++) {
+        games.deal();
+        std::vector<Hand> dealt;
+        for (int b = 0; b < games.size(); b++) {
+            dealt.push_back(games.getHand(b));
+        }
+        // Holding a paying hand pays it on every play.
+        for (int b = 0; b < games.size(); b++) {
+            int score = games.exchange(b, ExchangeMask {0}, 3);
+            assert(score == 3 * tables.paytable[evaluateHand(dealt[b].mask(), tables)]);
+            assert(games.getHand(b).mask() == dealt[b].mask());
+        }
+    }
+    // Drawing all five on every play averages out to the deal's own EV.
+    EvSolver solver;
+    games.deal();
+    Hand h = games.getHand(0);
+    double expected = solver.solve(h)[0b11111];
+    const int plays = 200000;
+    std::vector<ExchangeMask> drawAll(games.size(), 0b11111);
+    double total = games.exchange(drawAll, plays)[0];
+    assert(std::abs(total / plays - expected) < 0.03);
+}
+
+void testStratifiedDealer() {
+    StratifiedDealer dealer {{1.0, 1.0, 1.0, 4.0, 50.0, 1000.0}};
+    assert(std::abs(dealer.getNaturalProbability(5) * NUM_HANDS - 4) < 1e-6);
+    double natural = 0.0;
+    double proposal = 0.0;
+    double expectedWeight = 0.0;
+    for (int k = 0; k < NUM_DEAL_STRATA; k++) {
+        natural += dealer.getNaturalProbability(k);
+        proposal += dealer.getProposalProbability(k);
+        expectedWeight += dealer.getProposalProbability(k) * dealer.getWeight(k);
+    }
+    assert(std::abs(natural - 1.0) < 1e-9 && std::abs(proposal - 1.0) < 1e-9);
+    assert(std::abs(expectedWeight - 1.0) < 1e-6);
+
+    // Weighted payouts of held deals estimate the ordinary average payout of a dealt hand.
+    const GameTables& tables = getGameTables(DEFAULT_VARIANT);
+    double exact = 0.0;
+    for (uint32_t rank = 0; rank < uint32_t(NUM_HANDS); rank++) {
+        exact += tables.paytable[evaluateHand(unrankHand(rank).mask(), tables)];
+    }
+    exact /= NUM_HANDS;
+
+    Rng rng {23};
+    VideoPoker vp {rng};
+    vp.setDealer(&dealer);
+    std::array<int, NUM_DEAL_STRATA> counts {};
+    double weightedTotal = 0.0;
+    const int deals = 400000;
+    for (int i = 0; i < deals; i++) {
+        Hand h = vp.deal();
+        int k = StratifiedDealer::stratum(h.mask());
+        assert(vp.getWeight() == dealer.getWeight(k));
+        counts[k]++;
+        weightedTotal += vp.getWeight() * vp.score(vp.getHandType(h));
+        const Hand& drawn = vp.exchange(ExchangeMask {0b11111});
+        assert((drawn.mask() & h.mask()) == 0 && std::popcount(drawn.mask()) == 5);
+    }
+    assert(std::abs(weightedTotal / deals - exact) < 0.01);
+    for (int k = 0; k < NUM_DEAL_STRATA; k++) {
+        double expected = dealer.getProposalProbability(k) * deals;
+        assert(std::abs(counts[k] - expected) < 5 * std::sqrt(expected) + 1);
+    }
+
+    VideoPokerBatch games {16, rng};
+    games.setDealer(&dealer);
+    for (int round = 0; round < 100; round++) {
+        games.deal();
+        std::vector<Hand> dealt;
+        for (int b = 0; b < games.size(); b++) {
+            dealt.push_back(games.getHand(b));
+            assert(games.getWeights()[b] == dealer.getWeight(StratifiedDealer::stratum(dealt[b].mask())));
+        }
+        games.exchange(std::vector<ExchangeMask>(games.size(), 0b11111));
+        for (int b = 0; b < games.size(); b++) {
+            assert((games.getHand(b).mask() & dealt[b].mask()) == 0);
+            assert(std::popcount(games.getHand(b).mask()) == 5);
+        }
+    }
+}
+
+void testDealCorpus() {
+    std::string path = (std::filesystem::temp_directory_path() / "poker_test_corpus.bin").string();
+    const uint64_t numDeals = 100000;
+    Rng rng {29};
+    DealCorpus::write(path, numDeals, rng);
+    {
+        DealCorpus corpus {path};
+        assert(corpus.getNumDeals() == numDeals);
+        std::array<int, 52> counts {};
+        for (uint64_t d = 0; d < numDeals; d++) {
+            Hand dealt = corpus.getDeal(d);
+            Hand all = corpus.getFinalHand(d, 0b11111);
+            assert(std::popcount(dealt.mask()) == 5 && std::popcount(all.mask()) == 5);
+            assert((dealt.mask() & all.mask()) == 0);
+            for (int i = 0; i < 5; i++) {
+                counts[dealt[i].index]++;
+            }
+            // Replacements come off the draw order one discarded position at a time.
+            ExchangeMask ex = d % 32;
+            Hand final = corpus.getFinalHand(d, ex);
+            int next = 0;
+            for (int i = 0; i < 5; i++) {
+                bool kept = !((ex >> i) & 1);
+                assert(final[i] == (kept ? dealt[i] : all[next++]));
+            }
+        }
+        // Every card is dealt about equally often.
+        for (int c : counts) {
+            assert(std::abs(c - numDeals * 5 / 52.0) < 6 * std::sqrt(numDeals * 5 / 52.0));
+        }
+    }
+    // The same stream writes the same corpus.
+    std::string again = path + ".again";
+    Rng replay {29};
+    DealCorpus::write(again, numDeals, replay);
+    {
+        DealCorpus a {path};
+        DealCorpus b {again};
+        for (uint64_t d = 0; d < numDeals; d += 997) {
+            assert(a.getFinalHand(d, 0b10101).mask() == b.getFinalHand(d, 0b10101).mask());
+        }
+    }
+    std::filesystem::remove(again);
+
+    // Empty, oversized and corrupt corpora are rejected rather than read.
+    bool threw = false;
+    try { DealCorpus::write(again, 0, rng); } catch (const std::invalid_argument&) { threw = true; }
+    assert(threw);
+    auto rejects = [&](auto corrupt) {
+        std::filesystem::copy_file(path, again, std::filesystem::copy_options::overwrite_existing);
+        {
+            std::fstream file(again, std::ios::binary | std::ios::in | std::ios::out);
+            corrupt(file);
+        }
+        bool rejected = false;
+        try { DealCorpus corpus {again}; } catch (const std::runtime_error&) { rejected = true; }
+        return rejected;
+    };
+    auto setNumDeals = [](uint64_t n) {
+        return [n](std::fstream& file) {
+            file.seekp(offsetof(DealCorpusHeader, numDeals));
+            file.write(reinterpret_cast<const char*>(&n), sizeof(n));
+        };
+    };
+    assert(rejects(setNumDeals(0)));
+    assert(rejects(setNumDeals(numDeals + 1)));
+    assert(rejects(setNumDeals(uint64_t(1) << 62)));
+    assert(rejects([&](std::fstream& file) {
+        file.seekp(sizeof(DealCorpusHeader) + (numDeals - 1) * CORPUS_DEAL_SIZE + 7);
+        file.put(char(52));
+    }));
+    assert(!rejects([](std::fstream&) {}));
+    std::filesystem::remove(path);
+    std::filesystem::remove(again);
+
+    ScoreSummary paired = summarizePairedDifference({3, 1, 0, 2}, {2, 0, -1, 1});
+    assert(paired.mean == 1.0 && paired.standardError == 0.0);
+}
+
+void testPhilox() {
+    // Known-answer vectors from the Random123 distribution.
+    assert((Philox::block({0, 0, 0, 0}, {0, 0})
+            == std::array<uint32_t, 4>{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}));
+    assert((Philox::block({0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}, {0xffffffff, 0xffffffff})
+            == std::array<uint32_t, 4>{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}));
+    assert((Philox::block({0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}, {0xa4093822, 0x299f31d0})
+            == std::array<uint32_t, 4>{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}));
+
+    Rng rng {42};
+    std::vector<uint32_t> sequential(103);
+    for (uint32_t& v : sequential) v = rng();
+
+    // Jump-ahead lands on the same outputs.
+    Rng jumped {42};
+    jumped.seek(57);
+    assert(jumped() == sequential[57]);
+    assert(jumped.tell() == 58);
+
+    // Bulk generation matches one-at-a-time draws from any alignment.
+    Rng bulk {42};
+    bulk();
+    std::vector<uint32_t> generated(102);
+    bulk.generate(generated.data(), generated.size());
+    assert(std::equal(generated.begin(), generated.end(), sequential.begin() + 1));
+    assert(bulk == rng);
+
+    // Split streams are reproducible and distinct from each other and the parent.
+    Rng a = Rng(42).split(1);
+    Rng b = Rng(42).split(1);
+    Rng c = Rng(42).split(2);
+    uint32_t av = a();
+    assert(av == b());
+    assert(av != c() || a() != c());
+    assert(a.getStream() != Rng(42).getStream());
+}
+
+void testEvSolver() {
+    EvSolver solver;
+    std::vector<Hand> hands {
+        {{Card{CLUB, 10}, Card{CLUB, 11}, Card{CLUB, 12}, Card{CLUB, 13}, Card{HEART, 2}}},
+        {{Card{SPADE, 12}, Card{HEART, 12}, Card{DIAMOND, 7}, Card{CLUB, 4}, Card{SPADE, 9}}},
+    };
+    Rng rng {11};
+    VideoPoker vp {rng};
+    hands.push_back(vp.deal());
+    std::vector<HoldValues> batch;
+    solver.solve(hands, batch, 2);
+    for (size_t h = 0; h < hands.size(); h++) {
+        HoldValues exact = solver.solveByEnumeration(hands[h]);
+        for (int e = 0; e < 32; e++) {
+            assert(std::abs(batch[h][e] - exact[e]) < 1e-9);
+        }
+    }
+    // Dealt hand kept as is.
+    assert(batch[0][0] == 0.0);
+    assert(batch[1][0b11100] > 1.0 && EvSolver::bestExchange(batch[1]) == 0b11100);
+    // 4 to a royal beats the dealt pair of nothing.
+    assert(EvSolver::bestExchange(batch[0]) == 0b10000);
+}
+
+void testCanonicalHand() {
+    Rng rng {13};
+    VideoPoker vp {rng};
+    for (int trial = 0; trial < 1000; trial++) {
+        Hand hand = vp.deal();
+        vp.exchange(ExchangeMask {0});
+        assert(unrankHand(handRank(hand.mask())).mask() == hand.mask());
+        CanonicalHand canonical = canonicalize(hand);
+        // Any suit permutation and card order lands on the same representative.
+        std::array<int, 4> perm {0, 1, 2, 3};
+        std::shuffle(perm.begin(), perm.end(), rng);
+        std::array<int, 5> positions {0, 1, 2, 3, 4};
+        std::shuffle(positions.begin(), positions.end(), rng);
+        Hand permuted;
+        for (int i = 0; i < 5; i++) {
+            const Card& c = hand[positions[i]];
+            permuted[i] = Card::fromIndex((c.rank() - 2) * 4 + perm[c.suit()]);
+        }
+        assert(canonicalize(permuted).rank == canonical.rank);
+        assert(canonicalize(canonical.hand).rank == canonical.rank);
+        // The canonical order maps exchanges to the same cards in both hands.
+        for (ExchangeMask e = 0; e < 32; e++) {
+            assert(canonical.fromCanonical(canonical.toCanonical(e)) == e);
+            for (int j = 0; j < 5; j++) {
+                bool original = (e >> canonical.order[j]) & 1;
+                assert(original == bool((canonical.toCanonical(e) >> j) & 1));
+                assert(canonical.hand[j].rank() == hand[canonical.order[j]].rank());
+            }
+        }
+    }
+}
+
+void testEvCache() {
+    std::string path = (std::filesystem::temp_directory_path() / "poker_test_ev_cache.bin").string();
+    EvSolver solver;
+    EvCache::build(path, solver);
+    {
+        EvCache cache {path, getGameTables(DEFAULT_VARIANT)};
+        assert(cache.getNumClasses() == uint32_t(NUM_CANONICAL_HANDS));
+        uint64_t deals = 0;
+        for (uint32_t c = 0; c < cache.getNumClasses(); c++) {
+            deals += cache.getEntry(c).multiplicity;
+        }
+        assert(deals == uint64_t(NUM_HANDS));
+
+        Rng rng {17};
+        VideoPoker vp {rng};
+        for (int trial = 0; trial < 2000; trial++) {
+            Hand hand = vp.deal();
+            vp.exchange(ExchangeMask {0});
+            HoldValues cached = cache.holdValues(hand);
+            HoldValues exact = solver.solve(hand);
+            for (int e = 0; e < 32; e++) {
+                assert(std::abs(cached[e] - exact[e]) < 1e-9);
+            }
+            assert(exact[cache.bestExchange(hand)] == exact[EvSolver::bestExchange(exact)]);
+        }
+    }
+    std::filesystem::remove(path);
+}
+
 void run_tests() {
     // TODO: Add tests for Deck class
     // - Test deck creation (52 cards, no duplicates)
@@ -104,6 +692,21 @@ void run_tests() {
     testShuffle();
     testCardOstream();
     test_royal_flush();
+    testEvaluatorExhaustive();
+    testDeucesWildExhaustive();
+    testPackedCards();
+    testShuffleDistribution(ShuffleMode::FULL);
+    testShuffleDistribution(ShuffleMode::PARTIAL);
+    testPartialShuffleRngCalls();
+    testVideoPokerBatch();
+    testMultiPlay();
+    testStratifiedDealer();
+    testDealCorpus();
+    testPhilox();
+    testEvSolver();
+    testCanonicalHand();
+    testEvCache();
+    testVariantReturns();
 
     // Output based tests
     // testVideoPokerHand();
@@ -0,0 +1,336 @@
+#include "quantized_net.h"
+
+#include "activations.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAS_X86_DISPATCH
+#endif
+
+namespace {
+
+void scalarProduct(const uint8_t* inputs, int count, const int8_t* weights,
+                   int numInputs, int numNeurons, int32_t* products) {
+    for (int r = 0; r < count; r++) {
+        for (int n = 0; n < numNeurons; n++) {
+            int32_t sum = 0;
+            for (int i = 0; i < numInputs; i++) {
+                sum += int32_t(inputs[r * numInputs + i]) * weights[n * numInputs + i];
+            }
+            products[r * numNeurons + n] = sum;
+        }
+    }
+}
+
+void scalarDequantize(const int32_t* products, int count, int numNeurons, const float* rowScales,
+                      const float* scales, const float* biases, Epilogue epilogue, float* outputs) {
+    for (int r = 0; r < count; r++) {
+        for (int n = 0; n < numNeurons; n++) {
+            int k = r * numNeurons + n;
+            float logit = products[k] * (rowScales[r] * scales[n]) + biases[n];
+            outputs[k] = epilogue == Epilogue::RELU && logit < 0.0f ? 0.0f : logit;
+        }
+    }
+}
+
+const QuantizedKernels SCALAR_QUANTIZED_KERNELS {"scalar", scalarProduct, scalarDequantize};
+
+#ifdef HAS_X86_DISPATCH
+
+// Four neurons per pass over an input row, so each input chunk is loaded once for all four.
+
+__attribute__((target("avx2")))
+int32_t horizontalSum(__m256i v) {
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+    return _mm_cvtsi128_si32(sum);
+}
+
+// maddubs multiplies u8 by s8 and adds adjacent pairs into int16, which cannot saturate with 7-bit
+// inputs. madd against ones then widens the pairs into int32 lanes.
+__attribute__((target("avx2")))
+void avx2Product(const uint8_t* inputs, int count, const int8_t* weights,
+                 int numInputs, int numNeurons, int32_t* products) {
+    const __m256i ones = _mm256_set1_epi16(1);
+    for (int r = 0; r < count; r++) {
+        const uint8_t* row = inputs + r * numInputs;
+        for (int n = 0; n < numNeurons; n += 4) {
+            int tile = std::min(4, numNeurons - n);
+            __m256i sums[4] = {};
+            for (int i = 0; i < numInputs; i += 32) {
+                __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i));
+                for (int k = 0; k < tile; k++) {
+                    __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights + (n + k) * numInputs + i));
+                    sums[k] = _mm256_add_epi32(sums[k], _mm256_madd_epi16(_mm256_maddubs_epi16(x, w), ones));
+                }
+            }
+            for (int k = 0; k < tile; k++) {
+                products[r * numNeurons + n + k] = horizontalSum(sums[k]);
+            }
+        }
+    }
+}
+
+// vpdpbusd does the u8 x s8 multiply and the four-way add into int32 in one instruction.
+__attribute__((target("avx512f,avx512bw,avx512vnni")))
+void avx512vnniProduct(const uint8_t* inputs, int count, const int8_t* weights,
+                       int numInputs, int numNeurons, int32_t* products) {
+    for (int r = 0; r < count; r++) {
+        const uint8_t* row = inputs + r * numInputs;
+        for (int n = 0; n < numNeurons; n += 4) {
+            int tile = std::min(4, numNeurons - n);
+            __m512i sums[4] = {};
+            for (int i = 0; i < numInputs; i += 64) {
+                __m512i x = _mm512_loadu_si512(row + i);
+                for (int k = 0; k < tile; k++) {
+                    __m512i w = _mm512_loadu_si512(weights + (n + k) * numInputs + i);
+                    sums[k] = _mm512_dpbusd_epi32(sums[k], x, w);
+                }
+            }
+            // Spilled rather than _mm512_reduce_add_epi32, whose GCC 12 expansion trips -Wmaybe-uninitialized.
+            for (int k = 0; k < tile; k++) {
+                alignas(64) int32_t lanes[16];
+                _mm512_store_si512(lanes, sums[k]);
+                int32_t sum = 0;
+                for (int32_t lane : lanes) {
+                    sum += lane;
+                }
+                products[r * numNeurons + n + k] = sum;
+            }
+        }
+    }
+}
+
+// Vector max in place of the scalar compare, whose branch the signs of random deals defeat.
+__attribute__((target("avx2")))
+void avx2Dequantize(const int32_t* products, int count, int numNeurons, const float* rowScales,
+                    const float* scales, const float* biases, Epilogue epilogue, float* outputs) {
+    const __m256 floor = _mm256_set1_ps(epilogue == Epilogue::RELU ? 0.0f : -INFINITY);
+    for (int r = 0; r < count; r++) {
+        const __m256 rowScale = _mm256_set1_ps(rowScales[r]);
+        int n = 0;
+        for (; n + 8 <= numNeurons; n += 8) {
+            int k = r * numNeurons + n;
+            __m256 scale = _mm256_mul_ps(rowScale, _mm256_loadu_ps(scales + n));
+            __m256 product = _mm256_cvtepi32_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(products + k)));
+            __m256 logit = _mm256_add_ps(_mm256_mul_ps(product, scale), _mm256_loadu_ps(biases + n));
+            _mm256_storeu_ps(outputs + k, _mm256_max_ps(logit, floor));
+        }
+        scalarDequantize(products + r * numNeurons + n, 1, numNeurons - n, rowScales + r, scales + n, biases + n,
+                         epilogue, outputs + r * numNeurons + n);
+    }
+}
+
+// The maskz forms throughout dodge the -Wmaybe-uninitialized GCC 12 raises on the unmasked ones.
+__attribute__((target("avx512f,avx512bw,avx512vnni")))
+void avx512vnniDequantize(const int32_t* products, int count, int numNeurons, const float* rowScales,
+                          const float* scales, const float* biases, Epilogue epilogue, float* outputs) {
+    const __m512 floor = _mm512_set1_ps(epilogue == Epilogue::RELU ? 0.0f : -INFINITY);
+    for (int r = 0; r < count; r++) {
+        const __m512 rowScale = _mm512_set1_ps(rowScales[r]);
+        for (int n = 0; n < numNeurons; n += 16) {
+            int k = r * numNeurons + n;
+            __mmask16 mask = numNeurons - n >= 16 ? __mmask16(0xFFFF) : __mmask16((1u << (numNeurons - n)) - 1);
+            __m512 scale = _mm512_mul_ps(rowScale, _mm512_maskz_loadu_ps(mask, scales + n));
+            __m512 product = _mm512_maskz_cvtepi32_ps(mask, _mm512_maskz_loadu_epi32(mask, products + k));
+            __m512 logit = _mm512_add_ps(_mm512_mul_ps(product, scale), _mm512_maskz_loadu_ps(mask, biases + n));
+            _mm512_mask_storeu_ps(outputs + k, mask, _mm512_maskz_max_ps(mask, logit, floor));
+        }
+    }
+}
+
+const QuantizedKernels AVX2_QUANTIZED_KERNELS {"avx2", avx2Product, avx2Dequantize};
+const QuantizedKernels AVX512VNNI_QUANTIZED_KERNELS {"avx512vnni", avx512vnniProduct, avx512vnniDequantize};
+
+#endif
+
+constexpr int QUANTIZED_BLOCK_ROWS = 16;
+
+int paddedSize(int size) {
+    return (size + QUANTIZED_ALIGNMENT - 1) / QUANTIZED_ALIGNMENT * QUANTIZED_ALIGNMENT;
+}
+
+// Scales a non-negative row into [0, QUANTIZED_ACTIVATION_MAX] and returns the float value of one step.
+float quantizeRow(const float* row, int size, uint8_t* out) {
+    float max = 0.0f;
+    for (int i = 0; i < size; i++) {
+        max = std::max(max, row[i]);
+    }
+    if (max == 0.0f) {
+        std::fill_n(out, size, 0);
+        return 0.0f;
+    }
+    float inverse = QUANTIZED_ACTIVATION_MAX / max;
+    // Inputs are already in [0, max], so rounding is the only step.
+    for (int i = 0; i < size; i++) {
+        out[i] = uint8_t(row[i] * inverse + 0.5f);
+    }
+    return max / QUANTIZED_ACTIVATION_MAX;
+}
+
+} // namespace
+
+std::vector<const QuantizedKernels*> supportedQuantizedKernels() {
+    std::vector<const QuantizedKernels*> supported {&SCALAR_QUANTIZED_KERNELS};
+#ifdef HAS_X86_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        supported.push_back(&AVX2_QUANTIZED_KERNELS);
+    }
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vnni")) {
+        supported.push_back(&AVX512VNNI_QUANTIZED_KERNELS);
+    }
+#endif
+    return supported;
+}
+
+const QuantizedKernels& quantizedKernels() {
+    static const QuantizedKernels& best = *supportedQuantizedKernels().back();
+    return best;
+}
+
+QuantizedNet::QuantizedNet(const Network& net) {
+    std::vector<LayerSpecification> topology = net.getTopology();
+    for (size_t l = 1; l < topology.size(); l++) {
+        if (l + 1 < topology.size() && topology[l].activationType == Activation::LINEAR) {
+            throw std::invalid_argument("Hidden LINEAR layers can not be quantized");
+        }
+        QuantizedLayer layer;
+        layer.numInputs = topology[l - 1].numNeurons;
+        layer.paddedInputs = paddedSize(layer.numInputs);
+        layer.numNeurons = topology[l].numNeurons;
+        layer.activation = topology[l].activationType;
+        layer.weights.assign(size_t(layer.numNeurons) * layer.paddedInputs, 0);
+        layer.biases = net.getLayerBiases(l - 1);
+        std::vector<float> weights = net.getLayerWeights(l - 1);
+        for (int n = 0; n < layer.numNeurons; n++) {
+            const float* row = weights.data() + n * layer.numInputs;
+            float max = 0.0f;
+            for (int i = 0; i < layer.numInputs; i++) {
+                max = std::max(max, std::abs(row[i]));
+            }
+            float scale = max / 127.0f;
+            layer.scales.push_back(scale);
+            if (scale == 0.0f) {
+                continue;
+            }
+            for (int i = 0; i < layer.numInputs; i++) {
+                layer.weights[n * layer.paddedInputs + i] = int8_t(std::lround(row[i] / scale));
+            }
+        }
+        mLayers.push_back(std::move(layer));
+    }
+}
+
+void QuantizedNet::feedforward(const std::vector<int>& activeInputs, int activePerSample, int count,
+                               std::vector<float>& outputs) const {
+    const QuantizedLayer& first = mLayers[0];
+    size_t numActive = size_t(count) * activePerSample;
+    if (activePerSample <= 0 || activeInputs.size() < numActive) {
+        throw std::invalid_argument("Fewer active inputs than batch rows");
+    }
+    for (size_t k = 0; k < numActive; k++) {
+        if (activeInputs[k] < 0 || activeInputs[k] >= first.numInputs) {
+            throw std::out_of_range("Active input index out of range");
+        }
+    }
+    // Blocks of rows run through every layer in turn, so a block's activations stay in L1.
+    const QuantizedKernels& kernels = quantizedKernels();
+    outputs.resize(size_t(count) * getNumOutputs());
+    std::vector<int32_t> sums;
+    std::vector<float> activations;
+    const std::vector<float> unitScales(QUANTIZED_BLOCK_ROWS, 1.0f);
+    for (int block = 0; block < count; block += QUANTIZED_BLOCK_ROWS) {
+        int rows = std::min(QUANTIZED_BLOCK_ROWS, count - block);
+        // One-hot inputs need no activation scale, the product is a sum of weight columns.
+        sums.resize(size_t(rows) * first.numNeurons);
+        for (int r = 0; r < rows; r++) {
+            const int* active = activeInputs.data() + (block + r) * activePerSample;
+            for (int n = 0; n < first.numNeurons; n++) {
+                const int8_t* weights = first.weights.data() + n * first.paddedInputs;
+                int32_t sum = 0;
+                for (int k = 0; k < activePerSample; k++) {
+                    sum += weights[active[k]];
+                }
+                sums[r * first.numNeurons + n] = sum;
+            }
+        }
+        activations.resize(size_t(rows) * first.numNeurons);
+        kernels.dequantize(sums.data(), rows, first.numNeurons, unitScales.data(), first.scales.data(),
+                           first.biases.data(), epilogue(first), activations.data());
+        activate(first, activations.data(), rows);
+        runLayers(1, activations, rows);
+        std::copy(activations.begin(), activations.end(), outputs.begin() + size_t(block) * getNumOutputs());
+    }
+}
+
+void QuantizedNet::feedforward(const std::vector<float>& inputs, std::vector<float>& outputs) const {
+    if (int(inputs.size()) != mLayers[0].numInputs) {
+        throw std::invalid_argument("Inputs != Weights");
+    }
+    outputs = inputs;
+    runLayers(0, outputs, 1);
+}
+
+void QuantizedNet::runLayers(size_t first, std::vector<float>& activations, int count) const {
+    const QuantizedKernels& kernels = quantizedKernels();
+    std::vector<uint8_t> quantized;
+    std::vector<float> rowScales(count);
+    std::vector<int32_t> products;
+    std::vector<float> logits;
+    for (size_t l = first; l < mLayers.size(); l++) {
+        const QuantizedLayer& layer = mLayers[l];
+        quantized.assign(size_t(count) * layer.paddedInputs, 0);
+        for (int r = 0; r < count; r++) {
+            rowScales[r] = quantizeRow(activations.data() + r * layer.numInputs, layer.numInputs,
+                                       quantized.data() + r * layer.paddedInputs);
+        }
+        products.resize(size_t(count) * layer.numNeurons);
+        kernels.product(quantized.data(), count, layer.weights.data(), layer.paddedInputs, layer.numNeurons, products.data());
+        logits.resize(size_t(count) * layer.numNeurons);
+        kernels.dequantize(products.data(), count, layer.numNeurons, rowScales.data(), layer.scales.data(),
+                           layer.biases.data(), epilogue(layer), logits.data());
+        activate(layer, logits.data(), count);
+        std::swap(activations, logits);
+    }
+}
+
+void QuantizedNet::activate(const QuantizedLayer& layer, float* logits, int count) {
+    for (int r = 0; r < count; r++) {
+        float* row = logits + r * layer.numNeurons;
+        switch (layer.activation) {
+            case Activation::LINEAR:
+            case Activation::RELU: // Applied by dequantize.
+                break;
+            case Activation::SIGMOID:
+                sigmoid(row, layer.numNeurons, row);
+                break;
+            case Activation::SOFTMAX:
+                softmax(row, layer.numNeurons, row);
+                break;
+        }
+    }
+}
+
+Epilogue QuantizedNet::epilogue(const QuantizedLayer& layer) {
+    return layer.activation == Activation::RELU ? Epilogue::RELU : Epilogue::NONE;
+}
+
+int QuantizedNet::getNumOutputs() const {
+    return mLayers.back().numNeurons;
+}
+
+size_t QuantizedNet::getParameterBytes() const {
+    size_t bytes = 0;
+    for (const QuantizedLayer& layer : mLayers) {
+        bytes += layer.weights.size() * sizeof(int8_t);
+        bytes += (layer.scales.size() + layer.biases.size()) * sizeof(float);
+    }
+    return bytes;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "neural.h"
+#include "kernels.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Integer products of 7-bit unsigned activations and int8 weights, picked at startup like the float
+// kernels. Integer sums are exact, so every set gives the same products; dequantize agrees up to
+// rounding, as the compiler may fuse its multiply-add where the CPU has FMA.
+struct QuantizedKernels {
+    const char* name;
+    // products[r][n] = sum_i inputs[r][i] * weights[n][i]. numInputs is a multiple of
+    // QUANTIZED_ALIGNMENT and inputs are at most QUANTIZED_ACTIVATION_MAX.
+    void (*product)(const uint8_t* inputs, int count, const int8_t* weights,
+                    int numInputs, int numNeurons, int32_t* products);
+    // outputs[r][n] = epilogue(products[r][n] * (rowScales[r] * scales[n]) + biases[n])
+    void (*dequantize)(const int32_t* products, int count, int numNeurons, const float* rowScales,
+                       const float* scales, const float* biases, Epilogue epilogue, float* outputs);
+};
+
+// Rows of inputs and weights are zero-padded to a multiple of this, so kernels never see a tail.
+constexpr int QUANTIZED_ALIGNMENT = 64;
+// Seven bits keep pairs of u8 x s8 products inside the int16 lanes of the AVX2 kernel.
+constexpr int QUANTIZED_ACTIVATION_MAX = 127;
+
+const QuantizedKernels& quantizedKernels();
+// Every set this CPU can run, scalar first. For tests and benchmarks.
+std::vector<const QuantizedKernels*> supportedQuantizedKernels();
+
+// Post-training int8 copy of a net for greedy evaluation, where only the chosen action matters.
+//
+// Weights are symmetric int8 with one scale per neuron. Each layer's input row is re-quantized to
+// [0, QUANTIZED_ACTIVATION_MAX] with its own scale before the integer product, which is scaled
+// back to float and gets the fp32 bias and activation. Every layer input must therefore be
+// non-negative: one-hot inputs, and hidden layers that are not LINEAR.
+class QuantizedNet {
+public:
+    // Throws std::invalid_argument for a hidden LINEAR layer.
+    explicit QuantizedNet(const Network& net);
+    // Sparse one-hot inputs as in Network::feedforward. Outputs are count rows of the final activation.
+    void feedforward(const std::vector<int>& activeInputs, int activePerSample, int count,
+                     std::vector<float>& outputs) const;
+    // One dense, non-negative sample.
+    void feedforward(const std::vector<float>& inputs, std::vector<float>& outputs) const;
+    int getNumOutputs() const;
+    // Bytes of weights, scales and biases, against 4 per parameter in fp32.
+    size_t getParameterBytes() const;
+
+private:
+    struct QuantizedLayer {
+        int numInputs;
+        int paddedInputs;
+        int numNeurons;
+        Activation activation;
+        std::vector<int8_t> weights; // numNeurons x paddedInputs
+        std::vector<float> scales;
+        std::vector<float> biases;
+    };
+    std::vector<QuantizedLayer> mLayers;
+
+    // Layers first and on, from count float rows in activations. Leaves the outputs in activations.
+    void runLayers(size_t first, std::vector<float>& activations, int count) const;
+    static Epilogue epilogue(const QuantizedLayer& layer);
+    // The activations dequantize does not fuse.
+    static void activate(const QuantizedLayer& layer, float* logits, int count);
+};
@@ -0,0 +1,111 @@
+#include "rng.h"
+
+#include <array>
+#include <cstdint>
+
+namespace {
+
+constexpr uint32_t PHILOX_M0 = 0xD2511F53;
+constexpr uint32_t PHILOX_M1 = 0xCD9E8D57;
+constexpr uint32_t PHILOX_W0 = 0x9E3779B9;
+constexpr uint32_t PHILOX_W1 = 0xBB67AE85;
+constexpr int PHILOX_ROUNDS = 10;
+
+inline void round(std::array<uint32_t, 4>& ctr, const std::array<uint32_t, 2>& key) {
+    uint64_t p0 = uint64_t(PHILOX_M0) * ctr[0];
+    uint64_t p1 = uint64_t(PHILOX_M1) * ctr[2];
+    ctr = {
+        static_cast<uint32_t>(p1 >> 32) ^ ctr[1] ^ key[0],
+        static_cast<uint32_t>(p1),
+        static_cast<uint32_t>(p0 >> 32) ^ ctr[3] ^ key[1],
+        static_cast<uint32_t>(p0),
+    };
+}
+
+// splitmix64 finalizer, used to scatter derived stream ids.
+inline uint64_t mix(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+} // namespace
+
+Philox::Philox(uint64_t seed, uint64_t stream) : mSeed(seed), mStream(stream) {}
+
+std::array<uint32_t, 4> Philox::block(std::array<uint32_t, 4> counter, std::array<uint32_t, 2> key) {
+    for (int r = 0; r < PHILOX_ROUNDS; r++) {
+        if (r > 0) {
+            key[0] += PHILOX_W0;
+            key[1] += PHILOX_W1;
+        }
+        round(counter, key);
+    }
+    return counter;
+}
+
+std::array<uint32_t, 4> Philox::blockAt(uint64_t blockIndex) const {
+    return block({static_cast<uint32_t>(blockIndex), static_cast<uint32_t>(blockIndex >> 32),
+                  static_cast<uint32_t>(mStream), static_cast<uint32_t>(mStream >> 32)},
+                 {static_cast<uint32_t>(mSeed), static_cast<uint32_t>(mSeed >> 32)});
+}
+
+Philox::result_type Philox::operator()() {
+    uint64_t blockIndex = mPosition >> 2;
+    if (blockIndex != mBufferedBlock) {
+        mBuffer = blockAt(blockIndex);
+        mBufferedBlock = blockIndex;
+    }
+    return mBuffer[mPosition++ & 3];
+}
+
+Philox Philox::split(uint64_t subStream) const {
+    return Philox(mSeed, mix(mStream ^ mix(subStream)));
+}
+
+void Philox::seek(uint64_t position) {
+    mPosition = position;
+}
+
+uint64_t Philox::tell() const {
+    return mPosition;
+}
+
+void Philox::discard(unsigned long long n) {
+    mPosition += n;
+}
+
+void Philox::generate(uint32_t* out, size_t n) {
+    size_t i = 0;
+    while (i < n && (mPosition & 3) != 0) {
+        out[i++] = (*this)();
+    }
+    for (; i + 4 <= n; i += 4) {
+        std::array<uint32_t, 4> b = blockAt(mPosition >> 2);
+        out[i] = b[0];
+        out[i+1] = b[1];
+        out[i+2] = b[2];
+        out[i+3] = b[3];
+        mPosition += 4;
+    }
+    while (i < n) {
+        out[i++] = (*this)();
+    }
+}
+
+uint64_t Philox::getSeed() const {
+    return mSeed;
+}
+
+uint64_t Philox::getStream() const {
+    return mStream;
+}
+
+bool Philox::operator==(const Philox& other) const {
+    return mSeed == other.mSeed && mStream == other.mStream && mPosition == other.mPosition;
+}
+
+bool Philox::operator!=(const Philox& other) const {
+    return !(*this == other);
+}
@@ -0,0 +1,19 @@
+#include "static_net.h"
+
+#include "hyperparams.h"
+
+#include <memory>
+#include <vector>
+
+std::unique_ptr<Network> makeNetwork(const std::vector<LayerSpecification>& topology, const Rng& initRng) {
+    if (topology == SoftmaxNet::topology()) {
+        return std::make_unique<SoftmaxNet>(initRng);
+    }
+    if (topology == SigmoidNet::topology()) {
+        return std::make_unique<SigmoidNet>(initRng);
+    }
+    if (topology == CriticNet::topology()) {
+        return std::make_unique<CriticNet>(initRng);
+    }
+    return std::make_unique<NeuralNet>(topology, initRng);
+}
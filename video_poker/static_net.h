@@ -0,0 +1,57 @@
+#pragma once
+
+#include "neural.h"
+#include "rng.h"
+
+#include <array>
+#include <memory>
+#include <vector>
+
+// Compile-time topologies, e.g. StaticNet<Input<85>, Dense<170, Relu>, Dense<170, Relu>, Dense<32, Softmax>>.
+template <int SIZE>
+struct Input {
+    static constexpr int NEURONS = SIZE;
+};
+
+struct Linear {
+    static constexpr Activation ACTIVATION = Activation::LINEAR;
+};
+
+struct Relu {
+    static constexpr Activation ACTIVATION = Activation::RELU;
+};
+
+struct Sigmoid {
+    static constexpr Activation ACTIVATION = Activation::SIGMOID;
+};
+
+struct Softmax {
+    static constexpr Activation ACTIVATION = Activation::SOFTMAX;
+};
+
+template <int SIZE, typename ActivationType>
+struct Dense {
+    static constexpr int NEURONS = SIZE;
+    static constexpr Activation ACTIVATION = ActivationType::ACTIVATION;
+};
+
+// NeuralNet with the topology in its type, so hyperparams.h can name the production nets and code
+// holding one knows its sizes at compile time. The passes are NeuralNet's own: there is one layer
+// implementation, and a StaticNet is the NeuralNet of its topology drawn from the same stream.
+template <typename InputLayer, typename... DenseLayers>
+class StaticNet : public NeuralNet {
+public:
+    static constexpr int NUM_LAYERS = sizeof...(DenseLayers);
+    static constexpr std::array<int, NUM_LAYERS + 1> SIZES {InputLayer::NEURONS, DenseLayers::NEURONS...};
+    static constexpr int NUM_INPUTS = InputLayer::NEURONS;
+    static constexpr int NUM_OUTPUTS = SIZES[NUM_LAYERS];
+
+    explicit StaticNet(const Rng& initRng) : NeuralNet(topology(), initRng) {}
+
+    static std::vector<LayerSpecification> topology() {
+        return {{InputLayer::NEURONS, Activation::LINEAR}, {DenseLayers::NEURONS, DenseLayers::ACTIVATION}...};
+    }
+};
+
+// A StaticNet for each production topology in hyperparams.h, and a NeuralNet for any other.
+std::unique_ptr<Network> makeNetwork(const std::vector<LayerSpecification>& topology, const Rng& initRng);
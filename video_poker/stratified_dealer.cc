@@ -0,0 +1,84 @@
+#include "stratified_dealer.h"
+
+#include "poker.h"
+#include "canonical.h"
+#include "rng.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// Nibbles of 10, J, Q, K, A.
+constexpr uint64_t ROYAL_CARD_BITS = 0xFFFFFULL << (4 * 8);
+// One bit per royal rank within a suit.
+constexpr uint64_t SUIT_BITS = 0x11111ULL << (4 * 8);
+
+const std::array<std::vector<uint32_t>, NUM_DEAL_STRATA>& strataHands() {
+    static const std::array<std::vector<uint32_t>, NUM_DEAL_STRATA> strata = [] {
+        std::array<std::vector<uint32_t>, NUM_DEAL_STRATA> result;
+        for (uint32_t rank = 0; rank < uint32_t(NUM_HANDS); rank++) {
+            result[StratifiedDealer::stratum(unrankHand(rank).mask())].push_back(rank);
+        }
+        return result;
+    }();
+    return strata;
+}
+
+} // namespace
+
+StratifiedDealer::StratifiedDealer(const std::vector<double>& boosts) : mStrata(strataHands()) {
+    if (boosts.size() != NUM_DEAL_STRATA) throw std::invalid_argument("Expected one boost per deal stratum");
+    double total = 0.0;
+    for (int k = 0; k < NUM_DEAL_STRATA; k++) {
+        if (!(boosts[k] > 0.0)) throw std::invalid_argument("Deal boosts must be positive");
+        mProposal[k] = getNaturalProbability(k) * boosts[k];
+        total += mProposal[k];
+    }
+    double cumulative = 0.0;
+    for (int k = 0; k < NUM_DEAL_STRATA; k++) {
+        mProposal[k] /= total;
+        cumulative += mProposal[k];
+        mCumulative[k] = cumulative;
+        mWeights[k] = total / boosts[k];
+    }
+    mCumulative.back() = 1.0;
+}
+
+int StratifiedDealer::stratum(uint64_t mask) {
+    uint64_t royals = mask & ROYAL_CARD_BITS;
+    int best = 0;
+    for (int suit = 0; suit < 4; suit++) {
+        best = std::max(best, std::popcount(royals & (SUIT_BITS << suit)));
+    }
+    return best;
+}
+
+float StratifiedDealer::deal(Hand& hand, Rng& rng) const {
+    std::uniform_real_distribution<double> uniform {0.0, 1.0};
+    double u = uniform(rng);
+    int k = std::upper_bound(mCumulative.begin(), mCumulative.end() - 1, u) - mCumulative.begin();
+    const std::vector<uint32_t>& hands = mStrata[k];
+    hand = unrankHand(hands[boundedRandom(rng(), hands.size(), rng)]);
+    // Ranked hands come out sorted, deal them in uniformly random order like a shuffled deck.
+    for (int i = 4; i > 0; i--) {
+        std::swap(hand[i], hand[boundedRandom(rng(), i + 1, rng)]);
+    }
+    return mWeights[k];
+}
+
+double StratifiedDealer::getNaturalProbability(int stratum) const {
+    return double(mStrata[stratum].size()) / NUM_HANDS;
+}
+
+double StratifiedDealer::getProposalProbability(int stratum) const {
+    return mProposal[stratum];
+}
+
+float StratifiedDealer::getWeight(int stratum) const {
+    return mWeights[stratum];
+}
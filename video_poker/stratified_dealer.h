@@ -0,0 +1,35 @@
+#pragma once
+
+#include "poker.h"
+#include "rng.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Deals are stratified by the most royal cards (10 to A) they hold in one suit, 0 to 5.
+constexpr int NUM_DEAL_STRATA = 6;
+
+// Importance-sampled dealing.
+//
+// A stratum k is picked with proposal probability q(k) = p(k) * boosts[k] / Z, where p(k) is its share
+// of all deals, and a deal is then drawn uniformly from the stratum with its cards in random order.
+// Every deal in stratum k carries the weight p(k) / q(k) = Z / boosts[k], so weighted averages under
+// the proposal are unbiased estimates of averages under ordinary dealing.
+class StratifiedDealer {
+public:
+    explicit StratifiedDealer(const std::vector<double>& boosts);
+    static int stratum(uint64_t mask);
+    // Fills hand with a draw from the proposal and returns its importance weight.
+    float deal(Hand& hand, Rng& rng) const;
+    double getNaturalProbability(int stratum) const;
+    double getProposalProbability(int stratum) const;
+    float getWeight(int stratum) const;
+
+private:
+    // handRank of every deal, grouped by stratum. Built once and shared by all dealers.
+    const std::array<std::vector<uint32_t>, NUM_DEAL_STRATA>& mStrata;
+    std::array<double, NUM_DEAL_STRATA> mProposal {};
+    std::array<double, NUM_DEAL_STRATA> mCumulative {};
+    std::array<float, NUM_DEAL_STRATA> mWeights {};
+};
@@ -0,0 +1,118 @@
+#include "thread_team.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Iterations a worker, or a caller waiting on its blocks, polls before sleeping. A few microseconds,
+// enough to bridge the gap between the layers of one hand.
+constexpr int SPIN_COUNT = 4096;
+constexpr uint32_t NO_BLOCKS = 0xFFFFFFFFu;
+
+void spinPause() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#endif
+}
+
+uint64_t cursor(uint32_t generation, uint32_t block) {
+    return uint64_t(generation) << 32 | block;
+}
+
+} // namespace
+
+ThreadTeam::ThreadTeam(int size) {
+    // Workers start from the generation of the constructor, not whatever they see once scheduled, so a
+    // wake sent before they first run is not lost.
+    uint32_t seen = mWake.load(std::memory_order_relaxed);
+    for (int t = 1; t < size; t++) {
+        mWorkers.emplace_back(&ThreadTeam::work, this, seen);
+    }
+}
+
+ThreadTeam::~ThreadTeam() {
+    mStop.store(true, std::memory_order_relaxed);
+    mWake.fetch_add(1, std::memory_order_release);
+    mWake.notify_all();
+    for (std::thread& worker : mWorkers) {
+        worker.join();
+    }
+}
+
+int ThreadTeam::size() const {
+    return mWorkers.size() + 1;
+}
+
+void ThreadTeam::run(int numBlocks, Task task, void* context) {
+    if (numBlocks <= 0) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mBusy, std::try_to_lock);
+    if (mWorkers.empty() || numBlocks == 1 || !lock.owns_lock()) {
+        for (int b = 0; b < numBlocks; b++) {
+            task(context, b);
+        }
+        return;
+    }
+    // Close the cursor to late workers of the last job before changing the job under them.
+    uint32_t generation = (mCursor.load(std::memory_order_relaxed) >> 32) + 1;
+    mCursor.store(cursor(generation, NO_BLOCKS), std::memory_order_relaxed);
+    mTask = task;
+    mContext = context;
+    mNumBlocks.store(numBlocks, std::memory_order_relaxed);
+    mRemaining.store(numBlocks, std::memory_order_relaxed);
+    mCursor.store(cursor(generation, 0), std::memory_order_release);
+    mWake.fetch_add(1, std::memory_order_release);
+    mWake.notify_all();
+
+    runBlocks();
+    for (int spin = 0; mRemaining.load(std::memory_order_acquire) != 0; spin++) {
+        if (spin < SPIN_COUNT) {
+            spinPause();
+        } else {
+            int remaining = mRemaining.load(std::memory_order_acquire);
+            if (remaining != 0) {
+                mRemaining.wait(remaining, std::memory_order_acquire);
+            }
+        }
+    }
+}
+
+void ThreadTeam::runBlocks() {
+    uint64_t current = mCursor.load(std::memory_order_acquire);
+    while (true) {
+        uint32_t block = current & NO_BLOCKS;
+        if (block == NO_BLOCKS || block >= uint32_t(mNumBlocks.load(std::memory_order_relaxed))) {
+            return;
+        }
+        if (!mCursor.compare_exchange_weak(current, current + 1, std::memory_order_acquire)) {
+            continue;
+        }
+        mTask(mContext, block);
+        if (mRemaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            mRemaining.notify_all();
+        }
+        current = mCursor.load(std::memory_order_acquire);
+    }
+}
+
+void ThreadTeam::work(uint32_t seen) {
+    while (true) {
+        for (int spin = 0; mWake.load(std::memory_order_acquire) == seen; spin++) {
+            if (spin < SPIN_COUNT) {
+                spinPause();
+            } else {
+                mWake.wait(seen, std::memory_order_acquire);
+            }
+        }
+        seen = mWake.load(std::memory_order_acquire);
+        if (mStop.load(std::memory_order_relaxed)) {
+            return;
+        }
+        runBlocks();
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// A fixed team of threads that runs the blocks of one parallelFor at a time together with the calling
+// thread, for splitting a single wide layer across cores. Between jobs the workers spin for a while and
+// then sleep on an atomic wait, so the layers of one hand pay a few hundred nanoseconds per handoff
+// rather than a thread spawn. Spinning workers hold their cores, so a team should not be larger than
+// the cores left free by everything else running.
+class ThreadTeam {
+public:
+    // size threads in all, counting the caller, so size - 1 are spawned.
+    explicit ThreadTeam(int size);
+    ~ThreadTeam();
+    ThreadTeam(const ThreadTeam&) = delete;
+    ThreadTeam& operator=(const ThreadTeam&) = delete;
+
+    int size() const;
+    // Calls body(b) for every b in [0, numBlocks) and returns once all have run. Blocks are handed out
+    // in order from a shared cursor. Safe to call from several threads: a caller that finds the team
+    // busy runs all of its blocks itself.
+    template <typename F>
+    void parallelFor(int numBlocks, F&& body) {
+        using Body = std::remove_reference_t<F>;
+        run(numBlocks, [](void* context, int block) { (*static_cast<Body*>(context))(block); }, &body);
+    }
+
+private:
+    typedef void (*Task)(void* context, int block);
+
+    // The job generation in the high half and the next unclaimed block in the low half. Claims are a
+    // compare-exchange on both, so a worker still holding an old generation can never claim a block
+    // of the next job.
+    std::atomic<uint64_t> mCursor {0};
+    // Blocks of the current job not yet finished.
+    std::atomic<int> mRemaining {0};
+    // Bumped to wake the workers, for a new job or to stop.
+    std::atomic<uint32_t> mWake {0};
+    std::atomic<bool> mStop {false};
+    Task mTask = nullptr;
+    void* mContext = nullptr;
+    // Atomic only because a late worker may read it while the next job is being set up; its claim then
+    // fails on the generation.
+    std::atomic<int> mNumBlocks {0};
+    std::mutex mBusy;
+    std::vector<std::thread> mWorkers;
+
+    void run(int numBlocks, Task task, void* context);
+    // Claims and runs blocks of the current job until none are left.
+    void runBlocks();
+    // Runs the jobs of every wake after the one numbered seen, until stopped.
+    void work(uint32_t seen);
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "poker.h"
+
+#include <array>
+#include <initializer_list>
+#include <utility>
+
+// Game rules as compile-time policy types. A rule set names its wild rank, the lowest pair that still
+// counts as a HIGH_PAIR and the payout of every PokerHand. The evaluator bakes each one into its own
+// constexpr lookup tables (GameTables), so switching rules costs nothing per hand.
+
+constexpr int NO_RANK = 0;
+
+using Paytable = std::array<int, NUM_POKER_HANDS>;
+
+// Hands that are not listed pay nothing.
+constexpr Paytable makePaytable(std::initializer_list<std::pair<PokerHand, int>> payouts) {
+    Paytable table {};
+    for (const auto& [hand, payout] : payouts) {
+        table[hand] = payout;
+    }
+    return table;
+}
+
+// The original experiment: royal flush cut to the straight flush payout.
+struct NoRoyalRules {
+    static constexpr const char* NAME = "NoRoyal";
+    static constexpr int WILD_RANK = NO_RANK;
+    static constexpr int MIN_PAIR_RANK = 11;
+    static constexpr Paytable PAYTABLE = makePaytable({
+        {ROYAL_FLUSH, 12},
+        {STRAIGHT_FLUSH, 12},
+        {FOUR_OF_A_KIND, 20},
+        {FULL_HOUSE, 9},
+        {FLUSH, 6},
+        {STRAIGHT, 5},
+        {THREE_OF_A_KIND, 3},
+        {TWO_PAIR, 2},
+        {HIGH_PAIR, 1},
+    });
+};
+
+// Full-pay 9/6 Jacks or Better.
+struct JacksOrBetterRules {
+    static constexpr const char* NAME = "JacksOrBetter";
+    static constexpr int WILD_RANK = NO_RANK;
+    static constexpr int MIN_PAIR_RANK = 11;
+    static constexpr Paytable PAYTABLE = makePaytable({
+        {ROYAL_FLUSH, 800},
+        {STRAIGHT_FLUSH, 50},
+        {FOUR_OF_A_KIND, 25},
+        {FULL_HOUSE, 9},
+        {FLUSH, 6},
+        {STRAIGHT, 4},
+        {THREE_OF_A_KIND, 3},
+        {TWO_PAIR, 2},
+        {HIGH_PAIR, 1},
+    });
+};
+
+// Full-pay Deuces Wild, every 2 is wild and three of a kind is the lowest paying hand.
+struct DeucesWildRules {
+    static constexpr const char* NAME = "DeucesWild";
+    static constexpr int WILD_RANK = 2;
+    static constexpr int MIN_PAIR_RANK = NO_RANK;
+    static constexpr Paytable PAYTABLE = makePaytable({
+        {ROYAL_FLUSH, 800},
+        {FOUR_DEUCES, 200},
+        {WILD_ROYAL_FLUSH, 25},
+        {FIVE_OF_A_KIND, 15},
+        {STRAIGHT_FLUSH, 9},
+        {FOUR_OF_A_KIND, 5},
+        {FULL_HOUSE, 3},
+        {FLUSH, 2},
+        {STRAIGHT, 2},
+        {THREE_OF_A_KIND, 1},
+    });
+};
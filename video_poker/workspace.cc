@@ -1,7 +1,11 @@
 #include "workspace.h"
 
 #include "neural.h"
+#include "kernels.h"
 
+#include <algorithm>
+#include <span>
+#include <stdexcept>
 #include <vector>
 
 InferenceWorkspace::InferenceWorkspace(const std::vector<LayerSpecification>& topology) {
@@ -25,78 +29,165 @@ const std::vector<std::vector<float>>& InferenceWorkspace::getActivations() cons
     return mActivations;
 }
 
-TrainingWorkspace::TrainingWorkspace(const std::vector<LayerSpecification>& topology) : mInferenceWorkspace(topology) {
-    mTotalWeightGradients.resize(topology.size()-1);
-    mTotalBiasGradients.resize(topology.size()-1);
+BatchInferenceWorkspace::BatchInferenceWorkspace(const std::vector<LayerSpecification>& topology) {
+    for (const LayerSpecification& layer : topology) {
+        mLayerSizes.push_back(layer.numNeurons);
+    }
+    mActivations.resize(topology.size());
+    mSoftmaxOutputs = topology.back().activationType == Activation::SOFTMAX;
+}
+
+void BatchInferenceWorkspace::resize(int batchSize) {
+    mNumRows = batchSize;
+    if (batchSize <= mBatchSize) {
+        return;
+    }
+    mBatchSize = batchSize;
+    int maxNeurons = 0;
+    for (size_t i = 0; i < mLayerSizes.size(); i++) {
+        mActivations[i].resize(size_t(batchSize) * mLayerSizes[i], 0.0f);
+        if (i > 0 && mLayerSizes[i] > maxNeurons) {
+            maxNeurons = mLayerSizes[i];
+        }
+    }
+    mLogitsBuffer.resize(size_t(batchSize) * maxNeurons, 0.0f);
+    if (mSoftmaxOutputs) {
+        mLogOutputs.resize(mActivations.back().size(), 0.0f);
+    }
+}
+
+int BatchInferenceWorkspace::getBatchSize() const {
+    return mBatchSize;
+}
+
+const std::vector<float>& BatchInferenceWorkspace::getOutputs() const {
+    return mActivations.back();
+}
+
+const std::vector<float>& BatchInferenceWorkspace::getLogOutputs() const {
+    return mLogOutputs;
+}
+
+float* BatchInferenceWorkspace::getLogOutputsBuffer() {
+    return mLogOutputs.empty() ? nullptr : mLogOutputs.data();
+}
+
+const std::vector<std::vector<float>>& BatchInferenceWorkspace::getActivations() const {
+    return mActivations;
+}
+
+std::vector<double> BatchInferenceWorkspace::getLayerActivationSparsity() const {
+    std::vector<double> ret;
+    for (size_t l = 1; l < mActivations.size(); l++) {
+        size_t size = size_t(mNumRows) * mLayerSizes[l];
+        size_t zeros = std::count(mActivations[l].begin(), mActivations[l].begin() + size, 0.0f);
+        ret.push_back(size > 0 ? double(zeros) / size : 0.0);
+    }
+    return ret;
+}
+
+std::vector<double> BatchInferenceWorkspace::getLayerDeadFraction() const {
+    std::vector<double> ret;
+    std::vector<int> live;
+    for (size_t l = 1; l < mActivations.size(); l++) {
+        live.resize(mLayerSizes[l]);
+        int numLive = findLiveNeurons(mActivations[l].data(), mNumRows, mLayerSizes[l], live.data());
+        ret.push_back(mNumRows > 0 ? 1.0 - double(numLive) / mLayerSizes[l] : 0.0);
+    }
+    return ret;
+}
+
+TrainingWorkspace::TrainingWorkspace(const std::vector<LayerSpecification>& topology)
+        : mInferenceWorkspace(topology),
+          mBatchInferenceWorkspace(topology),
+          mGradients(topology) {
     int maxNeurons = 0;
     for (size_t i = 1; i < topology.size(); i++) {
-        mTotalWeightGradients[i-1].resize(topology[i-1].numNeurons*topology[i].numNeurons, 0.0f);
-        mTotalBiasGradients[i-1].resize(topology[i].numNeurons, 0.0f);
         if (topology[i].numNeurons > maxNeurons) {
             maxNeurons = topology[i].numNeurons;
         }
     }
-    mBlameBufferA.resize(maxNeurons, 0.0f);
-    mBlameBufferB.resize(maxNeurons, 0.0f);
+    // The first layer's downstream gradient is as wide as the inputs.
+    int maxBlame = std::max(maxNeurons, topology[0].numNeurons);
+    mBlameBufferA.resize(maxBlame, 0.0f);
+    mBlameBufferB.resize(maxBlame, 0.0f);
     mDeltaBuffer.resize(maxNeurons, 0.0f);
-    mOutputDerivativesBuffer.resize(maxNeurons, 0.0f);
+    mLiveNeurons.resize(maxNeurons, 0);
+    if (mGradients.getNumLayers() > 0) {
+        mInputMajorGradients.resize(mGradients.weights(0).size(), 0.0f);
+    }
 }
 
 void TrainingWorkspace::aggregate(TrainingWorkspace& other) {
-    const std::vector<std::vector<float>>& weightGradients = other.getTotalWeightGradients();
-    const std::vector<std::vector<float>>& biasGradients = other.getTotalBiasGradients();
-    for (size_t l = 0; l < weightGradients.size(); l++) {
-        for (size_t w = 0; w < weightGradients[l].size(); w++) {
-            mTotalWeightGradients[l][w] += weightGradients[l][w];
-        }
-        for (size_t w = 0; w < biasGradients[l].size(); w++) {
-            mTotalBiasGradients[l][w] += biasGradients[l][w];
-        }
+    if (!mGradients.hasLayoutOf(other.mGradients)) {
+        throw std::invalid_argument("Workspaces of different topologies");
     }
+    foldInputMajorGradients();
+    other.foldInputMajorGradients();
+    // x * 1 + y rounds like x + y, with or without FMA.
+    neuralKernels().axpy(1.0f, other.mGradients.data(), mGradients.data(), mGradients.size());
 }
 
 void TrainingWorkspace::batch(int batchSize) {
-    for (size_t l = 0; l < mTotalWeightGradients.size(); l++) {
-        for (size_t w = 0; w < mTotalWeightGradients[l].size(); w++) {
-            mTotalWeightGradients[l][w] /= batchSize;
-        }
-        for (size_t w = 0; w < mTotalBiasGradients[l].size(); w++) {
-            mTotalBiasGradients[l][w] /= batchSize;
-        }
+    foldInputMajorGradients();
+    float* gradients = mGradients.data();
+    for (size_t i = 0; i < mGradients.size(); i++) {
+        gradients[i] /= batchSize;
     }
 }
 
 void TrainingWorkspace::reset() {
-    for(size_t i = 0; i < mTotalWeightGradients.size(); i++) {
-        std::fill(mTotalWeightGradients[i].begin(), mTotalWeightGradients[i].end(), 0.0f);
-        std::fill(mTotalBiasGradients[i].begin(), mTotalBiasGradients[i].end(), 0.0f);
+    mGradients.zero();
+    if (mInputMajorGradientsPending) {
+        std::fill(mInputMajorGradients.begin(), mInputMajorGradients.end(), 0.0f);
+        mInputMajorGradientsPending = false;
     }
 }
 
+void TrainingWorkspace::reserveBatch(int count) {
+    size_t maxNeurons = 0;
+    for (int l = 0; l < mGradients.getNumLayers(); l++) {
+        maxNeurons = std::max(maxNeurons, mGradients.biases(l).size());
+    }
+    size_t bufferSize = size_t(count) * maxNeurons;
+    for (std::vector<float>* buffer : {&mBatchBlameBufferA, &mBatchBlameBufferB, &mBatchDeltaBuffer}) {
+        if (buffer->size() < bufferSize) {
+            buffer->resize(bufferSize);
+        }
+    }
+}
 
 const std::vector<float>& TrainingWorkspace::getOutputs() const {
     return mInferenceWorkspace.getOutputs();
 }
 
-std::vector<std::vector<float>>& TrainingWorkspace::getTotalWeightGradients() {
-    return mTotalWeightGradients;
+ParameterArena& TrainingWorkspace::getGradients() {
+    foldInputMajorGradients();
+    return mGradients;
 }
 
-std::vector<std::vector<float>>& TrainingWorkspace::getTotalBiasGradients() {
-    return mTotalBiasGradients;
+float* TrainingWorkspace::getInputMajorGradients() {
+    mInputMajorGradientsPending = true;
+    return mInputMajorGradients.data();
 }
 
-std::vector<double> TrainingWorkspace::getLayerGradientNormsSquared() const {
-    std::vector<double> ret;
-    for (size_t l = 0; l < mTotalWeightGradients.size(); l++) {
-        double layerSum = 0.0;
-        for (float b : mTotalBiasGradients[l]) {
-            layerSum += b * b;
-        }
-        for (float w : mTotalWeightGradients[l]) {
-            layerSum += w * w;
+void TrainingWorkspace::foldInputMajorGradients() {
+    if (!mInputMajorGradientsPending) {
+        return;
+    }
+    std::span<float> weightGradient = mGradients.weights(0);
+    int numNeurons = mGradients.biases(0).size();
+    int numInputs = weightGradient.size() / numNeurons;
+    for (int n = 0; n < numNeurons; n++) {
+        for (int i = 0; i < numInputs; i++) {
+            weightGradient[n * numInputs + i] += mInputMajorGradients[i * numNeurons + n];
         }
-        ret.push_back(layerSum);
     }
-    return ret;
+    std::fill(mInputMajorGradients.begin(), mInputMajorGradients.end(), 0.0f);
+    mInputMajorGradientsPending = false;
+}
+
+std::vector<double> TrainingWorkspace::getLayerGradientNormsSquared() {
+    foldInputMajorGradients();
+    return mGradients.getLayerNormsSquared();
 }
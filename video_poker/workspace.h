@@ -1,8 +1,11 @@
 #pragma once
 
+#include "parameter_arena.h"
+
 #include <vector>
 
 struct LayerSpecification;
+class ThreadTeam;
 
 class InferenceWorkspace {
 public:
@@ -12,24 +15,75 @@ public:
 // TODO: private:
     std::vector<float> mLogitsBuffer;
     std::vector<std::vector<float>> mActivations;
+    // Not owned. When set, NeuralNet splits the wide layers of per-sample passes across it, see Layer::fire.
+    ThreadTeam* mTeam = nullptr;
+};
+
+// Row-major buffers for a minibatch, one row per sample. Grown on demand to the largest batch seen,
+// so only the first count rows of a pass are meaningful.
+class BatchInferenceWorkspace {
+public:
+    BatchInferenceWorkspace(const std::vector<LayerSpecification>& topology);
+    void resize(int batchSize);
+    int getBatchSize() const;
+    const std::vector<float>& getOutputs() const;
+    // The log of each output, row-major like getOutputs(), when the output layer is SOFTMAX. Empty
+    // otherwise. Softmax gets these almost for free, and entropy needs no log pass of its own.
+    const std::vector<float>& getLogOutputs() const;
+    // Where the nets write them, or null when there are none.
+    float* getLogOutputsBuffer();
+    const std::vector<std::vector<float>>& getActivations() const;
+    // For each layer after the input, over the rows of the last pass: the fraction of activations that
+    // are zero, and the fraction of neurons that are zero in every row, which backpropagation skips.
+    std::vector<double> getLayerActivationSparsity() const;
+    std::vector<double> getLayerDeadFraction() const;
+// TODO: private:
+    int mBatchSize = 0;
+    int mNumRows = 0; // Of the last pass.
+    std::vector<int> mLayerSizes;
+    std::vector<float> mLogitsBuffer;
+    std::vector<std::vector<float>> mActivations;
+    bool mSoftmaxOutputs;
+    std::vector<float> mLogOutputs;
+    // Inputs of the last sparse feedforward, which leaves mActivations[0] unset. Zero after a dense one.
+    int mActivePerSample = 0;
+    std::vector<int> mActiveInputs;
 };
 
 class TrainingWorkspace {
 public:
     TrainingWorkspace(const std::vector<LayerSpecification>& topology);
-    std::vector<double> getLayerGradientNormsSquared() const;
+    std::vector<double> getLayerGradientNormsSquared();
     const std::vector<float>& getOutputs() const;
+    // aggregate, batch and reset are each one pass over the gradient arena.
     void aggregate(TrainingWorkspace& other);
     void batch(int batchSize);
     void reset();
-    std::vector<std::vector<float>>& getTotalWeightGradients();
-    std::vector<std::vector<float>>& getTotalBiasGradients();
+    // Grows the minibatch blame and delta buffers to hold count rows.
+    void reserveBatch(int count);
+    // The complete gradients. Read mGradients through this, or after aggregate, batch or
+    // getLayerGradientNormsSquared, as sparse passes leave part of the first layer's gradient pending.
+    ParameterArena& getGradients();
+    // Where sparse passes accumulate the first layer's weight gradient input-major, see
+    // Layer::backpropagateSparse. It stays there across passes and is folded into mGradients once,
+    // when the gradients are next read.
+    float* getInputMajorGradients();
 // TODO private:
     InferenceWorkspace mInferenceWorkspace;
-    std::vector<std::vector<float>> mTotalWeightGradients;
-    std::vector<std::vector<float>> mTotalBiasGradients;
+    BatchInferenceWorkspace mBatchInferenceWorkspace;
+    ParameterArena mGradients; // Accumulated over the batch, laid out like the net's parameters.
     std::vector<float> mBlameBufferA;
     std::vector<float> mBlameBufferB;
     std::vector<float> mDeltaBuffer;
-    std::vector<float> mOutputDerivativesBuffer;
+    std::vector<int> mLiveNeurons; // Scratch for the live neurons of one layer, see Layer::backpropagateBatch.
+    // Minibatch counterparts of the blame and delta buffers, sized by reserveBatch.
+    std::vector<float> mBatchBlameBufferA;
+    std::vector<float> mBatchBlameBufferB;
+    std::vector<float> mBatchDeltaBuffer;
+
+private:
+    std::vector<float> mInputMajorGradients;
+    bool mInputMajorGradientsPending = false;
+
+    void foldInputMajorGradients();
 };